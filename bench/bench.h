@@ -0,0 +1,276 @@
+/**
+ * @file bench.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Benchmarking Utilities Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Cycles are counted with, in order of preference:
+ * - the ARM PMU cycle counter (PMCCNTR), when built with
+ *   -DBENCH_ARM_PMU (the kernel must have enabled user-space
+ *   access to the PMU, otherwise reading it faults)
+ * - perf_event_open(), on Linux
+ * - the TSC, on x86 (reference cycles, not core cycles)
+ * 
+ * Call CyclesInit() once before measuring.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/* Clocks */
+
+
+/**
+ * Reads the monotonic clock
+ * 
+ * @return The current time, in nanoseconds
+*/
+static inline uint64_t ReadNanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+
+/* Cycle Counters */
+
+
+/**
+ * @brief A Cycle Counter Source
+*/
+typedef enum {
+    CYCLES_NONE,  //!< No cycle counter
+    CYCLES_PMU,   //!< ARM PMU cycle counter
+    CYCLES_PERF,  //!< perf_event_open() hardware cycle counter
+    CYCLES_TSC    //!< x86 time-stamp counter
+} CycleSource;
+
+/// The cycle counter in use
+static CycleSource cycle_source = CYCLES_NONE;
+/// The perf event file descriptor (CYCLES_PERF)
+static int cycle_fd = -1;
+
+/**
+ * Reads the ARM PMU cycle counter
+ * 
+ * @return The current cycle count
+ * 
+ * @pre User-space access to the PMU is enabled
+*/
+static inline uint64_t ReadPMU() {
+#if defined(BENCH_ARM_PMU) && defined(__arm__)
+    uint32_t count;
+    __asm__ volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(count));
+    return count;
+#elif defined(BENCH_ARM_PMU) && defined(__aarch64__)
+    uint64_t count;
+    __asm__ volatile("mrs %0, pmccntr_el0" : "=r"(count));
+    return count;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Selects the best available cycle counter
+ * 
+ * @return The name of the selected counter
+ * 
+ * @post ReadCycles() reads from the selected counter
+*/
+static inline const char *CyclesInit() {
+#if defined(BENCH_ARM_PMU) && (defined(__arm__) || defined(__aarch64__))
+    cycle_source = CYCLES_PMU;
+    return "ARM PMU cycle counter";
+#else
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycle_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cycle_fd >= 0) {
+        ioctl(cycle_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cycle_fd, PERF_EVENT_IOC_ENABLE, 0);
+        cycle_source = CYCLES_PERF;
+        return "perf_event_open (core cycles)";
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    cycle_source = CYCLES_TSC;
+    return "TSC (reference cycles)";
+#else
+    cycle_source = CYCLES_NONE;
+    return "none";
+#endif
+#endif
+}
+
+/**
+ * Reads the selected cycle counter
+ * 
+ * @return The current cycle count, or 0 if there is no cycle
+ * counter readable from user space
+*/
+static inline uint64_t ReadCycles() {
+    switch (cycle_source) {
+        case CYCLES_PMU:
+            return ReadPMU();
+#ifdef __linux__
+        case CYCLES_PERF: {
+            uint64_t count = 0;
+            if (read(cycle_fd, &count, sizeof(count)) != sizeof(count)) {
+                return 0;
+            }
+            return count;
+        }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+        case CYCLES_TSC:
+            return __rdtsc();
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+/* Caches */
+
+
+/// Bytes streamed through to evict the caches
+/// (must exceed the last-level cache)
+#ifndef BENCH_FLUSH_BYTES
+#define BENCH_FLUSH_BYTES (8u << 20)
+#endif
+
+/**
+ * Evicts the caches
+ * 
+ * Writes and reads back a buffer larger than the last-level cache,
+ * so that whatever a kernel touched before is no longer cached
+ * 
+ * @return A checksum of the buffer (to keep the reads alive)
+*/
+static inline unsigned FlushCaches() {
+    static volatile unsigned char buffer[BENCH_FLUSH_BYTES];
+    static unsigned char pass = 0;
+    unsigned sum = 0;
+    unsigned i;
+    pass++;
+    // One access per 64-byte line is enough
+    for (i = 0; i < BENCH_FLUSH_BYTES; i += 64) buffer[i] = pass;
+    for (i = 0; i < BENCH_FLUSH_BYTES; i += 64) sum += buffer[i];
+    return sum;
+}
+
+
+/* Timing */
+
+
+/**
+ * @brief A Measurement
+ * 
+ * The cost of running a kernel over some number of samples
+*/
+typedef struct {
+    uint64_t ns;      //!< Elapsed time (ns)
+    uint64_t cycles;  //!< Elapsed cycles (0 if unavailable)
+    long samples;     //!< Number of samples processed
+} Measurement;
+
+/**
+ * Starts a measurement
+ * 
+ * @param m The measurement to start
+ * 
+ * @post m holds the starting time and cycle count
+*/
+static inline void MeasureStart(Measurement *m) {
+    m->samples = 0;
+    m->cycles = ReadCycles();
+    m->ns = ReadNanoseconds();
+}
+
+/**
+ * Stops a measurement
+ * 
+ * @param m The measurement to stop
+ * @param samples The number of samples processed since MeasureStart()
+ * 
+ * @post m holds the elapsed time and cycle count
+*/
+static inline void MeasureStop(Measurement *m, long samples) {
+    m->ns = ReadNanoseconds() - m->ns;
+    m->cycles = ReadCycles() - m->cycles;
+    m->samples = samples;
+}
+
+/**
+ * Adds a measurement into a running total
+ * 
+ * @param total The running total
+ * @param m The measurement to add
+ * @param overhead The cost of an empty measurement, subtracted
+ * from m (may be NULL)
+ * 
+ * @post total includes m
+*/
+static inline void MeasureAdd(Measurement *total,
+                              Measurement *m,
+                              Measurement *overhead) {
+    uint64_t ns = m->ns, cycles = m->cycles;
+    if (overhead != NULL) {
+        ns = ns > overhead->ns ? ns - overhead->ns : 0;
+        cycles = cycles > overhead->cycles ? cycles - overhead->cycles : 0;
+    }
+    total->ns += ns;
+    total->cycles += cycles;
+    total->samples += m->samples;
+}
+
+/**
+ * Measures the cost of an empty measurement
+ * 
+ * @param overhead The measurement to hold the (minimum) cost
+ * 
+ * @post overhead holds the cost of MeasureStart() and MeasureStop()
+*/
+static inline void MeasureOverhead(Measurement *overhead) {
+    Measurement m;
+    int i;
+    overhead->ns = UINT64_MAX;
+    overhead->cycles = UINT64_MAX;
+    overhead->samples = 0;
+    for (i = 0; i < 1000; i++) {
+        MeasureStart(&m);
+        MeasureStop(&m, 0);
+        if (m.ns < overhead->ns) overhead->ns = m.ns;
+        if (m.cycles < overhead->cycles) overhead->cycles = m.cycles;
+    }
+}
+
+#endif  // BENCH_H_
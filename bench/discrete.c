@@ -0,0 +1,699 @@
+/**
+ * @file discrete.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Discrete-Lib Kernel Benchmark
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Measures the per-sample cost of the discrete-lib kernels, with warm
+ * caches (millions of samples back to back) and with cold caches (one
+ * control period at a time, with the caches evicted in between, as in
+ * the 5 ms control threads). Every kernel is run through its current
+ * per-sample API first, and each variant is reported against it.
+ * 
+ * Then each block variant's outputs are checked against its kernel's
+ * per-sample API (exactly, and a BiquadBank's within BANK_TOLERANCE),
+ * and the benchmark fails if one is off.
+ * 
+ * The two-axis kernel is the anti-sway loop (outer angle feedback and
+ * inner PI) on both axes, as two SISO paths and as one state-space
+ * system; its samples are per axis, so a step costs twice as much.
+ * 
+ * To get before/after numbers for a kernel change, save the results
+ * before the change (make bench-baseline) and run the benchmark again
+ * after it (make bench), which reports each row against the baseline.
+ * 
+ * Usage: discrete [-s save_file] [-b baseline_file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "discrete-lib.h"
+#include "filter-design.h"
+#include "control-chain.h"
+
+#include "bench.h"
+
+
+/* Benchmark Parameters */
+
+
+/// The number of samples per warm run
+#define WARM_SAMPLES 4000000
+/// The number of cold runs
+#define COLD_RUNS 500
+/// The number of samples per cold run (one control period)
+#define COLD_SAMPLES 1
+/// The number of samples in the input buffer (fits in L1)
+#define BUFFER_LEN 1024
+/// The number of samples per call of a variant
+#define CHUNK_LEN 256
+/// The timestep (s)
+#define TIMESTEP 0.005
+/// The order of the cascade under test
+#define CASCADE_ORDER 8
+/// The number of channels of the bank under test
+#define BANK_CHANNELS 2
+/// The maximum number of results (for the baseline)
+#define MAX_RESULTS 64
+/// The tolerance of a variant whose outputs are not checked
+#define UNCHECKED -1.0
+/// Reference velocity of the two-axis loop
+#define LOOP_REFERENCE 0.15
+/// Outer loop gain of the two-axis loop (per axis)
+static const double loop_outer[2] = {4.29, 4.29};
+/// Inner proportional gain of the two-axis loop (per axis)
+static const double loop_prop[2] = {147.3, 81.2};
+/// Inner integral gain of the two-axis loop (per axis)
+static const double loop_int[2] = {95.1, 46.0};
+/// Force to voltage of the two-axis loop
+#define LOOP_FORCE_TO_VOLTAGE 0.1375
+
+
+/* Kernel State */
+
+
+/// The biquad cascade (and one copy per bank channel)
+static Biquad cascade[BANK_CHANNELS][CASCADE_ORDER / 2];
+/// The number of sections in cascade
+static int sections;
+/// The bank of cascades
+static BiquadBank bank;
+/// The proportional gain
+static Proportional k_p;
+/// The integral term
+static Integrator integ;
+/// The derivative term
+static Differentiator deriv;
+
+/// The PI loop, as a fused control chain
+#define BENCH_PI_CHAIN(OP) \
+    OP(INPUT, error) \
+    OP(PI, prop, integ) \
+    OP(SATURATE, -10.0, 10.0)
+
+DEFINE_CONTROL_CHAIN(BenchPI, BENCH_PI_CHAIN)
+
+/// The fused PI loop's state
+static BenchPIState chain;
+
+/// The two-axis loop, as a fused control chain (per axis)
+#define BENCH_LOOP_CHAIN(OP) \
+    OP(INPUT, vel_ref) \
+    OP(ADD_SCALED, angle, outer_feedback) \
+    OP(SUB, vel) \
+    OP(SCALE, LOOP_FORCE_TO_VOLTAGE) \
+    OP(PI, inner_prop, inner_int) \
+    OP(SATURATE, -10.0, 10.0)
+
+DEFINE_CONTROL_CHAIN(BenchLoop, BENCH_LOOP_CHAIN)
+
+/// The two-axis loop's fused chains
+static BenchLoopState loop_chain[2];
+/// The two-axis loop's outer gains (SISO paths)
+static Proportional loop_k[2];
+/// The two-axis loop's inner proportional gains (SISO paths)
+static Proportional loop_p[2];
+/// The two-axis loop's inner integral terms (SISO paths)
+static Integrator loop_i[2];
+
+/// The two-axis loop, as a state-space system with the integrator
+/// states x, inputs u = [vel_ref_x angle_x vel_x vel_ref_y angle_y vel_y]
+/// and outputs y = [voltage_x voltage_y]
+DEFINE_STATE_SPACE(BenchLoopSystem, 2, 6, 2)
+
+/// The two-axis loop's state-space system
+static BenchLoopSystem loop_system;
+
+/**
+ * Sets up the two-axis loop as a state-space system
+ * 
+ * The Tustin integrator out[k] = out[k-1] + g (e[k] + e[k-1]), with
+ * the state x[k] = out[k-1] + g e[k-1], is x[k+1] = x[k] + 2g e[k] and
+ * out[k] = x[k] + g e[k], so that the PI output is x[k] + (K_p + g) e[k]
+ * 
+ * @post loop_system holds the (decoupled) two-axis loop
+*/
+static void SetupLoopSystem() {
+    double a[2][2] = {{1.0, 0.0}, {0.0, 1.0}};
+    double b[2][6] = {{0.0}};
+    double c[2][2] = {{1.0, 0.0}, {0.0, 1.0}};
+    double d[2][6] = {{0.0}};
+    int axis;
+    for (axis = 0; axis < 2; axis++) {
+        // The error e = F (vel_ref + K angle - vel)
+        double error[3] = {LOOP_FORCE_TO_VOLTAGE,
+                           LOOP_FORCE_TO_VOLTAGE * loop_outer[axis],
+                           -LOOP_FORCE_TO_VOLTAGE};
+        double g = loop_i[axis].gain;
+        int j;
+        for (j = 0; j < 3; j++) {
+            b[axis][3 * axis + j] = 2 * g * error[j];
+            d[axis][3 * axis + j] = (loop_prop[axis] + g) * error[j];
+        }
+    }
+    BenchLoopSystemInit(a, b, c, d, &loop_system);
+}
+
+/**
+ * Resets every kernel's state (and coefficients)
+ * 
+ * @post Every kernel starts from zero initial conditions
+*/
+static void ResetKernels() {
+    Biquad *channels[BANK_CHANNELS];
+    int c;
+    for (c = 0; c < BANK_CHANNELS; c++) {
+        sections = DesignButterworthLowPass(CASCADE_ORDER, 2 * M_PI * 10.0,
+                                            TIMESTEP, cascade[c],
+                                            CASCADE_ORDER / 2);
+        channels[c] = cascade[c];
+    }
+    BiquadBankInit(channels, BANK_CHANNELS, sections, &bank);
+    k_p = 147.3;
+    IntegratorInit(95.1, TIMESTEP, &integ);
+    DifferentiatorInit(0.8, TIMESTEP, &deriv);
+    chain.prop = k_p;
+    IntegratorInit(95.1, TIMESTEP, &chain.integ);
+
+    for (c = 0; c < 2; c++) {
+        loop_k[c] = loop_outer[c];
+        loop_p[c] = loop_prop[c];
+        IntegratorInit(loop_int[c], TIMESTEP, loop_i + c);
+        loop_chain[c].outer_feedback = loop_outer[c];
+        loop_chain[c].inner_prop = loop_prop[c];
+        IntegratorInit(loop_int[c], TIMESTEP, &loop_chain[c].inner_int);
+    }
+    SetupLoopSystem();
+}
+
+
+/* Kernels Under Test */
+
+
+/**
+ * @brief A Kernel Variant
+ * 
+ * Runs a kernel over a buffer of samples
+*/
+typedef struct {
+    const char *kernel;   //!< The kernel (variants share a kernel)
+    const char *variant;  //!< The variant (the first is the reference)
+    void (*run)(Real input[], Real output[], int length);
+    int channels;         //!< Channels processed per sample
+    //! The largest error against the reference (see CheckOutputs()),
+    //! or UNCHECKED
+    double tolerance;
+} Variant;
+
+/// Runs Cascade() over one section
+static void RunBiquad(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = Cascade(input[n], cascade[0], 1, NEG_INF, POS_INF);
+    }
+}
+
+/// Runs CascadeBlock() over one section
+static void RunBiquadBlock(Real input[], Real output[], int length) {
+    CascadeBlock(input, output, length, cascade[0], 1, NEG_INF, POS_INF);
+}
+
+/// Runs Cascade()
+static void RunCascade(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = Cascade(input[n], cascade[0], sections,
+                            NEG_INF, POS_INF);
+    }
+}
+
+/// Runs CascadeBlock()
+static void RunCascadeBlock(Real input[], Real output[], int length) {
+    CascadeBlock(input, output, length, cascade[0], sections,
+                 NEG_INF, POS_INF);
+}
+
+/// Runs Cascade() once per channel (interleaved frames)
+static void RunChannels(Real input[], Real output[], int length) {
+    int n, c;
+    for (n = 0; n < length; n += BANK_CHANNELS) {
+        for (c = 0; c < BANK_CHANNELS; c++) {
+            output[n + c] = Cascade(input[n + c], cascade[c], sections,
+                                    NEG_INF, POS_INF);
+        }
+    }
+}
+
+/// Runs BiquadBankStep() (interleaved frames)
+static void RunBankStep(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n += BANK_CHANNELS) {
+        BiquadBankStep(&bank, input + n, output + n, NEG_INF, POS_INF);
+    }
+}
+
+/// Runs BiquadBankBlock() (interleaved frames)
+static void RunBankBlock(Real input[], Real output[], int length) {
+    BiquadBankBlock(&bank, input, output, length / BANK_CHANNELS,
+                    NEG_INF, POS_INF);
+}
+
+/// Runs Integrate()
+static void RunIntegrate(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = Integrate(input[n], &integ, -10.0, 10.0);
+    }
+}
+
+/// Runs IntegrateBlock()
+static void RunIntegrateBlock(Real input[], Real output[], int length) {
+    IntegrateBlock(input, output, length, &integ, -10.0, 10.0);
+}
+
+/// Runs Differentiate()
+static void RunDifferentiate(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = Differentiate(input[n], &deriv, -10.0, 10.0);
+    }
+}
+
+/// Runs DifferentiateBlock()
+static void RunDifferentiateBlock(Real input[], Real output[], int length) {
+    DifferentiateBlock(input, output, length, &deriv, -10.0, 10.0);
+}
+
+/// Runs PID()
+static void RunPID(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = PID(input[n], &k_p, &integ, &deriv, -10.0, 10.0);
+    }
+}
+
+/// Runs PIDBlock()
+static void RunPIDBlock(Real input[], Real output[], int length) {
+    PIDBlock(input, output, length, &k_p, &integ, &deriv, -10.0, 10.0);
+}
+
+/// Runs PID() as a PI loop
+static void RunPI(Real input[], Real output[], int length) {
+    int n;
+    for (n = 0; n < length; n++) {
+        output[n] = PID(input[n], &k_p, &integ, NULL, -10.0, 10.0);
+    }
+}
+
+/// Runs PIDBlock() as a PI loop
+static void RunPIBlock(Real input[], Real output[], int length) {
+    PIDBlock(input, output, length, &k_p, &integ, NULL, -10.0, 10.0);
+}
+
+/// Runs the PI loop as a fused control chain
+static void RunPIChain(Real input[], Real output[], int length) {
+    BenchPIInput in;
+    BenchPITaps taps;
+    int n;
+    for (n = 0; n < length; n++) {
+        in.error = input[n];
+        output[n] = BenchPIStep(&chain, &in, &taps);
+    }
+}
+
+/// Runs the two-axis loop as two SISO paths (interleaved frames,
+/// with each axis' velocity taken from the other axis' sample)
+static void RunLoopSISO(Real input[], Real output[], int length) {
+    int n, c;
+    for (n = 0; n < length; n += 2) {
+        for (c = 0; c < 2; c++) {
+            Real outer = (Real) LOOP_REFERENCE + loop_k[c] * input[n + c];
+            Real error = outer - (Real) -0.3 * input[n + 1 - c];
+            output[n + c] = PID((Real) LOOP_FORCE_TO_VOLTAGE * error,
+                                loop_p + c, loop_i + c, NULL, -10.0, 10.0);
+        }
+    }
+}
+
+/// Runs the two-axis loop as two fused control chains
+static void RunLoopChain(Real input[], Real output[], int length) {
+    BenchLoopInput in;
+    BenchLoopTaps taps;
+    int n, c;
+    for (n = 0; n < length; n += 2) {
+        for (c = 0; c < 2; c++) {
+            in.vel_ref = LOOP_REFERENCE;
+            in.angle = input[n + c];
+            in.vel = (Real) -0.3 * input[n + 1 - c];
+            output[n + c] = BenchLoopStep(loop_chain + c, &in, &taps);
+        }
+    }
+}
+
+/// Runs the two-axis loop as one state-space system
+static void RunLoopStateSpace(Real input[], Real output[], int length) {
+    Real u[6];
+    int n, c;
+    for (n = 0; n < length; n += 2) {
+        for (c = 0; c < 2; c++) {
+            u[3 * c] = LOOP_REFERENCE;
+            u[3 * c + 1] = input[n + c];
+            u[3 * c + 2] = (Real) -0.3 * input[n + 1 - c];
+        }
+        BenchLoopSystemStep(&loop_system, u, output + n, -10.0, 10.0);
+    }
+}
+
+/// The variants, grouped by kernel, each group's reference first
+static Variant variants[] = {
+    {"biquad", "Cascade", RunBiquad, 1, UNCHECKED},
+    {"biquad", "CascadeBlock", RunBiquadBlock, 1, 0.0},
+    {"cascade", "Cascade", RunCascade, 1, UNCHECKED},
+    {"cascade", "CascadeBlock", RunCascadeBlock, 1, 0.0},
+    {"bank", "Cascade", RunChannels, BANK_CHANNELS, UNCHECKED},
+    {"bank", "BiquadBankStep", RunBankStep, BANK_CHANNELS, BANK_TOLERANCE},
+    {"bank", "BiquadBankBlock", RunBankBlock, BANK_CHANNELS,
+     BANK_TOLERANCE},
+    {"integrate", "Integrate", RunIntegrate, 1, UNCHECKED},
+    {"integrate", "IntegrateBlock", RunIntegrateBlock, 1, 0.0},
+    {"differentiate", "Differentiate", RunDifferentiate, 1, UNCHECKED},
+    {"differentiate", "DifferentiateBlock", RunDifferentiateBlock, 1, 0.0},
+    {"pid", "PID", RunPID, 1, UNCHECKED},
+    {"pid", "PIDBlock", RunPIDBlock, 1, 0.0},
+    {"pi", "PID", RunPI, 1, UNCHECKED},
+    {"pi", "PIDBlock", RunPIBlock, 1, 0.0},
+    {"pi", "ControlChain", RunPIChain, 1, UNCHECKED},
+    {"two-axis", "PID", RunLoopSISO, 2, UNCHECKED},
+    {"two-axis", "ControlChain", RunLoopChain, 2, UNCHECKED},
+    {"two-axis", "StateSpace", RunLoopStateSpace, 2, UNCHECKED},
+};
+
+/// The number of variants
+#define NUM_VARIANTS ((int) (sizeof(variants) / sizeof(variants[0])))
+
+
+/* Measurement */
+
+
+/**
+ * @brief A Result
+ * 
+ * The per-sample cost of a variant
+*/
+typedef struct {
+    char name[64];      //!< kernel/variant
+    double warm_ns;     //!< Warm ns/sample
+    double warm_cycles; //!< Warm cycles/sample
+    double cold_ns;     //!< Cold ns/sample
+    double cold_cycles; //!< Cold cycles/sample
+} Result;
+
+/// Input samples (BANK_CHANNELS-interleaved for the bank)
+static Real input[BUFFER_LEN];
+/// Output samples
+static Real output[BUFFER_LEN];
+/// The cost of an empty measurement
+static Measurement overhead;
+
+/**
+ * Measures a variant with warm caches
+ * 
+ * @param v The variant
+ * @param result The result to fill in
+ * 
+ * @post result holds the warm costs
+*/
+static void MeasureWarm(Variant *v, Result *result) {
+    Measurement m;
+    long n;
+    ResetKernels();
+    // Warm up the caches and branch predictors
+    for (n = 0; n < BUFFER_LEN; n += CHUNK_LEN) {
+        v->run(input + n, output + n, CHUNK_LEN);
+    }
+    MeasureStart(&m);
+    for (n = 0; n < WARM_SAMPLES; n += CHUNK_LEN) {
+        v->run(input + n % BUFFER_LEN, output + n % BUFFER_LEN, CHUNK_LEN);
+    }
+    MeasureStop(&m, WARM_SAMPLES);
+    result->warm_ns = (double) m.ns / m.samples;
+    result->warm_cycles = (double) m.cycles / m.samples;
+}
+
+/**
+ * Measures a variant with cold caches
+ * 
+ * @param v The variant
+ * @param result The result to fill in
+ * 
+ * @post result holds the cold costs
+*/
+static void MeasureCold(Variant *v, Result *result) {
+    Measurement total = {0, 0, 0};
+    Measurement m;
+    int length = COLD_SAMPLES * v->channels;
+    int run;
+    ResetKernels();
+    for (run = 0; run < COLD_RUNS; run++) {
+        int offset = (run * length) % BUFFER_LEN;
+        FlushCaches();
+        MeasureStart(&m);
+        v->run(input + offset, output + offset, length);
+        MeasureStop(&m, length);
+        MeasureAdd(&total, &m, &overhead);
+    }
+    result->cold_ns = (double) total.ns / total.samples;
+    result->cold_cycles = (double) total.cycles / total.samples;
+}
+
+
+/* Output Checks */
+
+
+/// The reference's outputs
+static Real expected[BUFFER_LEN];
+
+/**
+ * Compares a variant's outputs with its reference's
+ * 
+ * Runs both from zero initial conditions over the input buffer, a
+ * chunk at a time
+ * 
+ * @param v The variant
+ * @param reference The variant's reference
+ * 
+ * @return The largest difference between their outputs, relative to
+ * the largest output of the reference
+*/
+static double CheckOutputs(Variant *v, Variant *reference) {
+    double scale = 0.0;
+    double error = 0.0;
+    int n;
+    ResetKernels();
+    for (n = 0; n < BUFFER_LEN; n += CHUNK_LEN) {
+        reference->run(input + n, expected + n, CHUNK_LEN);
+    }
+    ResetKernels();
+    for (n = 0; n < BUFFER_LEN; n += CHUNK_LEN) {
+        v->run(input + n, output + n, CHUNK_LEN);
+    }
+    for (n = 0; n < BUFFER_LEN; n++) {
+        scale = fmax(scale, fabs((double) expected[n]));
+        error = fmax(error, fabs((double) output[n] - expected[n]));
+    }
+    return scale > 0.0 ? error / scale : error;
+}
+
+
+/* Baselines */
+
+
+/**
+ * Saves results
+ * 
+ * @param path The file to save to
+ * @param results The results
+ * @param count The number of results
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+static int SaveResults(const char *path, Result results[], int count) {
+    FILE *file = fopen(path, "w");
+    int i;
+    if (file == NULL) return EXIT_FAILURE;
+    fprintf(file, "# %s\n", sizeof(Real) == sizeof(float) ?
+            "single" : "double");
+    for (i = 0; i < count; i++) {
+        fprintf(file, "%s %.4f %.4f %.4f %.4f\n", results[i].name,
+                results[i].warm_ns, results[i].warm_cycles,
+                results[i].cold_ns, results[i].cold_cycles);
+    }
+    fclose(file);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Loads results
+ * 
+ * @param path The file to load from
+ * @param results The results to fill in
+ * @param max_count The capacity of results
+ * 
+ * @return The number of results loaded, negative upon error
+*/
+static int LoadResults(const char *path, Result results[], int max_count) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int count = 0;
+    if (file == NULL) return -1;
+    while (count < max_count && fgets(line, sizeof(line), file) != NULL) {
+        Result *r = results + count;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %lf %lf %lf %lf", r->name, &r->warm_ns,
+                   &r->warm_cycles, &r->cold_ns, &r->cold_cycles) == 5) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+/**
+ * Finds a result by name
+ * 
+ * @param name The name to find
+ * @param results The results
+ * @param count The number of results
+ * 
+ * @return The result, or NULL if there is none
+*/
+static Result *FindResult(const char *name, Result results[], int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        if (strcmp(results[i].name, name) == 0) return results + i;
+    }
+    return NULL;
+}
+
+
+/* Main */
+
+
+/**
+ * Runs the kernel benchmark
+ * 
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * 
+ * @return 0 upon success, or 1 if a variant's outputs exceeded their
+ * tolerance
+*/
+int main(int argc, char *argv[]) {
+    static Result results[MAX_RESULTS];
+    static Result baseline[MAX_RESULTS];
+    const char *save_path = NULL;
+    const char *baseline_path = NULL;
+    int num_baseline = 0;
+    Result *reference = NULL;
+    Variant *checked = NULL;
+    int exceeded = 0;
+    int i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-s") == 0) {
+            save_path = argv[i + 1];
+        } else if (strcmp(argv[i], "-b") == 0) {
+            baseline_path = argv[i + 1];
+        }
+    }
+    if (baseline_path != NULL) {
+        num_baseline = LoadResults(baseline_path, baseline, MAX_RESULTS);
+        if (num_baseline < 0) {
+            printf("no baseline at %s (make bench-baseline)\n",
+                   baseline_path);
+            num_baseline = 0;
+        }
+    }
+
+    for (i = 0; i < BUFFER_LEN; i++) {
+        input[i] = 0.1 * sin(0.01 * i) + 0.01 * sin(0.37 * i);
+    }
+
+    printf("discrete-lib kernels, %s precision\n",
+           sizeof(Real) == sizeof(float) ? "single" : "double");
+    printf("cycle counter: %s\n", CyclesInit());
+    MeasureOverhead(&overhead);
+    printf("warm: %d samples, cold: %d x %d sample(s), "
+           "%u KiB evicted between\n\n", WARM_SAMPLES, COLD_RUNS,
+           COLD_SAMPLES, BENCH_FLUSH_BYTES >> 10);
+    printf("%-34s %9s %9s %9s %9s %8s %8s\n", "kernel/variant",
+           "warm ns", "warm cyc", "cold ns", "cold cyc", "vs ref",
+           "vs base");
+
+    for (i = 0; i < NUM_VARIANTS; i++) {
+        Variant *v = variants + i;
+        Result *r = results + i;
+        Result *base;
+
+        snprintf(r->name, sizeof(r->name), "%s/%s", v->kernel, v->variant);
+        MeasureWarm(v, r);
+        MeasureCold(v, r);
+        if (i == 0 || strcmp(v->kernel, variants[i - 1].kernel) != 0) {
+            reference = r;
+        }
+
+        printf("%-34s %9.2f %9.1f %9.1f %9.1f", r->name, r->warm_ns,
+               r->warm_cycles, r->cold_ns, r->cold_cycles);
+        // Ratios are of warm ns/sample; > 1.00x is faster
+        if (r != reference) {
+            printf(" %7.2fx", reference->warm_ns / r->warm_ns);
+        } else {
+            printf(" %8s", "-");
+        }
+        base = FindResult(r->name, baseline, num_baseline);
+        if (base != NULL) {
+            printf(" %7.2fx", base->warm_ns / r->warm_ns);
+        } else {
+            printf(" %8s", "-");
+        }
+        printf("\n");
+    }
+
+    // Each checked variant's outputs, against its reference's
+    printf("\n%-34s %12s %12s\n", "kernel/variant", "rel. error",
+           "tolerance");
+    for (i = 0; i < NUM_VARIANTS; i++) {
+        Variant *v = variants + i;
+        double error;
+        if (i == 0 || strcmp(v->kernel, variants[i - 1].kernel) != 0) {
+            checked = v;
+        }
+        if (v->tolerance < 0.0) continue;
+        error = CheckOutputs(v, checked);
+        printf("%-34s %12.3g %12.3g%s\n", results[i].name, error,
+               v->tolerance, error > v->tolerance ? "  EXCEEDED" : "");
+        if (error > v->tolerance) {
+            exceeded++;
+        }
+    }
+
+    if (save_path != NULL) {
+        if (SaveResults(save_path, results, NUM_VARIANTS)) {
+            printf("could not save to %s\n", save_path);
+            return EXIT_FAILURE;
+        }
+        printf("\nsaved to %s\n", save_path);
+    }
+    if (exceeded > 0) {
+        printf("\n%d variant(s) exceeded their tolerance\n", exceeded);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
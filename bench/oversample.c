@@ -0,0 +1,272 @@
+/**
+ * @file oversample.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Potentiometer Front-End Benchmark
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Runs the ways of getting one rope angle per base tick from a
+ * potentiometer over a synthetic run (the rope swaying, excited and
+ * damped in turn), sampled SAMPLES_PER_TICK times a base tick with
+ * white noise, mains pickup (whose harmonic at PICKUP_HZ the base tick
+ * aliases into the control loop's band) and the myRIO's 12-bit
+ * quantization, and reports each one's noise against its lag (as
+ * bench/velocity.c does), with the cost of an angle: one read per base
+ * tick (as GetAngle() was), the mean of the base tick's samples (as
+ * io.c's Decimator takes, and FPGA averaging would), and a decimating
+ * windowed sinc over as many samples.
+ * 
+ * Usage: oversample [-n noise_mV] [-p pickup_mV]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "discrete-lib.h"
+#include "filter-design.h"
+
+#include "bench.h"
+
+
+/* Benchmark Parameters */
+
+
+/// The base tick (s)
+#define TIMESTEP 0.005
+/// The samples per base tick (POT_SAMPLE_US, as in io.h)
+#define SAMPLES_PER_TICK 25
+/// The sampling period (s)
+#define SAMPLE_STEP (TIMESTEP / SAMPLES_PER_TICK)
+/// The windowed sinc's taps (one base tick, as POT_TAPS in io.h)
+#define TAPS 25
+/// The run's length (base ticks, 1 min)
+#define TICKS 12000
+/// The samples in the run
+#define SAMPLES (TICKS * SAMPLES_PER_TICK)
+/// Volts per radian (1 / POTENTIOMETER_SLOPE, as in hal.h)
+#define V_PER_RAD (-180.0 / (2.11 * M_PI))
+/// The analog channels' resolution (V, as in hal-sim.c)
+#define AIO_LSB (20.0 / 4096.0)
+/// The default noise (mV RMS)
+#define NOISE_MV 5.0
+/// The mains pickup's harmonic (Hz, the 7th of 60 Hz, aliased to 20 Hz)
+#define PICKUP_HZ 420.0
+/// The default pickup (mV, peak)
+#define PICKUP_MV 5.0
+/// The longest lag searched (samples)
+#define MAX_LAG (3 * SAMPLES_PER_TICK)
+
+
+/* Runs */
+
+
+/**
+ * The synthetic run's true angle
+ * 
+ * @param t The time (s)
+ * 
+ * @return The angle (rad)
+*/
+static double SyntheticAngle(double t) {
+    // The rope's natural frequency (rad/s), for a 0.47 m rope
+    const double sway = sqrt(9.81 / 0.47);
+    // Swaying, as the trolley excites and then damps it every 10 s, on
+    // a slow drift
+    double envelope = 0.03 + 0.02 * cos(2 * M_PI * 0.1 * t);
+    return envelope * sin(sway * t) + 0.01 * sin(2 * M_PI * 0.03 * t);
+}
+
+/**
+ * Samples the synthetic run
+ * 
+ * @param noise The noise (V RMS)
+ * @param pickup The pickup (V, peak)
+ * @param truth A return parameter, which becomes the angle at each
+ * sample (rad)
+ * @param voltage A return parameter, which becomes the sampled
+ * voltages (V)
+*/
+static void SyntheticRun(double noise,
+                         double pickup,
+                         double truth[],
+                         Real voltage[]) {
+    unsigned int seed = 12345u;
+    long k;
+
+    for (k = 0; k < SAMPLES; k++) {
+        // Box-Muller, from two uniform draws
+        seed = seed * 1103515245u + 12345u;
+        double u = (((seed >> 8) & 0xFFFF) + 1.0) / 65537.0;
+        seed = seed * 1103515245u + 12345u;
+        double v = ((seed >> 8) & 0xFFFF) / 65536.0;
+        double gauss = sqrt(-2.0 * log(u)) * cos(2 * M_PI * v);
+
+        double hum = pickup * sin(2 * M_PI * PICKUP_HZ * k * SAMPLE_STEP);
+
+        truth[k] = SyntheticAngle(k * SAMPLE_STEP);
+        voltage[k] = round((truth[k] * V_PER_RAD + noise * gauss + hum) /
+                           AIO_LSB) * AIO_LSB;
+    }
+}
+
+
+/* Front-Ends */
+
+
+/**
+ * @brief A Front-End Under Test
+*/
+typedef enum {
+    SINGLE,     //!< One read per base tick
+    AVERAGE,    //!< The mean of the base tick's samples
+    DECIMATOR,  //!< The decimating windowed sinc
+    FRONT_ENDS  //!< The number of front-ends
+} FrontEnd;
+
+/// The front-ends' names
+static const char *names[FRONT_ENDS] = {"one read per tick",
+                                        "mean of the tick",
+                                        "windowed sinc"};
+
+/**
+ * Runs a front-end over a run
+ * 
+ * @param front_end The front-end
+ * @param voltage The sampled voltages (V)
+ * @param output A return parameter, which becomes an angle at the end
+ * of each base tick (rad)
+ * @param m A return parameter, which becomes the cost
+*/
+static void Filter(FrontEnd front_end,
+                   const Real voltage[],
+                   double output[],
+                   Measurement *m) {
+    static Decimator dec;
+    Real taps[TAPS];
+    Real result;
+    long k, j;
+
+    DesignWindowedSinc(TAPS, M_PI / TIMESTEP, SAMPLE_STEP, taps);
+    DecimatorInit(taps, TAPS, 1, &dec);
+    MeasureStart(m);
+    for (k = 0; k < TICKS; k++) {
+        const Real *tick = voltage + k * SAMPLES_PER_TICK;
+        double sum = 0.0;
+        switch (front_end) {
+            case SINGLE:
+                result = tick[SAMPLES_PER_TICK - 1];
+                break;
+            case AVERAGE:
+                for (j = 0; j < SAMPLES_PER_TICK; j++) sum += tick[j];
+                result = sum / SAMPLES_PER_TICK;
+                break;
+            default:
+                result = tick[SAMPLES_PER_TICK - 1];
+                for (j = 0; j < SAMPLES_PER_TICK; j++) {
+                    DecimatorPush(&dec, tick + j);
+                }
+                DecimatorOutput(&dec, &result);
+                break;
+        }
+        output[k] = result / V_PER_RAD;
+    }
+    MeasureStop(m, TICKS);
+}
+
+
+/* Metrics */
+
+
+/**
+ * Measures a front-end's noise against its lag
+ * 
+ * @param truth The angle at each sample (rad)
+ * @param output The angles at the end of each base tick (rad)
+ * @param lag A return parameter, which becomes the lag (s)
+ * @param noise A return parameter, which becomes the RMS error, once
+ * lined up (rad)
+ * @param error A return parameter, which becomes the RMS error, as is
+ * (rad)
+*/
+static void Measure(const double truth[],
+                    const double output[],
+                    double *lag,
+                    double *noise,
+                    double *error) {
+    double best = INFINITY;
+    long k, shift;
+
+    *lag = 0.0;
+    *error = 0.0;
+    for (shift = 0; shift <= MAX_LAG; shift++) {
+        double sum = 0.0;
+        for (k = MAX_LAG / SAMPLES_PER_TICK + 1; k < TICKS; k++) {
+            // The true angle, shift samples before the tick's last
+            double diff = output[k] -
+                truth[(k + 1) * SAMPLES_PER_TICK - 1 - shift];
+            sum += diff * diff;
+        }
+        sum /= TICKS - MAX_LAG / SAMPLES_PER_TICK - 1;
+        if (shift == 0) *error = sqrt(sum);
+        if (sum < best) {
+            best = sum;
+            *lag = shift * SAMPLE_STEP;
+        }
+    }
+    *noise = sqrt(best);
+}
+
+
+/* Main */
+
+
+/**
+ * Runs the potentiometer front-end benchmark
+ * 
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * 
+ * @return 0 upon success
+*/
+int main(int argc, char *argv[]) {
+    static double truth[SAMPLES];
+    static Real voltage[SAMPLES];
+    static double output[TICKS];
+    double noise_mv = NOISE_MV, pickup_mv = PICKUP_MV;
+    double lag, noise, error;
+    Measurement m;
+    int option, i;
+
+    while ((option = getopt(argc, argv, "n:p:")) != -1) {
+        if (option == 'n') {
+            noise_mv = atof(optarg);
+        } else if (option == 'p') {
+            pickup_mv = atof(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-n noise_mV] [-p pickup_mV]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    SyntheticRun(noise_mv * 1e-3, pickup_mv * 1e-3, truth, voltage);
+
+    CyclesInit();
+    printf("oversample: %d ticks, %d samples per tick, %.1f mV noise, "
+           "%.1f mV pickup, 1 LSB = %.2f mrad\n", TICKS, SAMPLES_PER_TICK,
+           noise_mv, pickup_mv, AIO_LSB / fabs(V_PER_RAD) * 1e3);
+    printf("  %-20s %7s %7s %7s %10s\n", "front-end", "lag ms",
+           "noise", "rms", "ns");
+    for (i = 0; i < FRONT_ENDS; i++) {
+        Filter((FrontEnd) i, voltage, output, &m);
+        Measure(truth, output, &lag, &noise, &error);
+        // (noise and rms errors in mrad)
+        printf("  %-20s %7.1f %7.3f %7.3f %10.1f\n", names[i], lag * 1e3,
+               noise * 1e3, error * 1e3, (double) m.ns / m.samples);
+    }
+    return EXIT_SUCCESS;
+}
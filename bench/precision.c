@@ -0,0 +1,214 @@
+/**
+ * @file precision.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Control Path Precision Benchmark
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Runs the anti-sway control path (an angle filter, the outer loop and
+ * the inner PI loop, for both axes) over a long synthetic run in the
+ * precision discrete-lib was built with, and compares it against the
+ * same math in long double. Build it once per precision (make bench)
+ * to compare the cycle cost and numerical drift of each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "discrete-lib.h"
+#include "filter-design.h"
+
+#include "bench.h"
+
+
+/* Benchmark Parameters */
+
+
+/// The number of samples (about 2.8 h of 5 ms cycles)
+#define NUM_SAMPLES 2000000
+/// The timestep (s)
+#define TIMESTEP 0.005
+/// The order of the Butterworth angle filter
+#define FILTER_ORDER 4
+/// The cutoff of the angle filter (rad/s)
+#define FILTER_CUTOFF (2 * M_PI * 10.0)
+/// Outer loop feedback gain (as in anti-sway.c)
+#define OUTER_GAIN (2 * sqrt(0.47 * 9.81))
+/// Inner loop proportional gain (as in anti-sway.c)
+#define INNER_KP (51.55550206284189 * 2.857)
+/// Inner loop integral gain (as in anti-sway.c)
+#define INNER_KI (33.28586146285062 * 2.857)
+/// Force to voltage (as in io.h)
+#define FORCE_TO_VOLT (0.0062 / (0.41 * 0.11))
+
+
+/* Reference (long double) Control Path */
+
+
+/**
+ * @brief A Reference Biquad
+ * 
+ * A long double transposed direct form II biquad
+*/
+typedef struct {
+    long double b[3];  //!< Numerator
+    long double a[3];  //!< Denominator (a[0] is 1)
+    long double s[2];  //!< Delay registers
+} ReferenceBiquad;
+
+/**
+ * Steps a cascade of reference biquads
+ * 
+ * @param input The input
+ * @param sys The cascade
+ * @param size The size of sys
+ * 
+ * @return The output of the cascade
+*/
+static long double ReferenceCascade(long double input,
+                                    ReferenceBiquad sys[],
+                                    int size) {
+    int i;
+    for (i = 0; i < size; i++) {
+        long double y = sys[i].b[0] * input + sys[i].s[0];
+        sys[i].s[0] = sys[i].b[1] * input - sys[i].a[1] * y + sys[i].s[1];
+        sys[i].s[1] = sys[i].b[2] * input - sys[i].a[2] * y;
+        input = y;
+    }
+    return input;
+}
+
+
+/* Input Signals */
+
+
+/**
+ * Produces a deterministic, noisy test signal
+ * 
+ * @param k The sample index
+ * @param axis The axis (0 or 1)
+ * 
+ * @return The k-th sample of the signal
+*/
+static double Signal(long k, int axis) {
+    static unsigned int seed[2] = {12345u, 54321u};
+    seed[axis] = seed[axis] * 1103515245u + 12345u;
+    double noise = ((seed[axis] >> 8) & 0xFFFF) / 65536.0 - 0.5;
+    double t = k * TIMESTEP;
+    return 0.1 * sin(4.57 * t + axis) + 0.02 * sin(31.0 * t) + 0.005 * noise;
+}
+
+
+/* Main */
+
+
+/**
+ * Runs the precision benchmark
+ * 
+ * @return 0 upon success
+*/
+int main() {
+    static Real angle[2][NUM_SAMPLES];
+    static Real vel[2][NUM_SAMPLES];
+    static Real output[2][NUM_SAMPLES];
+    static long double reference[2][NUM_SAMPLES];
+
+    Biquad filter[2][FILTER_ORDER];
+    ReferenceBiquad ref_filter[2][FILTER_ORDER];
+    Proportional k_p = INNER_KP;
+    Integrator integ[2];
+    long double ref_integ[2] = {0.0, 0.0};
+    long double ref_prev[2] = {0.0, 0.0};
+    int sections = 0;
+    int axis, i;
+    long k;
+
+    for (k = 0; k < NUM_SAMPLES; k++) {
+        for (axis = 0; axis < 2; axis++) {
+            angle[axis][k] = Signal(k, axis);
+            vel[axis][k] = 0.3 * Signal(k, axis);
+        }
+    }
+
+    for (axis = 0; axis < 2; axis++) {
+        sections = DesignButterworthLowPass(FILTER_ORDER, FILTER_CUTOFF,
+                                            TIMESTEP, filter[axis],
+                                            FILTER_ORDER);
+        IntegratorInit(INNER_KI, TIMESTEP, integ + axis);
+        // The reference uses the same (rounded) coefficients and gains,
+        // so that only the arithmetic is compared
+        for (i = 0; i < sections; i++) {
+            ref_filter[axis][i].b[0] = filter[axis][i].numerator[0];
+            ref_filter[axis][i].b[1] = filter[axis][i].numerator[1];
+            ref_filter[axis][i].b[2] = filter[axis][i].numerator[2];
+            ref_filter[axis][i].a[0] = 1.0;
+            ref_filter[axis][i].a[1] = filter[axis][i].denominator[1];
+            ref_filter[axis][i].a[2] = filter[axis][i].denominator[2];
+            ref_filter[axis][i].s[0] = 0.0;
+            ref_filter[axis][i].s[1] = 0.0;
+        }
+    }
+
+    // The control path under test
+    Measurement m;
+    CyclesInit();
+    MeasureStart(&m);
+    for (k = 0; k < NUM_SAMPLES; k++) {
+        for (axis = 0; axis < 2; axis++) {
+            Real filtered = Cascade(angle[axis][k], filter[axis], sections,
+                                    NEG_INF, POS_INF);
+            Real err = (Real) 0.15 + (Real) OUTER_GAIN * filtered -
+                vel[axis][k];
+            output[axis][k] = PID((Real) FORCE_TO_VOLT * err, &k_p,
+                                  integ + axis, NULL, NEG_INF, POS_INF);
+        }
+    }
+    MeasureStop(&m, NUM_SAMPLES);
+
+    // The same path, in long double
+    for (k = 0; k < NUM_SAMPLES; k++) {
+        for (axis = 0; axis < 2; axis++) {
+            long double filtered = ReferenceCascade(angle[axis][k],
+                                                    ref_filter[axis],
+                                                    sections);
+            long double err = 0.15L + (Real) OUTER_GAIN * filtered -
+                vel[axis][k];
+            long double input = (Real) FORCE_TO_VOLT * err;
+            ref_integ[axis] += (long double) integ[axis].gain *
+                (input + ref_prev[axis]);
+            ref_prev[axis] = input;
+            reference[axis][k] = (Real) INNER_KP * input + ref_integ[axis];
+        }
+    }
+
+    // Drift is the error over the last tenth of the run,
+    // compared to the first tenth
+    long double max_err = 0.0, sum_sq = 0.0, first = 0.0, last = 0.0;
+    for (axis = 0; axis < 2; axis++) {
+        for (k = 0; k < NUM_SAMPLES; k++) {
+            long double e = fabsl(output[axis][k] - reference[axis][k]);
+            max_err = e > max_err ? e : max_err;
+            sum_sq += e * e;
+            if (k < NUM_SAMPLES / 10 && e > first) first = e;
+            if (k >= NUM_SAMPLES - NUM_SAMPLES / 10 && e > last) last = e;
+        }
+    }
+
+    printf("precision: %s\n", sizeof(Real) == sizeof(float) ?
+           "single (float32)" : "double (float64)");
+    printf("  cost:    %.2f ns/sample", (double) m.ns / m.samples);
+    if (m.cycles) {
+        printf(", %.1f cycles/sample", (double) m.cycles / m.samples);
+    }
+    printf(" (2 axes, %d-section filter + PI)\n", sections);
+    printf("  error:   max %.3Le V, rms %.3Le V\n", max_err,
+           sqrtl(sum_sq / (2.0L * NUM_SAMPLES)));
+    printf("  drift:   max error %.3Le V (first 10%%) -> %.3Le V "
+           "(last 10%%)\n", first, last);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file soak.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Dispatcher Soak Test
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Runs the dispatcher on the host timer (-DHOST_TIMER) with the mode
+ * threads' periods, phases, priorities and cores, but with synthetic
+ * work: the control and keypad tasks spin for their compute time, and
+ * the display task sleeps (as the LCD write blocks). Every task's
+ * timing statistics (including the mean period, which shows drift) are
+ * printed every interval and at the end, so that runs of hours show
+ * rare latency spikes.
+ * 
+ * Like the target, it needs root (or RLIMIT_RTPRIO and RLIMIT_MEMLOCK).
+ * 
+ * Usage: soak [-t seconds] [-i interval_seconds] [-c control_us]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "setup.h"
+#include "thread-lib.h"
+#include "dispatcher.h"
+
+
+/* Soak Parameters */
+
+
+/// Default run time (s)
+#define SOAK_SECONDS 60
+/// Default time between reports (s)
+#define SOAK_INTERVAL 600
+/// Default control task compute time (us)
+#define SOAK_CONTROL_US 300
+/// Keypad task compute time (us)
+#define SOAK_KEYPAD_US 20
+/// Display task blocking time (us)
+#define SOAK_DISPLAY_US 5000
+
+
+/* Synthetic Tasks */
+
+
+/**
+ * @brief A Synthetic Task
+*/
+typedef struct {
+    ThreadResource resource;  ///< must come first (the thread's argument)
+    pthread_t thread;  ///< the task's thread
+    const char *name;  ///< the task's name
+    uint32_t period;  ///< release period (base ticks)
+    uint32_t phase;  ///< release phase offset (base ticks)
+    int priority;  ///< SCHED_FIFO priority
+    int cpu;  ///< core
+    uint32_t spin_us;  ///< busy time per release (us)
+    uint32_t sleep_us;  ///< blocking time per release (us)
+} SoakTask;
+
+/// The tasks, as the anti-sway mode runs them
+static SoakTask tasks[] = {
+    {.name = "control", .period = CONTROL_PERIOD, .phase = CONTROL_PHASE,
+     .priority = CONTROL_PRIORITY, .cpu = CONTROL_CPU,
+     .spin_us = SOAK_CONTROL_US},
+    {.name = "keypad", .period = KEYPAD_PERIOD, .phase = KEYPAD_PHASE,
+     .priority = KEYPAD_PRIORITY, .cpu = KEYPAD_CPU,
+     .spin_us = SOAK_KEYPAD_US},
+    {.name = "display", .period = DISPLAY_PERIOD, .phase = DISPLAY_PHASE,
+     .priority = DISPLAY_PRIORITY, .cpu = DISPLAY_CPU,
+     .sleep_us = SOAK_DISPLAY_US},
+};
+
+/// The number of tasks
+#define NUM_TASKS ((int) (sizeof(tasks) / sizeof(tasks[0])))
+
+/// Local Error Code
+static int error;
+
+/**
+ * @brief Synthetic Task Thread Function
+ * 
+ * @param resource A pointer to the task's SoakTask
+ * 
+ * @return NULL
+*/
+static void *SoakThread(void *resource) {
+    ThreadResource *thread_resource = (ThreadResource *) resource;
+    SoakTask *task = (SoakTask *) resource;
+
+    while (thread_resource->irq_thread_rdy) {
+        uint32_t irq_assert = 0;
+        TASK_TRIGGER(irq_assert, thread_resource);
+        if (irq_assert) {
+            uint64_t end = ThreadClockNs() + task->spin_us * 1000ull;
+            while (ThreadClockNs() < end) {}
+            if (task->sleep_us) usleep(task->sleep_us);
+            TASK_COMPLETE(thread_resource);
+        }
+    }
+    EXIT_THREAD();
+}
+
+/**
+ * Prints every task's timing statistics
+ * 
+ * @param elapsed The time since the start (s)
+*/
+static void Report(unsigned elapsed) {
+    int i;
+    printf("\n[%u s]\n", elapsed);
+    for (i = 0; i < NUM_TASKS; i++) {
+        ThreadStatsPrint(&(tasks[i].resource));
+    }
+    fflush(stdout);
+}
+
+/**
+ * Runs the soak test
+ * 
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * 
+ * @return 0 upon success
+*/
+int main(int argc, char *argv[]) {
+    unsigned seconds = SOAK_SECONDS;
+    unsigned interval = SOAK_INTERVAL;
+    unsigned elapsed = 0;
+    int i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-t") == 0) {
+            seconds = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            interval = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            tasks[0].spin_us = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+    if (interval == 0) interval = SOAK_INTERVAL;
+
+    printf("soak: %u s, base tick %u us, control compute %u us\n",
+           seconds, BTI_US, tasks[0].spin_us);
+    VERIFY(error, LockMemory());
+    VERIFY(error, DispatcherFork());
+    for (i = 0; i < NUM_TASKS; i++) {
+        SoakTask *task = tasks + i;
+        VERIFY(error, DispatcherRegister(&(task->resource), task->name,
+                                         task->period, task->phase,
+                                         task->priority, task->cpu));
+        START_THREAD(task->thread, SoakThread, task->resource);
+    }
+
+    while (elapsed < seconds) {
+        unsigned step = seconds - elapsed < interval ?
+                        seconds - elapsed : interval;
+        sleep(step);
+        elapsed += step;
+        if (elapsed < seconds) Report(elapsed);
+    }
+
+    for (i = 0; i < NUM_TASKS; i++) {
+        STOP_THREAD(tasks[i].thread, tasks[i].resource);
+    }
+    printf("\n[%u s]\n", elapsed);
+    for (i = 0; i < NUM_TASKS; i++) {
+        DispatcherUnregister(&(tasks[i].resource));
+    }
+    VERIFY(error, DispatcherJoin());
+    return UnlockMemory();
+}
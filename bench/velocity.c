@@ -0,0 +1,358 @@
+/**
+ * @file velocity.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Encoder Velocity Estimator Benchmark
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Runs the trolley velocity estimators over encoder counts read once
+ * per base tick, and reports each one's noise against its phase lag:
+ * the lag is the delay that best lines the estimate up with the true
+ * velocity, and the noise is the RMS error that remains once it is
+ * lined up. Both are reported at speed and at low speed (under
+ * LOW_SPEED), with the cost of an estimate.
+ * 
+ * By default, the counts are of a synthetic run (cruising and
+ * reversing at the keypad's speed with the rope swaying, then creeping,
+ * then swaying in place), read with jittered timestamps, where the true
+ * velocity is known. Given a logged run instead, as a text file of
+ * trolley positions (m), one per base tick (e.g. a tracking run's
+ * trolley_pos_x, by numpy.savetxt()), the counts are recovered from
+ * the positions, and the true velocity is taken to be a zero-phase
+ * (centered, quadratic) fit to them, whose own error (quantization,
+ * and bias where the trolley reverses) then sets a floor under every
+ * estimator's noise.
+ * 
+ * Usage: velocity [-f positions_file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "discrete-lib.h"
+
+#include "bench.h"
+
+
+/* Benchmark Parameters */
+
+
+/// The most samples in a run (10 min of 5 ms ticks)
+#define MAX_SAMPLES 120000
+/// The base tick (s)
+#define TIMESTEP 0.005
+/// The synthetic run's length (samples, 2 min)
+#define SYNTHETIC_SAMPLES 24000
+/// The timestamps' jitter (s, peak)
+#define JITTER 50e-6
+/// Meters per count (M_PER_REV / ENC_CNT_REV, as in hal.h)
+#define M_PER_COUNT (0.01267 * M_PI / 2000.0)
+/// The speed under which it is low speed (m/s)
+#define LOW_SPEED 0.005
+/// The longest lag searched (samples)
+#define MAX_LAG 24
+/// The steps per sample of the lag search
+#define LAG_STEPS 10
+/// The half-width of the zero-phase fit to a logged run (samples)
+#define FIT_HALF_WIDTH 4
+/// The tracking loop's bandwidth (rad/s, as in io.c)
+#define PLL_BANDWIDTH (2 * M_PI * 10.0)
+/// The counts under which the tracking loop is used (as in io.c)
+#define PLL_COUNTS 2
+/// The window of the moving-average difference (samples)
+#define AVERAGE_WINDOW 4
+
+
+/* Runs */
+
+
+/**
+ * @brief A Run
+ * 
+ * The counts read each base tick, and the true velocity
+*/
+typedef struct {
+    int32_t counts[MAX_SAMPLES];  //!< The counts
+    double time[MAX_SAMPLES];     //!< Their timestamps (s)
+    double truth[MAX_SAMPLES];    //!< The true velocity (m/s)
+    long length;                  //!< The number of samples
+} Run;
+
+/**
+ * The synthetic run's true velocity
+ * 
+ * @param t The time (s)
+ * 
+ * @return The velocity (m/s)
+*/
+static double SyntheticVelocity(double t) {
+    // The rope's natural frequency (rad/s), for a 0.47 m rope
+    const double sway = sqrt(9.81 / 0.47);
+    if (t < 40.0) {
+        // Cruising at the keypad's speed, reversing every 4 s, with the
+        // PI loop's (smooth) steps
+        double phase = fmod(t, 8.0);
+        double step = 0.5 - 0.5 * tanh((phase - 4.0) / 0.15);
+        step -= 0.5 - 0.5 * tanh(phase / 0.15);
+        return 0.15 * (2.0 * step - 1.0) + 0.02 * sin(sway * t);
+    } else if (t < 80.0) {
+        // Creeping
+        return 0.002 * sin(2 * M_PI * 0.2 * t);
+    }
+    // Swaying in place
+    return 0.03 * sin(sway * t);
+}
+
+/**
+ * Produces the synthetic run
+ * 
+ * @param run A return parameter, which becomes the run
+*/
+static void SyntheticRun(Run *run) {
+    unsigned int seed = 12345u;
+    double position = 0.1, t = 0.0;
+    long k;
+    int i;
+
+    for (k = 0; k < SYNTHETIC_SAMPLES; k++) {
+        seed = seed * 1103515245u + 12345u;
+        double jitter = (((seed >> 8) & 0xFFFF) / 32768.0 - 1.0) * JITTER;
+        double next = k * TIMESTEP + jitter;
+        // Simpson's rule, over fine steps
+        for (i = 0; i < 50 && k > 0; i++) {
+            double a = t + (next - t) * i / 50;
+            double b = t + (next - t) * (i + 1) / 50;
+            position += (b - a) / 6 * (SyntheticVelocity(a) +
+                4 * SyntheticVelocity((a + b) / 2) + SyntheticVelocity(b));
+        }
+        t = next;
+        run->counts[k] = (int32_t) floor(position / M_PER_COUNT);
+        run->time[k] = t;
+        run->truth[k] = SyntheticVelocity(t);
+    }
+    run->length = SYNTHETIC_SAMPLES;
+}
+
+/**
+ * Loads a logged run
+ * 
+ * @param path The file of trolley positions (m), one per base tick
+ * @param run A return parameter, which becomes the run
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+*/
+static int LoggedRun(const char *path, Run *run) {
+    FILE *file = fopen(path, "r");
+    double position;
+    long k, j, edge;
+
+    if (file == NULL) return EXIT_FAILURE;
+    run->length = 0;
+    while (run->length < MAX_SAMPLES &&
+           fscanf(file, "%lf", &position) == 1) {
+        run->counts[run->length] =
+            (int32_t) floor(position / M_PER_COUNT + 0.5);
+        run->time[run->length] = run->length * TIMESTEP;
+        run->length++;
+    }
+    fclose(file);
+    if (run->length <= 2 * FIT_HALF_WIDTH) return EXIT_FAILURE;
+
+    // The slope of a centered least-squares quadratic (the quadratic
+    // term does not change the slope at the center)
+    double norm = 0.0;
+    for (j = -FIT_HALF_WIDTH; j <= FIT_HALF_WIDTH; j++) norm += j * j;
+    for (k = 0; k < run->length; k++) {
+        double sum = 0.0;
+        for (j = -FIT_HALF_WIDTH; j <= FIT_HALF_WIDTH; j++) {
+            edge = k + j < 0 ? 0 :
+                (k + j >= run->length ? run->length - 1 : k + j);
+            sum += j * (double) run->counts[edge];
+        }
+        run->truth[k] = sum / norm / TIMESTEP * M_PER_COUNT;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* Estimators */
+
+
+/**
+ * @brief An Estimator Under Test
+*/
+typedef enum {
+    DIFFERENCE,  //!< The count difference over one base tick (ENC_2_VEL)
+    AVERAGE,     //!< The count difference over AVERAGE_WINDOW base ticks
+    PLL,         //!< The tracking loop alone
+    WINDOW,      //!< The adaptive window alone
+    ADAPTIVE,    //!< The adaptive window, with the tracking loop
+    ESTIMATORS   //!< The number of estimators
+} Estimator;
+
+/// The estimators' names
+static const char *names[ESTIMATORS] = {"difference (1 tick)",
+                                        "difference (4 ticks)",
+                                        "tracking loop",
+                                        "adaptive window",
+                                        "adaptive + tracking"};
+
+/**
+ * Runs an estimator over a run
+ * 
+ * @param estimator The estimator
+ * @param run The run
+ * @param output A return parameter, which becomes the estimates (m/s)
+ * @param m A return parameter, which becomes the cost
+*/
+static void Estimate(Estimator estimator,
+                     const Run *run,
+                     double output[],
+                     Measurement *m) {
+    VelocityEstimator est;
+    long k, first;
+
+    VelocityEstimatorInit(PLL_BANDWIDTH,
+                          estimator == WINDOW ? 0 : PLL_COUNTS, &est);
+    MeasureStart(m);
+    for (k = 0; k < run->length; k++) {
+        switch (estimator) {
+            case DIFFERENCE:
+            case AVERAGE:
+                first = k - (estimator == DIFFERENCE ? 1 : AVERAGE_WINDOW);
+                first = first < 0 ? 0 : first;
+                output[k] = (run->counts[k] - run->counts[first]) /
+                    ((k - first) * TIMESTEP + (k == first));
+                break;
+            case PLL:
+                EstimateVelocity(&est, run->counts[k], run->time[k]);
+                output[k] = est.pll_vel;
+                break;
+            default:
+                output[k] = EstimateVelocity(&est, run->counts[k],
+                                             run->time[k]);
+                break;
+        }
+    }
+    MeasureStop(m, run->length);
+    for (k = 0; k < run->length; k++) output[k] *= M_PER_COUNT;
+}
+
+
+/* Metrics */
+
+
+/**
+ * @brief An Estimator's Noise and Lag
+*/
+typedef struct {
+    double lag;    //!< The lag (s)
+    double noise;  //!< The RMS error, once lined up (m/s)
+    double error;  //!< The RMS error, as is (m/s)
+} Metrics;
+
+/**
+ * Measures an estimator's noise against its lag, over the samples at
+ * speed (or at low speed), which are NAN if there are none
+ * 
+ * @param run The run
+ * @param output The estimates (m/s)
+ * @param low Whether to measure the samples at low speed
+ * @param result A return parameter, which becomes the metrics
+*/
+static void Measure(const Run *run,
+                    const double output[],
+                    int low,
+                    Metrics *result) {
+    double best = INFINITY;
+    int step;
+    long k;
+
+    result->lag = NAN;
+    result->noise = NAN;
+    result->error = NAN;
+    for (step = 0; step <= MAX_LAG * LAG_STEPS; step++) {
+        double lag = (double) step / LAG_STEPS;
+        int whole = (int) lag;
+        double part = lag - whole;
+        double sum = 0.0;
+        long count = 0;
+        for (k = MAX_LAG + 1; k < run->length; k++) {
+            // The true velocity, lag samples ago
+            double truth = (1.0 - part) * run->truth[k - whole] +
+                part * run->truth[k - whole - 1];
+            if ((fabs(run->truth[k]) < LOW_SPEED) != low) continue;
+            sum += (output[k] - truth) * (output[k] - truth);
+            count++;
+        }
+        if (count == 0) return;
+        if (step == 0) result->error = sqrt(sum / count);
+        if (sum / count < best) {
+            best = sum / count;
+            result->lag = lag * TIMESTEP;
+        }
+    }
+    result->noise = sqrt(best);
+}
+
+
+/* Main */
+
+
+/**
+ * Runs the velocity estimator benchmark
+ * 
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * 
+ * @return 0 upon success
+*/
+int main(int argc, char *argv[]) {
+    static Run run;
+    static double output[MAX_SAMPLES];
+    const char *path = NULL;
+    Metrics fast, slow;
+    Measurement m;
+    int option, i;
+
+    while ((option = getopt(argc, argv, "f:")) != -1) {
+        if (option == 'f') {
+            path = optarg;
+        } else {
+            fprintf(stderr, "Usage: %s [-f positions_file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (path == NULL) {
+        SyntheticRun(&run);
+    } else if (LoggedRun(path, &run)) {
+        fprintf(stderr, "Cannot load a run from %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    CyclesInit();
+    printf("velocity: %s, %ld samples (%.0f s), 1 count = %.1f um\n",
+           path == NULL ? "synthetic run" : path, run.length,
+           run.length * TIMESTEP, M_PER_COUNT * 1e6);
+    printf("  %-22s %23s %23s %10s\n", "", "at speed", "at low speed",
+           "cost");
+    printf("  %-22s %7s %7s %7s %7s %7s %7s %10s\n", "estimator",
+           "lag ms", "noise", "rms", "lag ms", "noise", "rms", "ns");
+    for (i = 0; i < ESTIMATORS; i++) {
+        Estimate((Estimator) i, &run, output, &m);
+        Measure(&run, output, 0, &fast);
+        Measure(&run, output, 1, &slow);
+        // (noise and rms errors in mm/s)
+        printf("  %-22s %7.1f %7.2f %7.2f %7.1f %7.3f %7.3f %10.1f\n",
+               names[i], fast.lag * 1e3, fast.noise * 1e3,
+               fast.error * 1e3, slow.lag * 1e3, slow.noise * 1e3,
+               slow.error * 1e3, (double) m.ns / m.samples);
+    }
+    return EXIT_SUCCESS;
+}
@@ -13,6 +13,7 @@
 #include <stdbool.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
@@ -20,7 +21,9 @@
 #include "io.h"
 #include "thread-lib.h"
 #include "discrete-lib.h"
+#include "control-chain.h"
 #include "record.h"
+#include "error.h"
 
 #include "anti-sway.h"
 
@@ -49,19 +52,31 @@ static double K_ity = 0.8*31.59324977878787;
 /* Control Loop Scheme */
 
 
+/**
+ * @brief Anti-Sway Mode Feedback Control Chain
+ * 
+ * The outer loop adds the angle feedback (outer_feedback) to the
+ * reference velocity, and the inner PI loop (inner_prop, inner_int)
+ * drives the velocity error to zero through the motor voltage
+*/
+#define ANTI_SWAY_CHAIN(OP) \
+    OP(INPUT, vel_ref) \
+    OP(ADD_SCALED, angle, outer_feedback) \
+    OP(TAP, outer_output) \
+    OP(SUB, vel) \
+    OP(TAP, vel_err) \
+    OP(SCALE, FORCE_TO_VOLTAGE(1.0)) \
+    OP(PI, inner_prop, inner_int) \
+    OP(SATURATE, MOTOR_V_LIM_L, MOTOR_V_LIM_H)
+
+DEFINE_CONTROL_CHAIN(AntiSwayChain, ANTI_SWAY_CHAIN)
+
 /**
  * @brief Anti-Sway Mode Feedback Control Block
  * 
  * Represents the Inner and Outer Loop Elements
 */
-typedef struct {
-    /// Outer feedback
-    Proportional outer_feedback;
-    /// Inner PI Proportional Gain
-    Proportional inner_prop;
-    /// Innner PI Integral Term
-    Integrator inner_int;
-} AntiSwayControlScheme;
+typedef AntiSwayChainState AntiSwayControlScheme;
 
 
 /* Control-Loop Variables */
@@ -86,19 +101,78 @@ static int error;
 static FileID_t file = -1;
 /// The file Name
 static char *data_file_name = "anti-sway.mat";
-/// The number of entries
-#define DATA_LEN 20
-/// The data names
-static char *data_names[DATA_LEN] = {"id", "t",
-                                     "vel_ref_x", "vel_ref_y",
-                                     "angle_x", "angle_y",
-                                     "trolley_vel_x", "trolley_vel_y",
-                                     "vel_err_x", "voltage_x", "int_out_x", "Kp_x'", "Ki_x'", "loss_x",
-                                     "vel_err_y", "voltage_y", "int_out_y", "Kp_y'", "Ki_y'", "loss_y"};
-/// Buffer for data
-static double data[DATA_LEN];
-/// Pointer to next data point to insert into buffer
-static double *data_buff = data;
+/// The expected recording time (s), reserved up front
+#define DATA_DURATION 120.0
+
+/**
+ * @brief One Motor's Control Law Terms, as Recorded
+*/
+typedef struct {
+    Real vel_err;  ///< velocity error
+    Voltage voltage;  ///< output voltage
+    Real int_out;  ///< integrator output
+    Real Kp;  ///< effective proportional gain
+    Real Ki;  ///< effective integral gain
+    Real loss;  ///< squared velocity error
+} AntiSwayAxisData;
+
+/**
+ * @brief An Anti-Sway Sample, as Recorded
+*/
+typedef struct {
+    int32_t id;  ///< run ID
+    double t;  ///< time since the run started (s)
+    Velocity vel_ref_x;  ///< reference velocity (x)
+    Velocity vel_ref_y;  ///< reference velocity (y)
+    Angle angle_x;  ///< rope angle (x)
+    Angle angle_y;  ///< rope angle (y)
+    Velocity trolley_vel_x;  ///< trolley velocity (x)
+    Velocity trolley_vel_y;  ///< trolley velocity (y)
+    AntiSwayAxisData axis[2];  ///< control law terms (x, then y)
+} AntiSwayData;
+
+/// The data channels
+static const RecordChannel data_channels[] = {
+    RECORD_CHANNEL("id", AntiSwayData, id, MAT_INT32),
+    RECORD_CHANNEL("t", AntiSwayData, t, MAT_DOUBLE),
+    RECORD_CHANNEL("vel_ref_x", AntiSwayData, vel_ref_x, MAT_SINGLE),
+    RECORD_CHANNEL("vel_ref_y", AntiSwayData, vel_ref_y, MAT_SINGLE),
+    RECORD_CHANNEL("angle_x", AntiSwayData, angle_x, MAT_SINGLE),
+    RECORD_CHANNEL("angle_y", AntiSwayData, angle_y, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_vel_x", AntiSwayData, trolley_vel_x, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_vel_y", AntiSwayData, trolley_vel_y, MAT_SINGLE),
+    RECORD_CHANNEL("vel_err_x", AntiSwayData, axis[0].vel_err, MAT_REAL),
+    RECORD_CHANNEL("voltage_x", AntiSwayData, axis[0].voltage, MAT_SINGLE),
+    RECORD_CHANNEL("int_out_x", AntiSwayData, axis[0].int_out, MAT_REAL),
+    RECORD_CHANNEL("Kp_x'", AntiSwayData, axis[0].Kp, MAT_REAL),
+    RECORD_CHANNEL("Ki_x'", AntiSwayData, axis[0].Ki, MAT_REAL),
+    RECORD_CHANNEL("loss_x", AntiSwayData, axis[0].loss, MAT_REAL),
+    RECORD_CHANNEL("vel_err_y", AntiSwayData, axis[1].vel_err, MAT_REAL),
+    RECORD_CHANNEL("voltage_y", AntiSwayData, axis[1].voltage, MAT_SINGLE),
+    RECORD_CHANNEL("int_out_y", AntiSwayData, axis[1].int_out, MAT_REAL),
+    RECORD_CHANNEL("Kp_y'", AntiSwayData, axis[1].Kp, MAT_REAL),
+    RECORD_CHANNEL("Ki_y'", AntiSwayData, axis[1].Ki, MAT_REAL),
+    RECORD_CHANNEL("loss_y", AntiSwayData, axis[1].loss, MAT_REAL)};
+/// The number of data channels
+#define DATA_LEN ((int) (sizeof(data_channels) / sizeof(data_channels[0])))
+/// The sample being built
+static AntiSwayData data;
+/// Pointer to the next motor's terms to insert into the sample
+static AntiSwayAxisData *data_axis = data.axis;
+
+// Toggle on (uncomment) to record long sessions sparsely: the gains
+// once a second, and otherwise only around large swings and limit hits,
+// compressed (expand anti-sway.series with tools/unpack.c)
+/// Long Session Recording
+// #define LONG_SESSION
+#ifdef LONG_SESSION
+/// Samples between recorded gains (1 s)
+#define GAIN_DECIMATION 200
+/// Samples kept before and after each large swing or limit hit (2 s)
+#define CAPTURE_SAMPLES 400
+/// Rope angle that counts as a large swing (rad)
+#define SWING_THRESHOLD 0.1
+#endif
 /// ID variable
 static int id = 1;
 /// timestamp
@@ -111,19 +185,46 @@ static double t = 0.0;
 // see the software documentation
 
 // Toggle on (uncomment) to put Anti-Sway into
-/// Tuning Mode
+/// Tuning Mode (which leaves each run after 550 samples; -DNO_TUNING,
+/// e.g. make sim SIM_TUNING=off, builds without it)
+#ifndef NO_TUNING
 #define TUNING
+#endif
 #ifdef TUNING
 /// The tuning file
 static FileID_t tuning_file = -1;
 /// The name of the tuning file
 static char *tuning_file_name = "anti-sway-tuning.mat";
-/// The number of array entries within the tuning file
-#define TUNING_DATA_LEN 10
-/// The names of the array entries for the tuning file
-static char *tuning_data_names[TUNING_DATA_LEN] = {"count_x", "count_y",
-                                                   "dKp_x", "dKi_x", "dKp_y", "dKi_y",
-												   "Kp_x", "Ki_x", "Kp_y", "Ki_y"};
+/**
+ * @brief A Tuning Step, as Recorded
+*/
+typedef struct {
+    int32_t count_x;  ///< data points in the x gradients
+    int32_t count_y;  ///< data points in the y gradients
+    double dKp_x;  ///< normalized loss gradient in Kp (x)
+    double dKi_x;  ///< normalized loss gradient in Ki (x)
+    double dKp_y;  ///< normalized loss gradient in Kp (y)
+    double dKi_y;  ///< normalized loss gradient in Ki (y)
+    double Kp_x;  ///< new proportional gain (x)
+    double Ki_x;  ///< new integral gain (x)
+    double Kp_y;  ///< new proportional gain (y)
+    double Ki_y;  ///< new integral gain (y)
+} TuningData;
+/// The channels of the tuning file
+static const RecordChannel tuning_data_channels[] = {
+    RECORD_CHANNEL("count_x", TuningData, count_x, MAT_INT32),
+    RECORD_CHANNEL("count_y", TuningData, count_y, MAT_INT32),
+    RECORD_CHANNEL("dKp_x", TuningData, dKp_x, MAT_DOUBLE),
+    RECORD_CHANNEL("dKi_x", TuningData, dKi_x, MAT_DOUBLE),
+    RECORD_CHANNEL("dKp_y", TuningData, dKp_y, MAT_DOUBLE),
+    RECORD_CHANNEL("dKi_y", TuningData, dKi_y, MAT_DOUBLE),
+    RECORD_CHANNEL("Kp_x", TuningData, Kp_x, MAT_DOUBLE),
+    RECORD_CHANNEL("Ki_x", TuningData, Ki_x, MAT_DOUBLE),
+    RECORD_CHANNEL("Kp_y", TuningData, Kp_y, MAT_DOUBLE),
+    RECORD_CHANNEL("Ki_y", TuningData, Ki_y, MAT_DOUBLE)};
+/// The number of channels within the tuning file
+#define TUNING_DATA_LEN \
+    ((int) (sizeof(tuning_data_channels) / sizeof(tuning_data_channels[0])))
 /// The gradient component of the loss with respect to Kp,
 /// for both x and y directions
 static double dKp[2];
@@ -222,20 +323,17 @@ static void *AntiSwayModeThread(void *resource);
  * @param vel_input The measured velocity of the motor
  * @param scheme A pointer to the AntiSwayControlScheme structure
  * used to execute the control law
- * @param SetVoltage The function that sets the voltage of the
- * appropriate motor
  * 
- * @return 0 upon success, negative otherwise
+ * @return The voltage to apply to the appropriate motor
  * 
  * @pre scheme was not modified before use of this function
  * @post scheme is now updated with the input and outputs for
  * the respective control scheme
 */
-static inline int AntiSwayControlLaw(Velocity vel_ref,
-                                     Angle angle_input,
-                                     Velocity vel_input,
-                                     AntiSwayControlScheme *scheme,
-                                     int (* SetVoltage)(Voltage voltage));
+static inline Voltage AntiSwayControlLaw(Velocity vel_ref,
+                                         Angle angle_input,
+                                         Velocity vel_input,
+                                         AntiSwayControlScheme *scheme);
 
 
 /* Anti-Sway Mode Function Definitions */
@@ -244,8 +342,14 @@ static inline int AntiSwayControlLaw(Velocity vel_ref,
 int AntiSwayFork() {
     SetupScheme(&x_control, K_ptx, K_itx, m_dt + m_p);
     SetupScheme(&y_control, K_pty, K_ity, m_st + m_p);
-    if (file == -1) {
-        file = OpenDataFile(data_file_name, data_names, DATA_LEN);
+    if (file < 0) {
+        file = OpenDataFile(data_file_name, data_channels, DATA_LEN,
+                            sizeof(AntiSwayData), DATA_DURATION);
+        // Without its data file, the mode does not start
+        if (file < 0) {
+            u_error = EFILE;
+            return EFILE;
+        }
 
         // Record the mass in both directions
         RecordValue(file, "M_x", m_dt);
@@ -260,10 +364,31 @@ int AntiSwayFork() {
 		RecordValue(file, "Kp_y", y_control.inner_prop / (m_st + m_p));
 		RecordValue(file, "Ki_y", y_control.inner_int.gain * 2 / BTI_S / (m_st + m_p));
 		RecordValue(file, "K_y", y_control.outer_feedback);
+        // Headline metrics of each run, in the run index
+        RecordSetMetric(file, "angle_x");
+        RecordSetMetric(file, "angle_y");
+        RecordSetMetric(file, "vel_err_x");
+        RecordSetMetric(file, "vel_err_y");
+#ifdef LONG_SESSION
+        RecordSetCompression(file, true);
+        RecordSetChannel(file, "Kp_x'", true, GAIN_DECIMATION);
+        RecordSetChannel(file, "Ki_x'", true, GAIN_DECIMATION);
+        RecordSetChannel(file, "Kp_y'", true, GAIN_DECIMATION);
+        RecordSetChannel(file, "Ki_y'", true, GAIN_DECIMATION);
+        RecordSetTrigger(file, "angle_x", SWING_THRESHOLD);
+        RecordSetTrigger(file, "angle_y", SWING_THRESHOLD);
+        RecordSetCapture(file, CAPTURE_SAMPLES, CAPTURE_SAMPLES);
+#endif
     }
 #ifdef TUNING
-    if (tuning_file == -1) {
-    	tuning_file = OpenDataFile(tuning_file_name, tuning_data_names, TUNING_DATA_LEN);
+    if (tuning_file < 0) {
+    	// One sample per run, so the smallest reservation will do
+    	tuning_file = OpenDataFile(tuning_file_name, tuning_data_channels,
+    	                           TUNING_DATA_LEN, sizeof(TuningData), 0.0);
+        if (tuning_file < 0) {
+            u_error = EFILE;
+            return EFILE;
+        }
 
         // Recording Learning Rates in both directions
     	RecordValue(tuning_file, "lr_x", LR_X);
@@ -279,17 +404,22 @@ int AntiSwayFork() {
 
 #endif
     KeyboardControlFork();
-    REGISTER_TIMER(anti_sway_resource);
+    REGISTER_TASK(anti_sway_resource, CONTROL_PERIOD, CONTROL_PHASE,
+                  CONTROL_PRIORITY, CONTROL_CPU);
     START_THREAD(anti_sway_thread, AntiSwayModeThread, anti_sway_resource);
     return EXIT_SUCCESS;
 }
 
 int AntiSwayJoin() {
     STOP_THREAD(anti_sway_thread, anti_sway_resource);
-    UNREGISTER_TIMER(anti_sway_resource);
+    UNREGISTER_TASK(anti_sway_resource);
+    // Keep the lead-up to a limit hit, if only capturing windows
+    if (u_error) RecordTrigger(file);
+    RecordThreadStats(file, id, &anti_sway_resource);
+    // Write the run to its own segment, in the background
+    RecordEndRun(file, id);
     KeyboardControlJoin();
-    SetXVoltage(0.0);
-    SetYVoltage(0.0);
+    SetVoltages(0.0, 0.0);
 #ifdef TUNING
 
     // Update Previous Gains to Current Gains
@@ -315,8 +445,8 @@ int AntiSwayJoin() {
 	printf("Gradients: (dKp_x: %.3e), (dKi_x: %.3e), (dKp_y: %.3e), (dKi_y: %.3e)\n", dKp[0], dKi[0], dKp[1], dKi[1]);
 	printf("Normalization: (dKp_x: %d), (dKi_x: %d), (dKp_y: %d), (dKi_y: %d)\n", total_pts[0], total_pts[0], total_pts[1], total_pts[1]);
 	printf("New gains: (Kp_x: %.3e), (Ki_x: %.3e), (Kp_y: %.3e), (Ki_y: %.3e)\n", K_ptx, K_itx, K_pty, K_ity);
-	double data[] = {total_pts[0], total_pts[1], dKp[0], dKi[0], dKp[1], dKi[1], K_ptx, K_itx, K_pty, K_ity};
-	RecordData(tuning_file, data, TUNING_DATA_LEN);
+	TuningData tuning = {total_pts[0], total_pts[1], dKp[0], dKi[0], dKp[1], dKi[1], K_ptx, K_itx, K_pty, K_ity};
+	RecordData(tuning_file, &tuning);
     prev_int_i = 0;
     if (id == 1) {
         int_Kp_first = false;
@@ -334,10 +464,10 @@ static void *AntiSwayModeThread(void *resource) {
 
     while (thread_resource->irq_thread_rdy) {
         uint32_t irq_assert = 0;
-        TIMER_TRIGGER(irq_assert, thread_resource);
+        TASK_TRIGGER(irq_assert, thread_resource);
         Velocities reference_vel = {0.0, 0.0};  // Reference Velocity
-        Angles input;  // Rope Angle
-        Velocities trolley_vel;  // Trolley Velocity
+        SensorSnapshot sensors;  // Rope Angle and Trolley Velocity
+        Voltage x_voltage, y_voltage;  // Motor Voltages
 
         if (irq_assert) {
             // Do the loop for both motors
@@ -353,41 +483,34 @@ static void *AntiSwayModeThread(void *resource) {
                 EXIT_THREAD();
             }
 #endif
-            if (GetAngle(&input)) {
-                EXIT_THREAD();
-            }
-            if (GetTrolleyVelocity(&trolley_vel)) {
+            if (ReadSensorSnapshot(&sensors)) {
                 EXIT_THREAD();
             }
             // Record Data
-            *data_buff++ = id;
-            *data_buff++ = (t += BTI_S);
-            *data_buff++ = reference_vel.x_vel;
-            *data_buff++ = reference_vel.y_vel;
-            *data_buff++ = input.x_angle;
-            *data_buff++ = input.y_angle;
-            *data_buff++ = trolley_vel.x_vel;
-            *data_buff++ = trolley_vel.y_vel;
-            // Run both control laws
-            if (AntiSwayControlLaw(reference_vel.x_vel,
-                                   input.x_angle,
-                                   trolley_vel.x_vel,
-                                   &x_control,
-                                   SetXVoltage)) {
+            data.id = id;
+            data.t = (t += BTI_S);
+            data.vel_ref_x = reference_vel.x_vel;
+            data.vel_ref_y = reference_vel.y_vel;
+            data.angle_x = sensors.angle.x_angle;
+            data.angle_y = sensors.angle.y_angle;
+            data.trolley_vel_x = sensors.vel.x_vel;
+            data.trolley_vel_y = sensors.vel.y_vel;
+            // Run both control laws, and write both motors at once
+            x_voltage = AntiSwayControlLaw(reference_vel.x_vel,
+                                           sensors.angle.x_angle,
+                                           sensors.vel.x_vel,
+                                           &x_control);
+            y_voltage = AntiSwayControlLaw(reference_vel.y_vel,
+                                           sensors.angle.y_angle,
+                                           sensors.vel.y_vel,
+                                           &y_control);
+            if (SetVoltages(x_voltage, y_voltage)) {
                 EXIT_THREAD();
             }
-            if (AntiSwayControlLaw(reference_vel.y_vel,
-                                   input.y_angle,
-                                   trolley_vel.y_vel,
-                                   &y_control,
-                                   SetYVoltage)) {
-                EXIT_THREAD();
-            }
-            // Send data into file
-            RecordData(file, data, DATA_LEN);
-            data_buff = data;
-
-            Irq_Acknowledge(irq_assert);
+            TASK_COMPLETE(thread_resource);
+            // Queue data for the recorder
+            RecordSample(file, &data);
+            data_axis = data.axis;
 #ifdef TUNING
             if (++prev_int_i == 550) {
                 printf("Exiting Thread\n");
@@ -401,30 +524,24 @@ static void *AntiSwayModeThread(void *resource) {
     EXIT_THREAD();
 }
 
-static inline int AntiSwayControlLaw(Velocity vel_ref,
-                                     Angle angle_input,
-                                     Velocity vel_input,
-                                     AntiSwayControlScheme *scheme,
-                                     int (* SetVoltage)(Voltage voltage)) {
-    double outer_output = vel_ref + scheme->outer_feedback * angle_input;
-
-    double vel_err =  outer_output - vel_input;
-    *data_buff++ = vel_err;
-
-    Voltage final_output = PID(FORCE_TO_VOLTAGE(vel_err),
-                               &(scheme->inner_prop),
-                               &(scheme->inner_int),
-                               NULL,
-                               MOTOR_V_LIM_L,
-                               MOTOR_V_LIM_H);
-
-    static int error;
-    VERIFY(error, SetVoltage(final_output));
-    *data_buff++ = final_output;
-    *data_buff++ = scheme->inner_int.prev_output;
+static inline Voltage AntiSwayControlLaw(Velocity vel_ref,
+                                         Angle angle_input,
+                                         Velocity vel_input,
+                                         AntiSwayControlScheme *scheme) {
+    AntiSwayChainInput input = {.vel_ref = vel_ref,
+                                .angle = angle_input,
+                                .vel = vel_input};
+    AntiSwayChainTaps taps;
+    Voltage final_output = AntiSwayChainStep(scheme, &input, &taps);
+    Real vel_err = taps.vel_err;
+
+    data_axis->vel_err = vel_err;
+    data_axis->voltage = final_output;
+    data_axis->int_out = scheme->inner_int.prev_output;
 
 #ifdef TUNING
     static int i = 0;
+    Real outer_output = taps.outer_output;
 
     // Back Propagation
 
@@ -510,11 +627,12 @@ static inline int AntiSwayControlLaw(Velocity vel_ref,
     if (++i == 2) i = 0;
 #endif
 
-	*data_buff++ = scheme->inner_prop;
-	*data_buff++ = scheme->inner_int.gain * 2 / BTI_S;
-	*data_buff++ = vel_err * vel_err;
+	data_axis->Kp = scheme->inner_prop;
+	data_axis->Ki = scheme->inner_int.gain * 2 / BTI_S;
+	data_axis->loss = vel_err * vel_err;
+	data_axis++;
 
-    return EXIT_SUCCESS;
+    return final_output;
 }
 
 static inline void SetupScheme(AntiSwayControlScheme *scheme,
@@ -22,6 +22,9 @@
  * Executes Anti-Sway Mode (concurrently)
  * 
  * @pre Anti-Sway Mode is not already running
+ * 
+ * @return 0 upon success, EFILE (also set in u_error) if its data file
+ * cannot be opened, in which case the mode does not start
 */
 int AntiSwayFork();
 
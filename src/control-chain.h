@@ -0,0 +1,200 @@
+/**
+ * @file control-chain.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Fused Control Chain Generator
+ * @version 0.1
+ * @date 2024-06-03
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * A control chain is a sequence of operations on one signal, declared
+ * once as an X-macro whose parameter is applied to every operation:
+ *
+ *     #define EXAMPLE_CHAIN(OP) \
+ *         OP(INPUT, reference) \
+ *         OP(SUB, measured) \
+ *         OP(TAP, error) \
+ *         OP(PI, k_p, integrator) \
+ *         OP(SATURATE, MOTOR_V_LIM_L, MOTOR_V_LIM_H)
+ *
+ *     DEFINE_CONTROL_CHAIN(Example, EXAMPLE_CHAIN)
+ *
+ * which defines ExampleInput (the measured signals), ExampleState (the
+ * gains and dynamic blocks), ExampleTaps (the intermediate signals
+ * to record), and a straight-line step function,
+ *
+ *     static inline Real ExampleStep(ExampleState *state,
+ *                                    ExampleInput *input,
+ *                                    ExampleTaps *taps);
+ *
+ * with no branches or calls, and with every constant folded in.
+ *
+ * The operations are:
+ * - INPUT(name): the signal becomes the input name
+ * - ADD(name), SUB(name): adds/subtracts the input name
+ * - ADD_SCALED(name, gain), SUB_SCALED(name, gain): adds/subtracts
+ *   the input name times the state's Proportional gain
+ * - GAIN(gain): multiplies by the state's Proportional gain
+ * - SCALE(constant): multiplies by a compile-time constant
+ * - PI(prop, integ): runs the signal through a PI controller
+ *   with the state's Proportional prop and Integrator integ
+ *   (identical to PID(signal, &prop, &integ, NULL, ...))
+ * - SATURATE(lo, hi): saturates the signal to compile-time limits
+ * - TAP(name): stores the signal into the taps' name
+ *
+ * Each input, gain and tap name may only appear once per chain.
+ */
+
+#ifndef CONTROL_CHAIN_H_
+#define CONTROL_CHAIN_H_
+
+#include "discrete-lib.h"
+
+
+/* Chain Definition */
+
+
+/**
+ * @brief Defines a control chain
+ *
+ * @param name The prefix of the generated types and step function
+ * @param CHAIN The X-macro listing the chain's operations
+ *
+ * @post name##Input, name##State, name##Taps and name##Step() are defined
+*/
+#define DEFINE_CONTROL_CHAIN(name, CHAIN) \
+    typedef struct { \
+        CHAIN(CHAIN_INPUT_FIELD) \
+    } name##Input; \
+    typedef struct { \
+        CHAIN(CHAIN_STATE_FIELD) \
+    } name##State; \
+    typedef struct { \
+        CHAIN(CHAIN_TAP_FIELD) \
+        char unused;  /* Keeps the struct non-empty */ \
+    } name##Taps; \
+    static inline Real name##Step(name##State *state, \
+                                  name##Input *input, \
+                                  name##Taps *taps) { \
+        Real signal = 0.0; \
+        CHAIN(CHAIN_STEP) \
+        (void) state; \
+        (void) taps; \
+        return signal; \
+    }
+
+
+/* Operation Dispatch */
+
+
+/// Expands an operation into its input field (if any)
+#define CHAIN_INPUT_FIELD(op, ...) CHAIN_INPUT_FIELD_##op(__VA_ARGS__)
+/// Expands an operation into its state field(s) (if any)
+#define CHAIN_STATE_FIELD(op, ...) CHAIN_STATE_FIELD_##op(__VA_ARGS__)
+/// Expands an operation into its tap field (if any)
+#define CHAIN_TAP_FIELD(op, ...) CHAIN_TAP_FIELD_##op(__VA_ARGS__)
+/// Expands an operation into its step code
+#define CHAIN_STEP(op, ...) CHAIN_STEP_##op(__VA_ARGS__)
+
+
+/* Operation: INPUT(name) */
+
+
+#define CHAIN_INPUT_FIELD_INPUT(name) Real name;
+#define CHAIN_STATE_FIELD_INPUT(name)
+#define CHAIN_TAP_FIELD_INPUT(name)
+#define CHAIN_STEP_INPUT(name) signal = input->name;
+
+
+/* Operation: ADD(name) */
+
+
+#define CHAIN_INPUT_FIELD_ADD(name) Real name;
+#define CHAIN_STATE_FIELD_ADD(name)
+#define CHAIN_TAP_FIELD_ADD(name)
+#define CHAIN_STEP_ADD(name) signal = signal + input->name;
+
+
+/* Operation: SUB(name) */
+
+
+#define CHAIN_INPUT_FIELD_SUB(name) Real name;
+#define CHAIN_STATE_FIELD_SUB(name)
+#define CHAIN_TAP_FIELD_SUB(name)
+#define CHAIN_STEP_SUB(name) signal = signal - input->name;
+
+
+/* Operation: ADD_SCALED(name, gain) */
+
+
+#define CHAIN_INPUT_FIELD_ADD_SCALED(name, gain) Real name;
+#define CHAIN_STATE_FIELD_ADD_SCALED(name, gain) Proportional gain;
+#define CHAIN_TAP_FIELD_ADD_SCALED(name, gain)
+#define CHAIN_STEP_ADD_SCALED(name, gain) \
+    signal = signal + state->gain * input->name;
+
+
+/* Operation: SUB_SCALED(name, gain) */
+
+
+#define CHAIN_INPUT_FIELD_SUB_SCALED(name, gain) Real name;
+#define CHAIN_STATE_FIELD_SUB_SCALED(name, gain) Proportional gain;
+#define CHAIN_TAP_FIELD_SUB_SCALED(name, gain)
+#define CHAIN_STEP_SUB_SCALED(name, gain) \
+    signal = signal - state->gain * input->name;
+
+
+/* Operation: GAIN(gain) */
+
+
+#define CHAIN_INPUT_FIELD_GAIN(gain)
+#define CHAIN_STATE_FIELD_GAIN(gain) Proportional gain;
+#define CHAIN_TAP_FIELD_GAIN(gain)
+#define CHAIN_STEP_GAIN(gain) signal = state->gain * signal;
+
+
+/* Operation: SCALE(constant) */
+
+
+#define CHAIN_INPUT_FIELD_SCALE(constant)
+#define CHAIN_STATE_FIELD_SCALE(constant)
+#define CHAIN_TAP_FIELD_SCALE(constant)
+#define CHAIN_STEP_SCALE(constant) signal = (Real) (constant) * signal;
+
+
+/* Operation: PI(prop, integ) */
+
+
+#define CHAIN_INPUT_FIELD_PI(prop, integ)
+#define CHAIN_STATE_FIELD_PI(prop, integ) Proportional prop; Integrator integ;
+#define CHAIN_TAP_FIELD_PI(prop, integ)
+// Same order of operations as PID() with Integrate()
+#define CHAIN_STEP_PI(prop, integ) \
+    state->integ.prev_output = state->integ.prev_output + \
+        state->integ.gain * (signal + state->integ.prev_input); \
+    state->integ.prev_input = signal; \
+    signal = state->prop * signal + state->integ.prev_output;
+
+
+/* Operation: SATURATE(lo, hi) */
+
+
+#define CHAIN_INPUT_FIELD_SATURATE(lo, hi)
+#define CHAIN_STATE_FIELD_SATURATE(lo, hi)
+#define CHAIN_TAP_FIELD_SATURATE(lo, hi)
+// Written as selects, which compile to branch-free min/max
+#define CHAIN_STEP_SATURATE(lo, hi) \
+    signal = signal < (Real) (lo) ? (Real) (lo) : signal; \
+    signal = signal > (Real) (hi) ? (Real) (hi) : signal;
+
+
+/* Operation: TAP(name) */
+
+
+#define CHAIN_INPUT_FIELD_TAP(name)
+#define CHAIN_STATE_FIELD_TAP(name)
+#define CHAIN_TAP_FIELD_TAP(name) Real name;
+#define CHAIN_STEP_TAP(name) taps->name = signal;
+
+#endif  // CONTROL_CHAIN_H_
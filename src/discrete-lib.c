@@ -11,6 +11,20 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(SINGLE_PRECISION) && defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(SINGLE_PRECISION) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include "discrete-lib.h"
 
@@ -29,6 +43,97 @@
 #define SATURATE(val, lo, hi) val < lo ? lo : (val > hi ? hi : val)
 
 
+/* Biquad Bank Vector Operations */
+
+// Each BANK_* operation acts on BANK_LANES channels at once.
+// (The Cortex-A9's NEON unit has no double-precision lanes, so the
+// myRIO only vectorizes in single precision, and otherwise uses VFP)
+#if defined(SINGLE_PRECISION) && defined(__SSE__)
+/// The number of channels per vector
+#define BANK_LANES 4
+/// A vector of channels
+typedef __m128 BankVector;
+#define BANK_LOAD(ptr) _mm_load_ps(ptr)
+#define BANK_STORE(ptr, v) _mm_store_ps(ptr, v)
+#define BANK_SET(val) _mm_set1_ps(val)
+#define BANK_ADD(a, b) _mm_add_ps(a, b)
+#define BANK_SUB(a, b) _mm_sub_ps(a, b)
+#define BANK_MUL(a, b) _mm_mul_ps(a, b)
+#define BANK_MIN(a, b) _mm_min_ps(a, b)
+#define BANK_MAX(a, b) _mm_max_ps(a, b)
+#elif defined(SINGLE_PRECISION) && defined(__ARM_NEON)
+/// The number of channels per vector
+#define BANK_LANES 4
+/// A vector of channels
+typedef float32x4_t BankVector;
+#define BANK_LOAD(ptr) vld1q_f32(ptr)
+#define BANK_STORE(ptr, v) vst1q_f32(ptr, v)
+#define BANK_SET(val) vdupq_n_f32(val)
+#define BANK_ADD(a, b) vaddq_f32(a, b)
+#define BANK_SUB(a, b) vsubq_f32(a, b)
+#define BANK_MUL(a, b) vmulq_f32(a, b)
+#define BANK_MIN(a, b) vminq_f32(a, b)
+#define BANK_MAX(a, b) vmaxq_f32(a, b)
+#elif defined(__AVX__)
+/// The number of channels per vector
+#define BANK_LANES 4
+/// A vector of channels
+typedef __m256d BankVector;
+#define BANK_LOAD(ptr) _mm256_load_pd(ptr)
+#define BANK_STORE(ptr, v) _mm256_store_pd(ptr, v)
+#define BANK_SET(val) _mm256_set1_pd(val)
+#define BANK_ADD(a, b) _mm256_add_pd(a, b)
+#define BANK_SUB(a, b) _mm256_sub_pd(a, b)
+#define BANK_MUL(a, b) _mm256_mul_pd(a, b)
+#define BANK_MIN(a, b) _mm256_min_pd(a, b)
+#define BANK_MAX(a, b) _mm256_max_pd(a, b)
+#elif defined(__SSE2__)
+/// The number of channels per vector
+#define BANK_LANES 2
+/// A vector of channels
+typedef __m128d BankVector;
+#define BANK_LOAD(ptr) _mm_load_pd(ptr)
+#define BANK_STORE(ptr, v) _mm_store_pd(ptr, v)
+#define BANK_SET(val) _mm_set1_pd(val)
+#define BANK_ADD(a, b) _mm_add_pd(a, b)
+#define BANK_SUB(a, b) _mm_sub_pd(a, b)
+#define BANK_MUL(a, b) _mm_mul_pd(a, b)
+#define BANK_MIN(a, b) _mm_min_pd(a, b)
+#define BANK_MAX(a, b) _mm_max_pd(a, b)
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// The number of channels per vector
+#define BANK_LANES 2
+/// A vector of channels
+typedef float64x2_t BankVector;
+#define BANK_LOAD(ptr) vld1q_f64(ptr)
+#define BANK_STORE(ptr, v) vst1q_f64(ptr, v)
+#define BANK_SET(val) vdupq_n_f64(val)
+#define BANK_ADD(a, b) vaddq_f64(a, b)
+#define BANK_SUB(a, b) vsubq_f64(a, b)
+#define BANK_MUL(a, b) vmulq_f64(a, b)
+#define BANK_MIN(a, b) vminq_f64(a, b)
+#define BANK_MAX(a, b) vmaxq_f64(a, b)
+#else
+/// The number of channels per vector
+#define BANK_LANES 1
+/// A vector of channels
+typedef Real BankVector;
+#define BANK_LOAD(ptr) (*(ptr))
+#define BANK_STORE(ptr, v) (*(ptr) = (v))
+#define BANK_SET(val) (val)
+#define BANK_ADD(a, b) ((a) + (b))
+#define BANK_SUB(a, b) ((a) - (b))
+#define BANK_MUL(a, b) ((a) * (b))
+#define BANK_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define BANK_MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/// The number of frames BiquadBankBlock() copies in and out at once
+#define BANK_BLOCK_FRAMES 64
+/// The most stages BiquadBankBlock() holds in registers at once
+#define BANK_TILE 4
+
+
 /* Cascade Helper Function */
 
 /**
@@ -44,12 +149,30 @@
  * the system 
  * @post The system is updated with current/past calculated values
 */
-static inline double EvaluateBiquad(Biquad *sys, double input);
+static inline Real EvaluateBiquad(Biquad *sys, Real input);
 
 
 /* Initialization Functions */
 
 
+int BiquadInit(double numerator[3], double denominator[3], Biquad *result) {
+    if (denominator[0] == 0.0) {
+        return EXIT_FAILURE;
+    }
+
+    // Normalize once here, instead of dividing every sample
+    result->numerator[0] = numerator[0] / denominator[0];
+    result->numerator[1] = numerator[1] / denominator[0];
+    result->numerator[2] = numerator[2] / denominator[0];
+    result->denominator[0] = 1.0;
+    result->denominator[1] = denominator[1] / denominator[0];
+    result->denominator[2] = denominator[2] / denominator[0];
+    result->state[0] = 0.0;
+    result->state[1] = 0.0;
+
+    return EXIT_SUCCESS;
+}
+
 void IntegratorInit(Proportional gain, double timestep, Integrator *result) {
     result->gain = gain * timestep / 2.0;
     result->prev_input = 0.0;
@@ -65,17 +188,80 @@ void DifferentiatorInit(Proportional gain,
 }
 
 
+int BiquadBankInit(Biquad *channels[],
+                   int num_channels,
+                   int num_stages,
+                   BiquadBank *result) {
+    if (num_channels < 1 || num_channels > BANK_MAX_CHANNELS ||
+        num_stages < 1 || num_stages > BANK_MAX_STAGES) {
+        return EXIT_FAILURE;
+    }
+
+    // Unused channels and stages stay zeroed, so they output 0.0
+    memset(result, 0, sizeof(BiquadBank));
+    result->num_channels = num_channels;
+    result->num_stages = num_stages;
+
+    int i, c;
+    for (i = 0; i < num_stages; i++) {
+        BiquadBankStage *stage = result->stage + i;
+        for (c = 0; c < num_channels; c++) {
+            Biquad *sys = channels[c] + i;
+            stage->b0[c] = sys->numerator[0];
+            stage->b1[c] = sys->numerator[1];
+            stage->b2[c] = sys->numerator[2];
+            stage->a1[c] = sys->denominator[1];
+            stage->a2[c] = sys->denominator[2];
+            stage->s1[c] = sys->state[0];
+            stage->s2[c] = sys->state[1];
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
 /* Time-Stepping Functions */
 
 
-inline double Cascade(double input,
-                      Biquad sys[],
-                      int size,
-                      double lower_lim,
-                      double upper_lim) {
+void BiquadBankStep(BiquadBank *bank,
+                    Real input[],
+                    Real output[],
+                    Real lower_lim,
+                    Real upper_lim) {
+    int i, c;
+
+    // One frame is too little work to fill a vector (with padding, and
+    // the copies in and out of it, the vector step was slower than
+    // Cascade() per channel), so each channel goes through every stage
+    // in scalar registers, and only BiquadBankBlock() is vectorized
+    for (c = 0; c < bank->num_channels; c++) {
+        Real x = input[c];
+
+        for (i = 0; i < bank->num_stages; i++) {
+            BiquadBankStage *stage = bank->stage + i;
+
+            // Same order of operations as EvaluateBiquad()
+            Real y = stage->b0[c] * x + stage->s1[c];
+            stage->s1[c] = stage->b1[c] * x - stage->a1[c] * y +
+                           stage->s2[c];
+            stage->s2[c] = stage->b2[c] * x - stage->a2[c] * y;
+            x = y;
+        }
+
+        // As in Cascade(), only the output is saturated, not the state
+        output[c] = SATURATE(x, lower_lim, upper_lim);
+    }
+}
+
+inline Real Cascade(Real input,
+                    Biquad sys[],
+                    int size,
+                    Real lower_lim,
+                    Real upper_lim) {
     Biquad *ptr;
 
-    double output;
+    Real output;
     for (ptr = sys; ptr < sys + size; ptr++) {
         output = EvaluateBiquad(ptr, input);
         input = output;
@@ -86,38 +272,38 @@ inline double Cascade(double input,
     return SATURATE(output, lower_lim, upper_lim);
 }
 
-inline double Integrate(double input,
-                        Integrator *term,
-                        double lower_lim,
-                        double upper_lim) {
+inline Real Integrate(Real input,
+                      Integrator *term,
+                      Real lower_lim,
+                      Real upper_lim) {
     // s^-1 = prop * (1+z^-1)/(1-z^-1) = out/in
     // out = out_prev + prop * (in + in_prev)
-    double result = term->prev_output + term->gain * (input + term->prev_input);
+    Real result = term->prev_output + term->gain * (input + term->prev_input);
     term->prev_input = input;
     term->prev_output = result;
     return SATURATE(result, lower_lim, upper_lim);
 }
 
-inline double Differentiate(double input,
-                            Differentiator *term,
-                            double lower_lim,
-                            double upper_lim) {
+inline Real Differentiate(Real input,
+                          Differentiator *term,
+                          Real lower_lim,
+                          Real upper_lim) {
     // s = prop * (1-z^-1)/(1+z^-1) = out/in
     // out = -out_prev + prop * (in - in_prev)
-    double result = -term->prev_output +
+    Real result = -term->prev_output +
         term->gain * (input - term->prev_input);
     term->prev_input = input;
     term->prev_output = result;
     return SATURATE(result, lower_lim, upper_lim);
 }
 
-inline double PID(double input,
-                  Proportional *p,
-                  Integrator *i,
-                  Differentiator *d,
-                  double lower_lim,
-                  double upper_lim) {
-    double result = 0.0;
+inline Real PID(Real input,
+                Proportional *p,
+                Integrator *i,
+                Differentiator *d,
+                Real lower_lim,
+                Real upper_lim) {
+    Real result = 0.0;
     if (p != NULL) result += *p * input;
     if (i != NULL) result += Integrate(input, i, NEG_INF, POS_INF);
     if (d != NULL) result += Differentiate(input, d, NEG_INF, POS_INF);
@@ -125,25 +311,436 @@ inline double PID(double input,
     return SATURATE(result, lower_lim, upper_lim);
 }
 
-static inline double EvaluateBiquad(Biquad *sys, double input) {
-    // Here's the most efficient way to handle this:
-    double *ptr = (double *) sys;
+static inline Real EvaluateBiquad(Biquad *sys, Real input) {
+    // Transposed direct form II: the delay registers hold the partial
+    // sums of the future outputs, and denominator[0] is 1.0
+    Real output = sys->numerator[0] * input + sys->state[0];
 
-    // If you're curious, I encourage you to figure out what's going on
-    // here before looking at the Lab Report
-    double output = *ptr * input +
-                    ptr[1] * ptr[6] +
-                    ptr[2] * ptr[7] -
-                    ptr[4] * ptr[8] -
-                    ptr[5] * ptr[9];
+    sys->state[0] = sys->numerator[1] * input -
+                    sys->denominator[1] * output +
+                    sys->state[1];
+    sys->state[1] = sys->numerator[2] * input -
+                    sys->denominator[2] * output;
 
-    output /= ptr[3];
+    return output;
+}
 
-    ptr[7] = ptr[6];
-    ptr[6] = input;
 
-    ptr[9] = ptr[8];
-    ptr[8] = output;
+/* Block-Processing Functions */
 
-    return output;
+
+/// The most biquads CascadeBlock() holds in registers at once
+#define CASCADE_TILE 4
+
+/**
+ * Runs a block through a tile of consecutive biquads, a sample at a
+ * time through every biquad of the tile, with their coefficients and
+ * state held in registers (so that the biquads' recurrences overlap)
+ * 
+ * @param input The inputs to the tile
+ * @param output A return parameter, which becomes the tile's outputs
+ * (may be the same array as input)
+ * @param length The number of samples in input and output
+ * @param sys The tile's first biquad
+ * @param count The number of biquads in the tile (a constant, at most
+ * CASCADE_TILE, so that the loop over them unrolls)
+*/
+static inline __attribute__((always_inline))
+void CascadeTile(Real input[],
+                 Real output[],
+                 int length,
+                 Biquad sys[],
+                 int count) {
+    Real b0[CASCADE_TILE], b1[CASCADE_TILE], b2[CASCADE_TILE];
+    Real a1[CASCADE_TILE], a2[CASCADE_TILE];
+    Real s1[CASCADE_TILE], s2[CASCADE_TILE];
+    int n, k;
+
+    STATE_SPACE_UNROLL
+    for (k = 0; k < count; k++) {
+        b0[k] = sys[k].numerator[0];
+        b1[k] = sys[k].numerator[1];
+        b2[k] = sys[k].numerator[2];
+        a1[k] = sys[k].denominator[1];
+        a2[k] = sys[k].denominator[2];
+        s1[k] = sys[k].state[0];
+        s2[k] = sys[k].state[1];
+    }
+
+    for (n = 0; n < length; n++) {
+        Real x = input[n];
+        STATE_SPACE_UNROLL
+        for (k = 0; k < count; k++) {
+            // Same order of operations as EvaluateBiquad()
+            Real y = b0[k] * x + s1[k];
+            s1[k] = b1[k] * x - a1[k] * y + s2[k];
+            s2[k] = b2[k] * x - a2[k] * y;
+            x = y;
+        }
+        output[n] = x;
+    }
+
+    STATE_SPACE_UNROLL
+    for (k = 0; k < count; k++) {
+        sys[k].state[0] = s1[k];
+        sys[k].state[1] = s2[k];
+    }
+}
+
+void CascadeBlock(Real input[],
+                  Real output[],
+                  int length,
+                  Biquad sys[],
+                  int size,
+                  Real lower_lim,
+                  Real upper_lim) {
+    Biquad *ptr;
+    Real *signal = input;
+    int n;
+
+    // Each sample goes through a tile of biquads at once (rather than
+    // the whole block through one biquad, which waits on that biquad's
+    // recurrence every sample), with the tile held in registers
+    for (ptr = sys; ptr < sys + size; ptr += CASCADE_TILE) {
+        switch (sys + size - ptr) {
+            case 1: CascadeTile(signal, output, length, ptr, 1); break;
+            case 2: CascadeTile(signal, output, length, ptr, 2); break;
+            case 3: CascadeTile(signal, output, length, ptr, 3); break;
+            default:
+                CascadeTile(signal, output, length, ptr, CASCADE_TILE);
+                break;
+        }
+        signal = output;
+    }
+
+    for (n = 0; n < length; n++) {
+        output[n] = SATURATE(output[n], lower_lim, upper_lim);
+    }
+}
+
+void IntegrateBlock(Real input[],
+                    Real output[],
+                    int length,
+                    Integrator *term,
+                    Real lower_lim,
+                    Real upper_lim) {
+    Real gain = term->gain;
+    Real prev_input = term->prev_input;
+    Real prev_output = term->prev_output;
+    int n;
+
+    for (n = 0; n < length; n++) {
+        Real x = input[n];
+        prev_output = prev_output + gain * (x + prev_input);
+        prev_input = x;
+        output[n] = SATURATE(prev_output, lower_lim, upper_lim);
+    }
+
+    term->prev_input = prev_input;
+    term->prev_output = prev_output;
+}
+
+void DifferentiateBlock(Real input[],
+                        Real output[],
+                        int length,
+                        Differentiator *term,
+                        Real lower_lim,
+                        Real upper_lim) {
+    Real gain = term->gain;
+    Real prev_input = term->prev_input;
+    Real prev_output = term->prev_output;
+    int n;
+
+    for (n = 0; n < length; n++) {
+        Real x = input[n];
+        prev_output = -prev_output + gain * (x - prev_input);
+        prev_input = x;
+        output[n] = SATURATE(prev_output, lower_lim, upper_lim);
+    }
+
+    term->prev_input = prev_input;
+    term->prev_output = prev_output;
+}
+
+void PIDBlock(Real input[],
+              Real output[],
+              int length,
+              Proportional *p,
+              Integrator *i,
+              Differentiator *d,
+              Real lower_lim,
+              Real upper_lim) {
+    // Zeroed terms stand in for NULL ones, which keeps the loop
+    // branch-free, but the sums are only taken over non-NULL terms
+    // so that the result is exactly that of PID()
+    Integrator i_ = {0.0, 0.0, 0.0};
+    Differentiator d_ = {0.0, 0.0, 0.0};
+    Integrator *i_term = i != NULL ? i : &i_;
+    Differentiator *d_term = d != NULL ? d : &d_;
+
+    Real k_p = p != NULL ? *p : (Real) 0.0;
+    Real k_i = i_term->gain;
+    Real i_prev_input = i_term->prev_input;
+    Real i_prev_output = i_term->prev_output;
+    Real k_d = d_term->gain;
+    Real d_prev_input = d_term->prev_input;
+    Real d_prev_output = d_term->prev_output;
+    int n;
+
+    for (n = 0; n < length; n++) {
+        Real x = input[n];
+        Real result = 0.0;
+
+        i_prev_output = i_prev_output + k_i * (x + i_prev_input);
+        i_prev_input = x;
+        d_prev_output = -d_prev_output + k_d * (x - d_prev_input);
+        d_prev_input = x;
+
+        if (p != NULL) result += k_p * x;
+        if (i != NULL) result += i_prev_output;
+        if (d != NULL) result += d_prev_output;
+        output[n] = SATURATE(result, lower_lim, upper_lim);
+    }
+
+    i_term->prev_input = i_prev_input;
+    i_term->prev_output = i_prev_output;
+    d_term->prev_input = d_prev_input;
+    d_term->prev_output = d_prev_output;
+}
+
+/**
+ * Runs frames through a tile of consecutive stages of a BiquadBank, for
+ * one vector of its channels, a frame at a time through every stage of
+ * the tile, with their coefficients and state held in registers (so that
+ * the stages' recurrences overlap)
+ * 
+ * @param stage The tile's first stage
+ * @param count The number of stages in the tile (a constant, at most
+ * BANK_TILE, so that the loop over them unrolls)
+ * @param signal The frames, which become the tile's outputs
+ * @param frames The number of frames
+ * @param c The vector's first channel
+*/
+static inline __attribute__((always_inline))
+void BankTile(BiquadBankStage *stage,
+              int count,
+              Real signal[][BANK_MAX_CHANNELS],
+              int frames,
+              int c) {
+    BankVector b0[BANK_TILE], b1[BANK_TILE], b2[BANK_TILE];
+    BankVector a1[BANK_TILE], a2[BANK_TILE];
+    BankVector s1[BANK_TILE], s2[BANK_TILE];
+    int n, k;
+
+    STATE_SPACE_UNROLL
+    for (k = 0; k < count; k++) {
+        b0[k] = BANK_LOAD(stage[k].b0 + c);
+        b1[k] = BANK_LOAD(stage[k].b1 + c);
+        b2[k] = BANK_LOAD(stage[k].b2 + c);
+        a1[k] = BANK_LOAD(stage[k].a1 + c);
+        a2[k] = BANK_LOAD(stage[k].a2 + c);
+        s1[k] = BANK_LOAD(stage[k].s1 + c);
+        s2[k] = BANK_LOAD(stage[k].s2 + c);
+    }
+
+    for (n = 0; n < frames; n++) {
+        BankVector x = BANK_LOAD(signal[n] + c);
+        STATE_SPACE_UNROLL
+        for (k = 0; k < count; k++) {
+            // Same order of operations as EvaluateBiquad()
+            BankVector y = BANK_ADD(BANK_MUL(b0[k], x), s1[k]);
+            s1[k] = BANK_ADD(BANK_SUB(BANK_MUL(b1[k], x),
+                                      BANK_MUL(a1[k], y)), s2[k]);
+            s2[k] = BANK_SUB(BANK_MUL(b2[k], x), BANK_MUL(a2[k], y));
+            x = y;
+        }
+        BANK_STORE(signal[n] + c, x);
+    }
+
+    STATE_SPACE_UNROLL
+    for (k = 0; k < count; k++) {
+        BANK_STORE(stage[k].s1 + c, s1[k]);
+        BANK_STORE(stage[k].s2 + c, s2[k]);
+    }
+}
+
+void BiquadBankBlock(BiquadBank *bank,
+                     Real input[],
+                     Real output[],
+                     int length,
+                     Real lower_lim,
+                     Real upper_lim) {
+    // Frames, padded to a whole number of vectors
+    Real signal[BANK_BLOCK_FRAMES][BANK_MAX_CHANNELS]
+        __attribute__((aligned(32)));
+    int channels = bank->num_channels;
+    int lanes = (channels + BANK_LANES - 1) / BANK_LANES * BANK_LANES;
+    int start, frames, i, c, n;
+
+    memset(signal, 0, sizeof(signal));
+
+    for (start = 0; start < length; start += frames) {
+        frames = length - start < BANK_BLOCK_FRAMES ?
+            length - start : BANK_BLOCK_FRAMES;
+
+        for (n = 0; n < frames; n++) {
+            for (c = 0; c < channels; c++) {
+                signal[n][c] = input[(start + n) * channels + c];
+            }
+        }
+
+        // Each frame goes through a tile of stages at once (rather than
+        // every frame through one stage, which waits on that stage's
+        // recurrence), with the tile held in registers
+        for (c = 0; c < lanes; c += BANK_LANES) {
+            for (i = 0; i < bank->num_stages; i += BANK_TILE) {
+                BiquadBankStage *stage = bank->stage + i;
+                switch (bank->num_stages - i) {
+                    case 1: BankTile(stage, 1, signal, frames, c); break;
+                    case 2: BankTile(stage, 2, signal, frames, c); break;
+                    case 3: BankTile(stage, 3, signal, frames, c); break;
+                    default:
+                        BankTile(stage, BANK_TILE, signal, frames, c);
+                        break;
+                }
+            }
+        }
+
+        for (n = 0; n < frames; n++) {
+            for (c = 0; c < channels; c++) {
+                output[(start + n) * channels + c] =
+                    SATURATE(signal[n][c], lower_lim, upper_lim);
+            }
+        }
+    }
+}
+
+
+/* Velocity Estimation Functions */
+
+
+/// The size of a VelocityEstimator's ring
+#define VEL_RING (VEL_WINDOW_MAX + 1)
+
+void VelocityEstimatorInit(double bandwidth,
+                           int32_t pll_counts,
+                           VelocityEstimator *result) {
+    result->pll_counts = pll_counts;
+    result->pll_kp = 2.0 * bandwidth;
+    result->pll_ki = bandwidth * bandwidth;
+    VelocityEstimatorReset(result);
+}
+
+void VelocityEstimatorReset(VelocityEstimator *est) {
+    est->newest = 0;
+    est->length = 0;
+    est->window = 0;
+    est->pll_pos = 0.0;
+    est->pll_vel = 0.0;
+}
+
+Real EstimateVelocity(VelocityEstimator *est, int32_t count, double time) {
+    double slope = 0.0;
+    double err, line, trial;
+    int n, j, oldest = 0, window = 0;
+
+    // The tracking loop (predict, then correct by the count's error)
+    if (est->length == 0) {
+        est->pll_pos = count;
+        est->pll_vel = 0.0;
+    } else {
+        double dt = time - est->time[est->newest];
+        est->pll_pos += est->pll_vel * dt;
+        err = count - est->pll_pos;
+        est->pll_pos += est->pll_kp * dt * err;
+        est->pll_vel += est->pll_ki * dt * err;
+    }
+
+    est->newest = (est->newest + 1) % VEL_RING;
+    est->counts[est->newest] = count;
+    est->time[est->newest] = time;
+    if (est->length < VEL_RING) est->length++;
+
+    // The longest window that the line through its ends fits
+    for (n = 1; n < est->length; n++) {
+        int first = (est->newest + VEL_RING - n) % VEL_RING;
+        if (time <= est->time[first]) break;
+        trial = (count - est->counts[first]) / (time - est->time[first]);
+        for (j = 1; j < n; j++) {
+            int k = (est->newest + VEL_RING - j) % VEL_RING;
+            line = count - trial * (time - est->time[k]);
+            if (fabs(est->counts[k] - line) > VEL_BAND) break;
+        }
+        if (j < n) break;
+        slope = trial;
+        window = n;
+        oldest = first;
+    }
+
+    // Too few counts, even over the longest window
+    if (window == 0 ||
+        (window == VEL_WINDOW_MAX &&
+         abs(count - est->counts[oldest]) < est->pll_counts)) {
+        est->window = 0;
+        return est->pll_vel;
+    }
+    est->window = window;
+    return slope;
+}
+
+
+/* Decimation Functions */
+
+
+int DecimatorInit(const Real taps[],
+                  int length,
+                  int channels,
+                  Decimator *result) {
+    if (length < 1 || length > DECIMATOR_MAX_TAPS ||
+        channels < 1 || channels > DECIMATOR_MAX_CHANNELS) {
+        return EXIT_FAILURE;
+    }
+
+    memset(result, 0, sizeof(*result));
+    memcpy(result->taps, taps, length * sizeof(Real));
+    result->length = length;
+    result->channels = channels;
+    return EXIT_SUCCESS;
+}
+
+void DecimatorPush(Decimator *dec, const Real sample[]) {
+    uint32_t head = dec->head;
+    int c;
+
+    for (c = 0; c < dec->channels; c++) {
+        dec->samples[head % DECIMATOR_RING][c] = sample[c];
+    }
+    __atomic_store_n(&(dec->head), head + 1, __ATOMIC_RELEASE);
+}
+
+int DecimatorOutput(const Decimator *dec, Real result[]) {
+    Real sum[DECIMATOR_MAX_CHANNELS];
+    uint32_t head;
+    int n, c;
+
+    do {
+        head = __atomic_load_n(&(dec->head), __ATOMIC_ACQUIRE);
+        if (head < (uint32_t) dec->length) return EXIT_FAILURE;
+
+        // The newest sample through the first tap
+        for (c = 0; c < dec->channels; c++) sum[c] = 0.0;
+        for (n = 0; n < dec->length; n++) {
+            const Real *sample =
+                dec->samples[(head - 1 - n) % DECIMATOR_RING];
+            for (c = 0; c < dec->channels; c++) {
+                sum[c] += dec->taps[n] * sample[c];
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // Retried if the oldest sample read may have been overwritten
+    } while (__atomic_load_n(&(dec->head), __ATOMIC_RELAXED) - head >=
+             (uint32_t) (DECIMATOR_RING - dec->length));
+
+    for (c = 0; c < dec->channels; c++) result[c] = sum[c];
+    return EXIT_SUCCESS;
 }
@@ -13,16 +13,61 @@
 #ifndef DISCRETE_LIB_H_
 #define DISCRETE_LIB_H_
 
+#include <stdint.h>
 #include <float.h>
 
 
+/* Precision Policy */
+
+
+// Build with -DSINGLE_PRECISION (make PRECISION=single) to run the
+// control path in float32, which the myRIO's NEON unit can vectorize
+#ifdef SINGLE_PRECISION
+/// The floating point type of the control path
+typedef float Real;
+/// The largest finite Real
+#define REAL_MAX FLT_MAX
+#else
+/// The floating point type of the control path
+typedef double Real;
+/// The largest finite Real
+#define REAL_MAX DBL_MAX
+#endif
+
+
 /* Non-saturation constants */
 
 
 /// Positive Infinity
-#define POS_INF DBL_MAX
+#define POS_INF REAL_MAX
 /// Negative Infinity
-#define NEG_INF (-DBL_MAX)
+#define NEG_INF (-REAL_MAX)
+
+
+/* Biquad Bank Constants */
+
+
+/// The maximum number of channels (i.e. axes) in a BiquadBank
+#define BANK_MAX_CHANNELS 4
+/// The maximum number of biquads per channel in a BiquadBank
+#define BANK_MAX_STAGES 8
+/**
+ * @brief Biquad Bank Tolerance
+ * 
+ * The largest difference between the outputs of a BiquadBank channel
+ * and Cascade() over the same biquads, relative to the largest output
+ * (the signal's scale), not to each output, whose own relative error
+ * is unbounded near zero. Both evaluate the same operations in the same
+ * order, but the compiler may contract them into fused multiply-adds
+ * differently on each path (as with -mfma on x86-64, and by default on
+ * AArch64), and in single precision ARMv7 NEON flushes denormals to
+ * zero. bench/discrete.c checks it.
+*/
+#ifdef SINGLE_PRECISION
+#define BANK_TOLERANCE 1e-5
+#else
+#define BANK_TOLERANCE 1e-12
+#endif
 
 
 /* Discrete-Time Data Structures */
@@ -31,33 +76,67 @@
 /**
  * @brief Biquad
  * 
- * A struct representing a biquad
+ * A struct representing a biquad, in transposed direct form II
+ * 
+ * @note The coefficients are normalized (denominator[0] is 1.0), which
+ * BiquadInit() and the filter-design functions guarantee
 */
 typedef struct {
     //! The numerator coefficients, in decreasing order of time delays
     /*! The numerator coefficients, in decreasing order of time delays
     (z^0, z^-1, z^-2) */
-    double numerator[3];
+    Real numerator[3];
     //! The denominator coefficients, in decreasing order of time delays
     /*! The denominator coefficients, in decreasing order of time delays
-    (z^0, z^-1, z^-2) */
-    double denominator[3];
-    //! The previous inputs, in increasing time delays
-    /*! The previous inputs, in increasing time delays
+    (z^0, z^-1, z^-2), where the z^0 coefficient is 1.0 */
+    Real denominator[3];
+    //! The delay registers, in increasing time delays
+    /*! The delay registers, in increasing time delays
     (z^-1, z^-2) */
-    double prev_input[2];
-    //! The previous outputs, in increasing time delays
-    /*! The previous outputs, in increasing time delays
-    (z^-1, z^-2) */
-    double prev_output[2];
+    Real state[2];
 } Biquad;
 
+/**
+ * @brief Biquad Bank Stage
+ * 
+ * One (transposed direct form II) biquad of every channel in a
+ * BiquadBank, stored as a struct-of-arrays (indexed by channel) so
+ * that all channels can be stepped together with vector instructions
+*/
+typedef struct {
+    Real b0[BANK_MAX_CHANNELS];  //!< z^0 numerator coefficients
+    Real b1[BANK_MAX_CHANNELS];  //!< z^-1 numerator coefficients
+    Real b2[BANK_MAX_CHANNELS];  //!< z^-2 numerator coefficients
+    Real a1[BANK_MAX_CHANNELS];  //!< z^-1 denominator coefficients
+    Real a2[BANK_MAX_CHANNELS];  //!< z^-2 denominator coefficients
+    Real s1[BANK_MAX_CHANNELS];  //!< Delay registers (z^-1)
+    Real s2[BANK_MAX_CHANNELS];  //!< Delay registers (z^-2)
+} __attribute__((aligned(32))) BiquadBankStage;
+
+/**
+ * @brief Biquad Bank
+ * 
+ * A struct representing several cascades of biquads with identical
+ * topology (one cascade per channel, such as the X and Y axes), which
+ * are stepped in lockstep. BiquadBankBlock() uses AVX/SSE on the host,
+ * NEON on the myRIO (single precision) or AArch64, and a scalar loop
+ * otherwise; BiquadBankStep() is scalar (see bench/discrete.c)
+ * 
+ * @note Must be 32-byte aligned (static/stack storage is, malloc is not)
+*/
+typedef struct {
+    //! The stages, in the order the input passes through them
+    BiquadBankStage stage[BANK_MAX_STAGES];
+    int num_channels;  //!< The number of channels being stepped
+    int num_stages;    //!< The number of biquads per channel
+} BiquadBank;
+
 /**
  * @brief Control Block: Proportion
  * 
  * A proportional constant
 */
-typedef float Proportional;
+typedef Real Proportional;
 
 /**
  * @brief Control Block: Integrator
@@ -66,8 +145,8 @@ typedef float Proportional;
 */
 typedef struct {
     Proportional gain;   //!< Integral Gain (with Timestep)
-    double prev_input;   //!< Previous input
-    double prev_output;  //!< Previous output
+    Real prev_input;     //!< Previous input
+    Real prev_output;    //!< Previous output
 } Integrator;
 
 /**
@@ -77,14 +156,29 @@ typedef struct {
 */
 typedef struct {
     Proportional gain;   //!< Differential Gain (with Timestep)
-    double prev_input;   //!< Previous input
-    double prev_output;  //!< Previous output
+    Real prev_input;     //!< Previous input
+    Real prev_output;    //!< Previous output
 } Differentiator;
 
 
 /* Initialization Functions */
 
 
+/**
+ * Initializes a Biquad
+ * 
+ * @param numerator The numerator coefficients, in decreasing order of
+ * time delays (z^0, z^-1, z^-2)
+ * @param denominator The denominator coefficients, in decreasing order of
+ * time delays (z^0, z^-1, z^-2)
+ * 
+ * @param result A return parameter, which becomes the biquad, normalized
+ * so that its denominator[0] is 1.0, with zero initial conditions
+ * 
+ * @return 0 upon success, EXIT_FAILURE if denominator[0] is zero
+*/
+int BiquadInit(double numerator[3], double denominator[3], Biquad *result);
+
 /**
  * Initializes an Integrator
  * 
@@ -113,6 +207,24 @@ void DifferentiatorInit(Proportional gain,
                         double timestep,
                         Differentiator *result);
 
+/**
+ * Initializes a BiquadBank from one cascade of biquads per channel
+ * 
+ * @param channels An array of num_channels cascades, each an array
+ * of num_stages biquads
+ * @param num_channels The number of channels (at most BANK_MAX_CHANNELS)
+ * @param num_stages The number of biquads per channel (at most
+ * BANK_MAX_STAGES)
+ * @param result A return parameter, which becomes the bank, with the
+ * coefficients and the current state of every biquad
+ * 
+ * @return 0 upon success, EXIT_FAILURE if the sizes are out of range
+*/
+int BiquadBankInit(Biquad *channels[],
+                   int num_channels,
+                   int num_stages,
+                   BiquadBank *result);
+
 
 /* Time-Stepping Functions */
 
@@ -133,11 +245,35 @@ void DifferentiatorInit(Proportional gain,
  * the system
  * @post The system is updated with current/past calculated values
 */
-inline double Cascade(double input,
-                      Biquad sys[],
-                      int size,
-                      double lower_lim,
-                      double upper_lim);
+inline Real Cascade(Real input,
+                    Biquad sys[],
+                    int size,
+                    Real lower_lim,
+                    Real upper_lim);
+
+/**
+ * Executes every channel of a BiquadBank by one sample, which
+ * is the equivalent of calling Cascade() on each channel (one frame
+ * is too little work to vectorize, unlike BiquadBankBlock()'s)
+ * 
+ * @param bank The bank to step
+ * @param input The inputs to the bank, one per channel
+ * @param output A return parameter, which becomes the outputs of the
+ * bank, one per channel
+ * @param lower_lim The lower saturation limit of every channel
+ * @param upper_lim The upper saturation limit of every channel
+ * 
+ * @pre The inputs are the next sampled values of the input to
+ * each channel
+ * @post The bank is updated with current/past calculated values
+ * @post output[c] is within BANK_TOLERANCE (of the signal's scale)
+ * of Cascade() on channel c
+*/
+void BiquadBankStep(BiquadBank *bank,
+                    Real input[],
+                    Real output[],
+                    Real lower_lim,
+                    Real upper_lim);
 
 /**
  * Timesteps an Integration
@@ -153,10 +289,10 @@ inline double Cascade(double input,
  * the system
  * @post term is updated with current/past calculated values
 */
-inline double Integrate(double input,
-                        Integrator *term,
-                        double lower_lim,
-                        double upper_lim);
+inline Real Integrate(Real input,
+                      Integrator *term,
+                      Real lower_lim,
+                      Real upper_lim);
 
 /**
  * Timesteps a Differentiation
@@ -172,10 +308,10 @@ inline double Integrate(double input,
  * the system
  * @post term is updated with current/past calculated values
 */
-inline double Differentiate(double input,
-                            Differentiator *term,
-                            double lower_lim,
-                            double upper_lim);
+inline Real Differentiate(Real input,
+                          Differentiator *term,
+                          Real lower_lim,
+                          Real upper_lim);
 
 /**
  * Timesteps a PID Controller
@@ -195,11 +331,384 @@ inline double Differentiate(double input,
  * @pre if p, i and d are all NULL, then the output is 0.0
  * @post i and d are updated with current/past calculated values
 */
-inline double PID(double input,
-                  Proportional *p,
-                  Integrator *i,
-                  Differentiator *d,
-                  double lower_lim,
-                  double upper_lim);
+inline Real PID(Real input,
+                Proportional *p,
+                Integrator *i,
+                Differentiator *d,
+                Real lower_lim,
+                Real upper_lim);
+
+
+
+/* Block-Processing Functions */
+
+
+/**
+ * Executes a dynamic, discrete time system on a block of samples,
+ * which gives the same outputs as calling Cascade() on each sample
+ * 
+ * @param input The inputs to the system, in time order
+ * @param output A return parameter, which becomes the outputs of
+ * the system (may be the same array as input)
+ * @param length The number of samples in input and output
+ * @param sys The system, as an array of biquads
+ * @param size The size of sys
+ * @param lower_lim The lower saturation limit of the system
+ * @param upper_lim The upper saturation limit of the system
+ * 
+ * @post The system is updated with current/past calculated values
+ * of the last sample
+*/
+void CascadeBlock(Real input[],
+                  Real output[],
+                  int length,
+                  Biquad sys[],
+                  int size,
+                  Real lower_lim,
+                  Real upper_lim);
+
+/**
+ * Timesteps an Integration over a block of samples, which gives
+ * the same outputs as calling Integrate() on each sample
+ * 
+ * @param input The inputs to the integrator, in time order
+ * @param output A return parameter, which becomes the outputs of
+ * the integrator (may be the same array as input)
+ * @param length The number of samples in input and output
+ * @param term A pointer to an integrator term
+ * @param lower_lim The lower saturation limit of the system
+ * @param upper_lim The upper saturation limit of the system
+ * 
+ * @post term is updated with current/past calculated values
+ * of the last sample
+*/
+void IntegrateBlock(Real input[],
+                    Real output[],
+                    int length,
+                    Integrator *term,
+                    Real lower_lim,
+                    Real upper_lim);
+
+/**
+ * Timesteps a Differentiation over a block of samples, which gives
+ * the same outputs as calling Differentiate() on each sample
+ * 
+ * @param input The inputs to the differentiator, in time order
+ * @param output A return parameter, which becomes the outputs of
+ * the differentiator (may be the same array as input)
+ * @param length The number of samples in input and output
+ * @param term A pointer to an differentiator term
+ * @param lower_lim The lower saturation limit of the system
+ * @param upper_lim The upper saturation limit of the system
+ * 
+ * @post term is updated with current/past calculated values
+ * of the last sample
+*/
+void DifferentiateBlock(Real input[],
+                        Real output[],
+                        int length,
+                        Differentiator *term,
+                        Real lower_lim,
+                        Real upper_lim);
+
+/**
+ * Timesteps a PID Controller over a block of samples, which gives
+ * the same outputs as calling PID() on each sample
+ * 
+ * @param input The inputs to the PID Controller, in time order
+ * @param output A return parameter, which becomes the outputs of
+ * the PID Controller (may be the same array as input)
+ * @param length The number of samples in input and output
+ * @param p A pointer to the proportional term
+ * @param i A pointer to the integrator term
+ * @param d A pointer to the differentiator term
+ * @param lower_lim The lower saturation limit of the system
+ * @param upper_lim The upper saturation limit of the system
+ * 
+ * @pre If p, i or d is NULL, then those NULL terms don't contribute
+ * @post i and d are updated with current/past calculated values
+ * of the last sample
+*/
+void PIDBlock(Real input[],
+              Real output[],
+              int length,
+              Proportional *p,
+              Integrator *i,
+              Differentiator *d,
+              Real lower_lim,
+              Real upper_lim);
+
+/**
+ * Executes every channel of a BiquadBank over a block of samples,
+ * which gives the outputs of calling BiquadBankStep() on each sample
+ * to within BANK_TOLERANCE (of the signal's scale), as its vector
+ * operations may be contracted differently
+ * 
+ * @param bank The bank to step
+ * @param input The inputs to the bank, as length frames of
+ * bank->num_channels interleaved values (i.e. input[n * num_channels + c])
+ * @param output A return parameter, which becomes the outputs of the
+ * bank, interleaved like input (may be the same array as input)
+ * @param length The number of frames in input and output
+ * @param lower_lim The lower saturation limit of every channel
+ * @param upper_lim The upper saturation limit of every channel
+ * 
+ * @post The bank is updated with current/past calculated values
+ * of the last frame
+*/
+void BiquadBankBlock(BiquadBank *bank,
+                     Real input[],
+                     Real output[],
+                     int length,
+                     Real lower_lim,
+                     Real upper_lim);
+
+
+/* Velocity Estimation */
+
+
+/// The longest window of a VelocityEstimator (samples)
+#define VEL_WINDOW_MAX 16
+/// How far (counts) a sample may be from a VelocityEstimator's line for
+/// the line to fit it (a count, the quantization)
+#define VEL_BAND 1.0
+
+/**
+ * @brief Velocity Estimator
+ * 
+ * Estimates a velocity from timestamped, quantized positions (e.g.
+ * encoder counts read once per control cycle). Its estimate is the
+ * slope of the line through the newest sample and the oldest one of the
+ * longest recent window (of at most VEL_WINDOW_MAX samples) that the
+ * line fits to within VEL_BAND (first-order adaptive windowing): the
+ * window is short while the velocity changes, for little lag, and long
+ * while it holds, for little quantization noise. Timestamps, rather than
+ * a fixed timestep, keep jitter out of the slope.
+ * 
+ * At low speed, where even the longest window spans only a few counts,
+ * the estimate is a second-order tracking loop's (a PLL's) instead,
+ * which runs every sample so that it is ready when it is needed.
+*/
+typedef struct {
+    //! The recent positions (a ring, of which newest is the newest)
+    int32_t counts[VEL_WINDOW_MAX + 1];
+    //! The recent positions' timestamps (s)
+    double time[VEL_WINDOW_MAX + 1];
+    int newest;           //!< The newest position's index
+    int length;           //!< The number of positions held
+    int window;           //!< The last window (samples), 0 for the PLL
+    int32_t pll_counts;   //!< The counts under which the PLL is used
+    double pll_pos;       //!< The tracking loop's position (counts)
+    double pll_vel;       //!< The tracking loop's velocity (counts/s)
+    double pll_kp;        //!< The tracking loop's position gain (1/s)
+    double pll_ki;        //!< The tracking loop's velocity gain (1/s^2)
+} VelocityEstimator;
+
+/**
+ * Initializes a VelocityEstimator
+ * 
+ * @param bandwidth The tracking loop's natural frequency (rad/s), which
+ * is critically damped
+ * @param pll_counts The counts which the longest window must span for
+ * its estimate to be used instead of the tracking loop's (0 never uses
+ * the tracking loop)
+ * @param result A return parameter, which becomes the estimator, with
+ * no positions yet
+*/
+void VelocityEstimatorInit(double bandwidth,
+                           int32_t pll_counts,
+                           VelocityEstimator *result);
+
+/**
+ * Forgets a VelocityEstimator's positions (e.g. after a pause), so that
+ * its next estimate is zero
+ * 
+ * @param est The estimator
+*/
+void VelocityEstimatorReset(VelocityEstimator *est);
+
+/**
+ * Estimates the velocity from the next position
+ * 
+ * @param est The estimator
+ * @param count The position (counts)
+ * @param time The position's timestamp (s)
+ * 
+ * @return The velocity (counts/s), zero for the first position
+ * 
+ * @pre time is after the last position's timestamp
+ * @post est holds the position, and est->window the window used
+*/
+Real EstimateVelocity(VelocityEstimator *est, int32_t count, double time);
+
+
+/* Decimation */
+
+
+/// The most taps of a Decimator
+#define DECIMATOR_MAX_TAPS 64
+/// The most channels of a Decimator
+#define DECIMATOR_MAX_CHANNELS 2
+/// The samples a Decimator holds (a power of two, well over
+/// DECIMATOR_MAX_TAPS, so that a slow reader is not overtaken)
+#define DECIMATOR_RING 256
+
+/**
+ * @brief Decimating FIR Filter
+ * 
+ * Filters multi-channel samples pushed at a high rate (e.g. by an
+ * oversampling thread) through an FIR filter, whose output is only
+ * computed when it is read, at a lower rate (the polyphase form's
+ * saving: no output is computed that is then thrown away). Each output
+ * is of the newest samples, so its delay is just the filter's group
+ * delay (e.g. (length - 1) / 2 samples, for DesignWindowedSinc()'s).
+ * 
+ * One thread may push while others read: samples are published by
+ * head, as a flight log's entries are, and a read that the pusher
+ * overtakes is retried.
+*/
+typedef struct {
+    //! The filter's taps
+    Real taps[DECIMATOR_MAX_TAPS];
+    //! The recent samples (a ring, by channel)
+    Real samples[DECIMATOR_RING][DECIMATOR_MAX_CHANNELS];
+    int length;     //!< The number of taps
+    int channels;   //!< The number of channels
+    uint32_t head;  //!< The number of samples pushed
+} Decimator;
+
+/**
+ * Initializes a Decimator
+ * 
+ * @param taps The filter's taps
+ * @param length The number of taps (at most DECIMATOR_MAX_TAPS)
+ * @param channels The number of channels (at most
+ * DECIMATOR_MAX_CHANNELS)
+ * @param result A return parameter, which becomes the decimator, with
+ * no samples yet
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+*/
+int DecimatorInit(const Real taps[],
+                  int length,
+                  int channels,
+                  Decimator *result);
+
+/**
+ * Pushes a sample (of every channel) into a Decimator
+ * 
+ * @param dec The decimator
+ * @param sample The sample, by channel
+ * 
+ * @pre Only one thread pushes into dec
+*/
+void DecimatorPush(Decimator *dec, const Real sample[]);
+
+/**
+ * Filters a Decimator's newest samples
+ * 
+ * @param dec The decimator
+ * @param result A return parameter, which becomes the output, by channel
+ * 
+ * @return 0 upon success, EXIT_FAILURE if fewer samples than taps have
+ * been pushed yet (and result is left as it was)
+*/
+int DecimatorOutput(const Decimator *dec, Real result[]);
+
+
+/* State-Space Systems */
+
+
+// Fully unrolls the state-space product, so that it is vectorized as
+// straight-line code at -O2 (GCC 8+; older compilers ignore it)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#define STATE_SPACE_UNROLL _Pragma("GCC unroll 64")
+#else
+#define STATE_SPACE_UNROLL
+#endif
+
+/**
+ * @brief Defines a fixed-size, discrete state-space system
+ * 
+ * Defines a system name with NX states, NU inputs and NY outputs,
+ * 
+ *     x[k+1] = A x[k] + B u[k]
+ *     y[k]   = C x[k] + D u[k]
+ * 
+ * with no heap use, and its functions:
+ * 
+ *     static inline void nameInit(double a[NX][NX], double b[NX][NU],
+ *                                 double c[NY][NX], double d[NY][NU],
+ *                                 name *result);
+ *     static inline void nameStep(name *sys, Real input[NU],
+ *                                 Real output[NY], Real lower_lim,
+ *                                 Real upper_lim);
+ * 
+ * The matrices are stored stacked as [C D; A B], which makes each step
+ * a single (NY+NX) x (NX+NU) matrix-vector product over [x; u], with
+ * every loop bound a compile-time constant. The stacked matrix is stored
+ * by column, so that the product is a sum of scaled columns, which the
+ * compiler unrolls and vectorizes across the outputs and next states.
+ * This lets one system run coupled controllers (e.g. LQR gains,
+ * observers) over both axes.
+ * 
+ * @param name The name of the system type
+ * @param NX The number of states
+ * @param NU The number of inputs
+ * @param NY The number of outputs
+*/
+#define DEFINE_STATE_SPACE(name, NX, NU, NY) \
+    typedef struct { \
+        /** [C D; A B], by column (column j multiplies [x; u][j]) */ \
+        Real matrix[(NX) + (NU)][(NY) + (NX)]; \
+        /** The state x */ \
+        Real state[NX]; \
+    } name; \
+    static inline void name##Init(double a[NX][NX], \
+                                  double b[NX][NU], \
+                                  double c[NY][NX], \
+                                  double d[NY][NU], \
+                                  name *result) { \
+        int i, j; \
+        for (j = 0; j < (NX); j++) { \
+            for (i = 0; i < (NY); i++) result->matrix[j][i] = c[i][j]; \
+            for (i = 0; i < (NX); i++) result->matrix[j][(NY) + i] = a[i][j]; \
+            result->state[j] = 0.0; \
+        } \
+        for (j = 0; j < (NU); j++) { \
+            for (i = 0; i < (NY); i++) { \
+                result->matrix[(NX) + j][i] = d[i][j]; \
+            } \
+            for (i = 0; i < (NX); i++) { \
+                result->matrix[(NX) + j][(NY) + i] = b[i][j]; \
+            } \
+        } \
+    } \
+    static inline void name##Step(name *sys, \
+                                  Real input[NU], \
+                                  Real output[NY], \
+                                  Real lower_lim, \
+                                  Real upper_lim) { \
+        /* Local copies, which cannot alias sys, so that the */ \
+        /* product vectorizes without runtime alias checks */ \
+        Real vector[(NX) + (NU)]; \
+        Real result[(NY) + (NX)]; \
+        int i, j; \
+        for (j = 0; j < (NX); j++) vector[j] = sys->state[j]; \
+        for (j = 0; j < (NU); j++) vector[(NX) + j] = input[j]; \
+        for (i = 0; i < (NY) + (NX); i++) result[i] = 0.0; \
+        STATE_SPACE_UNROLL \
+        for (j = 0; j < (NX) + (NU); j++) { \
+            STATE_SPACE_UNROLL \
+            for (i = 0; i < (NY) + (NX); i++) { \
+                result[i] += sys->matrix[j][i] * vector[j]; \
+            } \
+        } \
+        for (i = 0; i < (NY); i++) { \
+            output[i] = result[i] < lower_lim ? lower_lim : \
+                (result[i] > upper_lim ? upper_lim : result[i]); \
+        } \
+        for (i = 0; i < (NX); i++) sys->state[i] = result[(NY) + i]; \
+    }
 
 #endif  // DISCRETE_LIB_H_
@@ -0,0 +1,472 @@
+/**
+ * @file dispatcher.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Multi-Rate Periodic Task Dispatcher
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#ifndef HOST_TIMER
+#include "MyRio.h"
+#include "TimerIRQ.h"
+#endif
+
+#include "error.h"
+#include "setup.h"
+#include "io.h"
+#include "thread-lib.h"
+
+#include "dispatcher.h"
+
+
+/* Dispatcher Thread & Resources */
+
+
+/// Dispatcher Thread ID
+static pthread_t dispatcher_thread;
+/// Dispatcher Thread Resources (holds the IRQ context)
+static ThreadResource dispatcher_resource;
+/// Local Error Code
+static int error;
+
+
+/* Task Table */
+
+
+/// The registered tasks
+static ThreadResource *tasks[DISPATCHER_MAX_TASKS];
+/// The number of registered tasks
+static int num_tasks;
+/// Guards tasks and num_tasks
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+/// The number of base ticks since DispatcherFork() (guarded by tasks_lock)
+static uint32_t tick;
+
+
+/* Timer Backend */
+
+
+#ifdef VIRTUAL_TIMER
+/// Guards the lockstep (and signals each change to it)
+static pthread_mutex_t lockstep_lock = PTHREAD_MUTEX_INITIALIZER;
+/// Signals that a task has finished, or a tick is wanted or done
+static pthread_cond_t lockstep_cond = PTHREAD_COND_INITIALIZER;
+/// Whether the virtual clock is ticking (see TimerOpen())
+static bool lockstep_running;
+/// The ticks granted (guarded by lockstep_lock)
+static uint32_t ticks_granted;
+/// The ticks whose tasks have all finished (guarded by lockstep_lock)
+static uint32_t ticks_done;
+/// The ticks wanted by DispatcherYield() (guarded by lockstep_lock)
+static uint32_t ticks_wanted;
+/// Marks the threads of tasks, with their ThreadResource
+static pthread_key_t task_key;
+/// Creates task_key once
+static pthread_once_t task_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Creates task_key (once)
+*/
+static void TaskKeyCreate();
+#else
+/// The next base tick (CLOCK_MONOTONIC, ns)
+static uint64_t deadline_ns;
+#endif
+
+
+/**
+ * Starts the base tick timer
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+static int TimerOpen();
+
+/**
+ * Waits for the next base tick
+ * 
+ * @return Nonzero if the tick arrived, 0 if the wait timed out
+ * or was stopped
+*/
+static uint32_t TimerWait();
+
+/**
+ * Acknowledges a base tick, once its tasks are released
+ * 
+ * @param irq_assert The value returned by TimerWait()
+*/
+static void TimerAcknowledge(uint32_t irq_assert);
+
+/**
+ * Wakes the dispatcher, if it waits for a base tick, so that it sees
+ * it has been stopped
+*/
+static void TimerInterrupt();
+
+/**
+ * Stops the base tick timer
+*/
+static void TimerClose();
+
+
+/* Thread Function */
+
+
+/**
+ * @brief Dispatcher Thread Function
+ * 
+ * Waits for every timer IRQ, re-arms the timer, and releases
+ * every task due at the new tick
+ * 
+ * @param resource A pointer to the dispatcher's ThreadResource
+ * 
+ * @return NULL
+*/
+static void *DispatcherThread(void *resource);
+
+/**
+ * Releases a task
+ * 
+ * @param task The task to release
+ * @param now The release time (ns)
+ * 
+ * @post The task is released, or its overruns are incremented
+ * if it has not finished its last release
+*/
+static inline void Release(ThreadResource *task, uint64_t now);
+
+
+/* Dispatcher Function Definitions */
+
+
+int DispatcherFork() {
+    tick = 0;
+    dispatcher_resource.name = "dispatcher";
+    dispatcher_resource.attributes.priority = DISPATCHER_PRIORITY;
+    dispatcher_resource.attributes.cpu = DISPATCHER_CPU;
+    dispatcher_resource.period = 1;
+    ThreadStatsReset(&(dispatcher_resource.stats));
+    VERIFY(error, TimerOpen());
+    START_THREAD(dispatcher_thread, DispatcherThread, dispatcher_resource);
+    return EXIT_SUCCESS;
+}
+
+int DispatcherJoin() {
+    dispatcher_resource.irq_thread_rdy = false;
+    TimerInterrupt();
+    VERIFY(error, pthread_join(dispatcher_thread, NULL));
+    TimerClose();
+    ThreadStatsPrint(&dispatcher_resource);
+    if (dispatcher_resource.stats.period.count) {
+        printf("base tick: mean period %.3f us (nominal %u us)\n",
+               dispatcher_resource.stats.period.sum_ns / 1000.0
+               / dispatcher_resource.stats.period.count, BTI_US);
+    }
+    return EXIT_SUCCESS;
+}
+
+int DispatcherRegister(ThreadResource *resource,
+                       const char *name,
+                       uint32_t period,
+                       uint32_t phase,
+                       int priority,
+                       int cpu) {
+    if (period == 0) return EXIT_FAILURE;
+    VERIFY(error, sem_init(&(resource->release), 0, 0));
+    resource->name = name;
+    resource->period = period;
+    resource->attributes.priority = priority;
+    resource->attributes.cpu = cpu;
+    resource->busy = false;
+    resource->overruns = 0;
+    ThreadStatsReset(&(resource->stats));
+
+    pthread_mutex_lock(&tasks_lock);
+    if (num_tasks == DISPATCHER_MAX_TASKS) {
+        pthread_mutex_unlock(&tasks_lock);
+        sem_destroy(&(resource->release));
+        return EXIT_FAILURE;
+    }
+    // The phase is relative to now
+    resource->phase = (tick + 1 + phase) % period;
+    tasks[num_tasks++] = resource;
+    pthread_mutex_unlock(&tasks_lock);
+    return EXIT_SUCCESS;
+}
+
+int DispatcherUnregister(ThreadResource *resource) {
+    int i;
+    pthread_mutex_lock(&tasks_lock);
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i] == resource) {
+            tasks[i] = tasks[--num_tasks];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    ThreadStatsPrint(resource);
+    return sem_destroy(&(resource->release));
+}
+
+uint32_t DispatcherWait(ThreadResource *resource) {
+    // The last release ends here, unless TASK_COMPLETE() ended it sooner
+    TASK_COMPLETE(resource);
+#ifdef VIRTUAL_TIMER
+    // (and the virtual clock may go on, once every task's has)
+    pthread_setspecific(task_key, resource);
+    pthread_mutex_lock(&lockstep_lock);
+    resource->busy = false;
+    pthread_cond_broadcast(&lockstep_cond);
+    pthread_mutex_unlock(&lockstep_lock);
+#else
+    resource->busy = false;
+#endif
+    while (sem_wait(&(resource->release)) && errno == EINTR) {}
+    resource->busy = true;
+    if (!resource->irq_thread_rdy) return 0;
+    ThreadStatsWake(&(resource->stats));
+    return 1;
+}
+
+void DispatcherYield() {
+#ifdef VIRTUAL_TIMER
+    uint32_t target;
+
+    pthread_once(&task_key_once, TaskKeyCreate);
+    // A task's release is a tick already
+    if (pthread_getspecific(task_key) != NULL) return;
+
+    pthread_mutex_lock(&lockstep_lock);
+    if (!lockstep_running) {
+        // Nothing else runs, so the clock steps alone
+        ThreadClockAdvance(BTI_US * 1000u);
+    } else {
+        target = ticks_granted + 1;
+        ticks_wanted = target;
+        pthread_cond_broadcast(&lockstep_cond);
+        while (lockstep_running && (int32_t) (ticks_done - target) < 0) {
+            pthread_cond_wait(&lockstep_cond, &lockstep_lock);
+        }
+    }
+    pthread_mutex_unlock(&lockstep_lock);
+#endif
+}
+
+
+/* Thread Function Definitions */
+
+
+static void *DispatcherThread(void *resource) {
+    ThreadResource *thread_resource = (ThreadResource *) resource;
+    int i;
+
+    while (thread_resource->irq_thread_rdy) {
+        uint32_t irq_assert = TimerWait();
+        // The tick's time is unknown, so only the period (jitter) and
+        // the time spent releasing tasks are measured
+        ThreadStatsWake(&(thread_resource->stats));
+
+        if (irq_assert) {
+            uint64_t now = thread_resource->stats.wake_ns;
+            pthread_mutex_lock(&tasks_lock);
+            tick++;
+            for (i = 0; i < num_tasks; i++) {
+                if (tick % tasks[i]->period == tasks[i]->phase) {
+                    Release(tasks[i], now);
+                }
+            }
+            pthread_mutex_unlock(&tasks_lock);
+
+            TimerAcknowledge(irq_assert);
+        }
+        TASK_COMPLETE(thread_resource);
+    }
+
+    EXIT_THREAD();
+}
+
+static inline void Release(ThreadResource *task, uint64_t now) {
+    int pending = 0;
+    sem_getvalue(&(task->release), &pending);
+    if (task->busy || pending > 0) {
+        task->overruns++;
+        return;
+    }
+    // Published to the task by sem_post()
+    task->stats.release_ns = now;
+#ifdef VIRTUAL_TIMER
+    // Busy from now on (not from when it wakes), so that the lockstep
+    // waits for it, unless its thread has exited (see TaskExit())
+    if (!task->irq_thread_rdy) return;
+    task->busy = true;
+#endif
+    sem_post(&(task->release));
+}
+
+
+/* Timer Backend Definitions */
+
+
+#ifdef VIRTUAL_TIMER
+
+/**
+ * Checks whether every task has finished its release
+ * 
+ * @return true iff no task is busy
+*/
+static bool AllDone() {
+    bool done = true;
+    int i;
+    pthread_mutex_lock(&tasks_lock);
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i]->busy) done = false;
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    return done;
+}
+
+/**
+ * Finishes a task's release when its thread exits (e.g. by
+ * EXIT_THREAD() in the middle of a release)
+ * 
+ * @param resource The task's ThreadResource
+*/
+static void TaskExit(void *resource) {
+    pthread_mutex_lock(&lockstep_lock);
+    // Never to be released again
+    ((ThreadResource *) resource)->irq_thread_rdy = false;
+    ((ThreadResource *) resource)->busy = false;
+    pthread_cond_broadcast(&lockstep_cond);
+    pthread_mutex_unlock(&lockstep_lock);
+}
+
+static void TaskKeyCreate() {
+    pthread_key_create(&task_key, TaskExit);
+}
+
+static int TimerOpen() {
+    pthread_once(&task_key_once, TaskKeyCreate);
+    pthread_mutex_lock(&lockstep_lock);
+    lockstep_running = true;
+    ticks_granted = 0;
+    ticks_done = 0;
+    ticks_wanted = 0;
+    pthread_mutex_unlock(&lockstep_lock);
+    return EXIT_SUCCESS;
+}
+
+static uint32_t TimerWait() {
+    uint32_t granted = 0;
+    pthread_mutex_lock(&lockstep_lock);
+    while (lockstep_running) {
+        if (AllDone()) {
+            // The last tick is done, so the next may start (once a
+            // DispatcherYield() wants it)
+            if (ticks_done != ticks_granted) {
+                ticks_done = ticks_granted;
+                pthread_cond_broadcast(&lockstep_cond);
+            }
+            if (ticks_wanted != ticks_granted) {
+                ticks_granted++;
+                ThreadClockAdvance(BTI_US * 1000u);
+                granted = 1;
+                break;
+            }
+        }
+        pthread_cond_wait(&lockstep_cond, &lockstep_lock);
+    }
+    pthread_mutex_unlock(&lockstep_lock);
+    return granted;
+}
+
+static void TimerAcknowledge(uint32_t irq_assert) {}
+
+static void TimerInterrupt() {
+    pthread_mutex_lock(&lockstep_lock);
+    lockstep_running = false;
+    pthread_cond_broadcast(&lockstep_cond);
+    pthread_mutex_unlock(&lockstep_lock);
+}
+
+static void TimerClose() {}
+
+#elif defined(HOST_TIMER)
+
+static int TimerOpen() {
+    deadline_ns = ThreadClockNs();
+    return EXIT_SUCCESS;
+}
+
+static uint32_t TimerWait() {
+    struct timespec deadline;
+    // Sleep until an absolute deadline, so that late wake-ups do not
+    // accumulate (a late tick is followed by a short one)
+    deadline_ns += BTI_US * 1000u / HOST_TIME_SCALE;
+    deadline.tv_sec = deadline_ns / 1000000000u;
+    deadline.tv_nsec = deadline_ns % 1000000000u;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                           &deadline, NULL) == EINTR) {}
+    return 1;
+}
+
+static void TimerAcknowledge(uint32_t irq_assert) {}
+
+static void TimerInterrupt() {}
+
+static void TimerClose() {}
+
+#else
+
+static int TimerOpen() {
+    deadline_ns = ThreadClockNs() + BTI_US * 1000u;
+    return Irq_RegisterTimerIrq(&timer,
+                                &(dispatcher_resource.irq_context),
+                                BTI_US);
+}
+
+static uint32_t TimerWait() {
+    uint32_t irq_assert = 0;
+    uint64_t now;
+    uint32_t interval;
+    Irq_Wait(dispatcher_resource.irq_context,
+             TIMERIRQNO,
+             &irq_assert,
+             (NiFpga_Bool *) &(dispatcher_resource.irq_thread_rdy));
+    // A timeout leaves the timer running
+    if (!irq_assert) return 0;
+
+    // The timer counts from when it is armed, so arming it for BTI_US
+    // would add the wake-up latency to every period. Arm it for what
+    // is left until the next tick of the absolute schedule instead
+    // (or as soon as possible, if that has passed, to catch up).
+    deadline_ns += BTI_US * 1000u;
+    now = ThreadClockNs();
+    interval = deadline_ns > now + 1000u ?
+               (uint32_t) ((deadline_ns - now) / 1000u) : 1u;
+    NiFpga_WriteU32(myrio_session, IRQTIMERWRITE, interval);
+    NiFpga_WriteBool(myrio_session, IRQTIMERSETTIME, NiFpga_True);
+    return irq_assert;
+}
+
+static void TimerAcknowledge(uint32_t irq_assert) {
+    Irq_Acknowledge(irq_assert);
+}
+
+static void TimerInterrupt() {}
+
+static void TimerClose() {
+    Irq_UnregisterTimerIrq(&timer, dispatcher_resource.irq_context);
+}
+
+#endif  // VIRTUAL_TIMER, HOST_TIMER
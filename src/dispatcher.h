@@ -0,0 +1,199 @@
+/**
+ * @file dispatcher.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Multi-Rate Periodic Task Dispatcher Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * The dispatcher owns the (single) FPGA timer IRQ. Every base tick
+ * (BTI_US), it releases each registered task whose period (in ticks)
+ * divides the ticks since its phase offset, so that low-rate work
+ * (keypad, LCD) no longer runs at, or competes with, the control rate.
+ * 
+ * Built with -DHOST_TIMER (make TIMER=host), the base tick comes from
+ * absolute-deadline clock_nanosleep() on CLOCK_MONOTONIC instead, so
+ * that the tasks can run (and be soak-tested) on a Linux host. A tick
+ * then takes BTI_US / HOST_TIME_SCALE of the host's clock (see hal.h's
+ * simulated plant, which keeps up).
+ * 
+ * Built with -DVIRTUAL_TIMER as well (make TIMER=virtual, or make sim
+ * SIM_CLOCK=virtual), the base tick is virtual: the next tick starts
+ * only once every task has finished its release and the main thread
+ * waits for it in DispatcherYield(), and then advances ThreadClockNs()
+ * by exactly BTI_US. So the tasks, the simulated plant and the main
+ * thread's state machine go in lockstep, as fast as they run, and
+ * every run (from the same keys) gives the same results, to the bit.
+ */
+
+#ifndef DISPATCHER_H_
+#define DISPATCHER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "thread-lib.h"
+
+
+/* Dispatcher Limits */
+
+
+/// The maximum number of registered tasks
+#define DISPATCHER_MAX_TASKS 8
+
+
+/* Task Rates (in base ticks of BTI_MS) */
+
+
+/**
+ * Converts a period in milliseconds to base ticks
+ * 
+ * @param ms The period (ms), a multiple of BTI_MS
+*/
+#define TASK_PERIOD(ms) ((ms) / BTI_MS)
+
+/// Control Law Period (5 ms)
+#define CONTROL_PERIOD TASK_PERIOD(5u)
+/// Control Law Phase
+#define CONTROL_PHASE 0u
+/// Keypad Scan Period (10 ms)
+#define KEYPAD_PERIOD TASK_PERIOD(10u)
+/// Keypad Scan Phase
+#define KEYPAD_PHASE 1u
+/// LCD Update Period (200 ms)
+#define DISPLAY_PERIOD TASK_PERIOD(200u)
+/// LCD Update Phase
+#define DISPLAY_PHASE 3u
+/// Recorder Drain Period (50 ms)
+#define RECORDER_PERIOD TASK_PERIOD(50u)
+/// Recorder Drain Phase
+#define RECORDER_PHASE 2u
+
+
+/* Task Cores (the myRIO's Cortex-A9 has two) */
+
+
+/// Dispatcher Core (with the control law, which it releases)
+#define DISPATCHER_CPU 1
+/// Control Law Core (nothing else runs there)
+#define CONTROL_CPU 1
+/// Keypad Scan Core
+#define KEYPAD_CPU 0
+/// LCD Update Core
+#define DISPLAY_CPU 0
+/// Recorder Drain Core
+#define RECORDER_CPU 0
+/// Potentiometer Sampler Core (a free-running thread, see io.h)
+#define SAMPLER_CPU 0
+
+
+/* Task Priorities (SCHED_FIFO) */
+
+
+/// Dispatcher Priority (above every task)
+#define DISPATCHER_PRIORITY 90
+/// Control Law Priority
+#define CONTROL_PRIORITY 80
+/// Keypad Scan Priority
+#define KEYPAD_PRIORITY 60
+/// Potentiometer Sampler Priority (short, but steady)
+#define SAMPLER_PRIORITY 30
+/// LCD Update Priority
+#define DISPLAY_PRIORITY 20
+/// Recorder Drain Priority (below the display, which the user watches)
+#define RECORDER_PRIORITY 10
+
+
+/* Dispatcher Functions */
+
+
+/**
+ * Starts the dispatcher
+ * 
+ * Starts the base tick timer (the global timer's IRQ, or the host
+ * clock), and the dispatcher's thread, which then releases the
+ * registered tasks every base tick
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @pre IOSetup() has been called, and no other thread uses
+ * the global timer
+*/
+int DispatcherFork();
+
+/**
+ * Stops the dispatcher
+ * 
+ * Prints the dispatcher's timing statistics
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @pre No tasks are registered
+ * @post The global timer is free
+*/
+int DispatcherJoin();
+
+/**
+ * Registers a periodic task
+ * 
+ * @param resource The task's ThreadResource
+ * @param name The task's name (for reports)
+ * @param period The task's period, in base ticks (> 0)
+ * @param phase The task's phase offset, in base ticks
+ * @param priority The task's SCHED_FIFO priority (0 for the
+ * default scheduling policy)
+ * @param cpu The core to pin the task to (or THREAD_ANY_CPU)
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @post resource is released every period ticks, starting phase
+ * ticks from now
+*/
+int DispatcherRegister(ThreadResource *resource,
+                       const char *name,
+                       uint32_t period,
+                       uint32_t phase,
+                       int priority,
+                       int cpu);
+
+/**
+ * Unregisters a periodic task
+ * 
+ * Prints the task's timing statistics, which are kept (e.g. for
+ * RecordThreadStats()) until it is registered again
+ * 
+ * @param resource The task's ThreadResource
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @pre The task's thread has been stopped
+ * @post resource is no longer released
+*/
+int DispatcherUnregister(ThreadResource *resource);
+
+/**
+ * Waits for a task's next release
+ * 
+ * Completes the task's last release (see TASK_COMPLETE()), and
+ * records its wake-up latency and period
+ * 
+ * @param resource The task's ThreadResource
+ * 
+ * @return 1 if the task was released, 0 if it was stopped
+*/
+uint32_t DispatcherWait(ThreadResource *resource);
+
+/**
+ * Waits for the next base tick's tasks (from a thread that is not a
+ * task, e.g. while polling the keypad)
+ * 
+ * With the virtual clock, starts the next base tick, and waits until
+ * its tasks have all finished (or, if the dispatcher is not running,
+ * advances the clock by a tick alone). Otherwise (and from a task), it
+ * returns at once.
+*/
+void DispatcherYield();
+
+#endif  // DISPATCHER_H_
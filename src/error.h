@@ -35,4 +35,17 @@ extern int u_error;
 #define EENCR -5
 
 
+/* Real-Time Error Codes */
+
+/// Real-Time Privilege Error (no permission for
+/// SCHED_FIFO or locking memory)
+#define ERTPR -6
+
+
+/* Recording Error Codes */
+
+/// Data File Error (a mode's data file could not be opened)
+#define EFILE -7
+
+
 #endif  // ERROR_H_
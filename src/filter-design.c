@@ -0,0 +1,294 @@
+/**
+ * @file filter-design.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Continuous-to-Discrete Filter Design Library
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "discrete-lib.h"
+
+#include "filter-design.h"
+
+
+/* Factoring Helper Functions */
+
+
+/**
+ * Groups roots into polynomial factors of at most second order
+ * (a complex pair, or two real roots, or a single real root),
+ * with all second order factors first
+ * 
+ * @param roots The roots to group
+ * @param num_roots The size of roots
+ * @param factors A return parameter, which becomes the factors'
+ * coefficients in decreasing powers of s (s^2, s^1, s^0)
+ * @param max_factors The size of factors
+ * 
+ * @return The number of factors upon success, negative if
+ * they do not fit into factors
+*/
+static int FactorRoots(Root roots[],
+                       int num_roots,
+                       double factors[][3],
+                       int max_factors);
+
+
+/* Design Functions */
+
+
+int DesignSection(double numerator[3],
+                  double denominator[3],
+                  double timestep,
+                  double prewarp,
+                  Biquad *result) {
+    if (timestep <= 0.0) {
+        return EXIT_FAILURE;
+    }
+
+    double K = prewarp > 0.0 ?
+        prewarp / tan(prewarp * timestep / 2.0) :
+        2.0 / timestep;
+    double K2 = K * K;
+
+    double num[3], den[3];
+    if (numerator[0] == 0.0 && denominator[0] == 0.0 &&
+        numerator[1] == 0.0 && denominator[1] == 0.0) {
+        // A pure gain
+        num[0] = numerator[2];
+        num[1] = 0.0;
+        num[2] = 0.0;
+        den[0] = denominator[2];
+        den[1] = 0.0;
+        den[2] = 0.0;
+    } else if (numerator[0] == 0.0 && denominator[0] == 0.0) {
+        // A first order section: substitute, and multiply through by
+        // (1 + z^-1) alone, so as not to add a pole and zero at z = -1
+        num[0] = numerator[1] * K + numerator[2];
+        num[1] = numerator[2] - numerator[1] * K;
+        num[2] = 0.0;
+        den[0] = denominator[1] * K + denominator[2];
+        den[1] = denominator[2] - denominator[1] * K;
+        den[2] = 0.0;
+    } else {
+        // Substitute s = K(1 - z^-1)/(1 + z^-1), and multiply through
+        // by (1 + z^-1)^2
+        num[0] = numerator[0] * K2 + numerator[1] * K + numerator[2];
+        num[1] = 2.0 * (numerator[2] - numerator[0] * K2);
+        num[2] = numerator[0] * K2 - numerator[1] * K + numerator[2];
+        den[0] = denominator[0] * K2 + denominator[1] * K + denominator[2];
+        den[1] = 2.0 * (denominator[2] - denominator[0] * K2);
+        den[2] = denominator[0] * K2 - denominator[1] * K + denominator[2];
+    }
+
+    return BiquadInit(num, den, result);
+}
+
+int DesignZPK(Root zeros[],
+              int num_zeros,
+              Root poles[],
+              int num_poles,
+              double gain,
+              double timestep,
+              double prewarp,
+              Biquad result[],
+              int max_size) {
+    double num[BANK_MAX_STAGES][3];
+    double den[BANK_MAX_STAGES][3];
+    int i;
+
+    if (max_size > BANK_MAX_STAGES) {
+        max_size = BANK_MAX_STAGES;
+    }
+
+    int num_den = FactorRoots(poles, num_poles, den, max_size);
+    int num_num = FactorRoots(zeros, num_zeros, num, max_size);
+    if (num_den < 0 || num_num < 0 || num_num > num_den) {
+        return -1;
+    }
+    // A pure gain still needs a section to carry it
+    if (num_den == 0) {
+        den[0][0] = 0.0;
+        den[0][1] = 0.0;
+        den[0][2] = 1.0;
+        num_den = 1;
+    }
+
+    for (i = 0; i < num_den; i++) {
+        double *n = num[i];
+        if (i >= num_num) {
+            n[0] = 0.0;
+            n[1] = 0.0;
+            n[2] = 1.0;
+        }
+        // Every section must be proper on its own
+        if ((n[0] != 0.0 && den[i][0] == 0.0) ||
+            (n[1] != 0.0 && den[i][0] == 0.0 && den[i][1] == 0.0)) {
+            return -1;
+        }
+        // Bring each section to unity gain at DC where it has one, so
+        // that no one section amplifies the signal for the next to cut
+        // back, and carry its gain in the remainder instead
+        if (n[2] != 0.0 && den[i][2] != 0.0) {
+            double dc = n[2] / den[i][2];
+            n[0] /= dc;
+            n[1] /= dc;
+            n[2] /= dc;
+            gain *= dc;
+        }
+    }
+
+    // Apply the remainder once, on the last section
+    num[num_den - 1][0] *= gain;
+    num[num_den - 1][1] *= gain;
+    num[num_den - 1][2] *= gain;
+
+    for (i = 0; i < num_den; i++) {
+        if (DesignSection(num[i], den[i], timestep, prewarp, result + i)) {
+            return -1;
+        }
+    }
+
+    return num_den;
+}
+
+int DesignButterworthLowPass(int order,
+                             double cutoff,
+                             double timestep,
+                             Biquad result[],
+                             int max_size) {
+    Root poles[BANK_MAX_STAGES];
+    int num_poles = 0;
+    int k;
+
+    if (order < 1 || cutoff <= 0.0 || (order + 1) / 2 > BANK_MAX_STAGES) {
+        return -1;
+    }
+
+    // The poles lie on the left half of a circle of radius cutoff;
+    // only the upper half of each pair is listed
+    for (k = 0; k < order / 2; k++) {
+        double angle = M_PI * (2.0 * k + order + 1.0) / (2.0 * order);
+        poles[num_poles].re = cutoff * cos(angle);
+        poles[num_poles].im = fabs(cutoff * sin(angle));
+        num_poles++;
+    }
+    if (order % 2) {
+        poles[num_poles].re = -cutoff;
+        poles[num_poles].im = 0.0;
+        num_poles++;
+    }
+
+    return DesignZPK(NULL, 0, poles, num_poles, pow(cutoff, order),
+                     timestep, cutoff, result, max_size);
+}
+
+int DesignNotch(double center,
+                double bandwidth,
+                double timestep,
+                Biquad *result) {
+    if (center <= 0.0 || bandwidth <= 0.0) {
+        return EXIT_FAILURE;
+    }
+
+    double numerator[3] = {1.0, 0.0, center * center};
+    double denominator[3] = {1.0, bandwidth, center * center};
+
+    return DesignSection(numerator, denominator, timestep, center, result);
+}
+
+int DesignWindowedSinc(int taps,
+                       double cutoff,
+                       double timestep,
+                       Real result[]) {
+    double wc = cutoff * timestep;
+    double middle = (taps - 1) / 2.0;
+    double sum = 0.0;
+    int n;
+
+    if (taps < 1 || wc <= 0.0 || wc >= M_PI) {
+        return EXIT_FAILURE;
+    }
+
+    for (n = 0; n < taps; n++) {
+        double t = n - middle;
+        double h = t == 0.0 ? wc / M_PI : sin(wc * t) / (M_PI * t);
+        if (taps > 1) {
+            h *= 0.54 - 0.46 * cos(2.0 * M_PI * n / (taps - 1));
+        }
+        result[n] = h;
+        sum += h;
+    }
+
+    // Unity gain at DC
+    for (n = 0; n < taps; n++) {
+        result[n] /= sum;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* Factoring Helper Functions */
+
+
+static int FactorRoots(Root roots[],
+                       int num_roots,
+                       double factors[][3],
+                       int max_factors) {
+    int num_factors = 0;
+    int i;
+    Root *single = NULL;
+
+    // Complex pairs: s^2 - 2 Re(p) s + |p|^2
+    for (i = 0; i < num_roots; i++) {
+        if (roots[i].im != 0.0) {
+            if (num_factors == max_factors) {
+                return -1;
+            }
+            factors[num_factors][0] = 1.0;
+            factors[num_factors][1] = -2.0 * roots[i].re;
+            factors[num_factors][2] = roots[i].re * roots[i].re +
+                                      roots[i].im * roots[i].im;
+            num_factors++;
+        }
+    }
+
+    // Real roots, two at a time: s^2 - (p + q) s + pq
+    for (i = 0; i < num_roots; i++) {
+        if (roots[i].im != 0.0) {
+            continue;
+        }
+        if (single == NULL) {
+            single = roots + i;
+            continue;
+        }
+        if (num_factors == max_factors) {
+            return -1;
+        }
+        factors[num_factors][0] = 1.0;
+        factors[num_factors][1] = -(single->re + roots[i].re);
+        factors[num_factors][2] = single->re * roots[i].re;
+        num_factors++;
+        single = NULL;
+    }
+
+    // The left over real root: s - p
+    if (single != NULL) {
+        if (num_factors == max_factors) {
+            return -1;
+        }
+        factors[num_factors][0] = 0.0;
+        factors[num_factors][1] = 1.0;
+        factors[num_factors][2] = -single->re;
+        num_factors++;
+    }
+
+    return num_factors;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file filter-design.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Continuous-to-Discrete Filter Design Library Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#ifndef FILTER_DESIGN_H_
+#define FILTER_DESIGN_H_
+
+#include "discrete-lib.h"
+
+
+/* Design Data Structures */
+
+
+/**
+ * @brief A Root
+ * 
+ * A (continuous-time) zero or pole, in rad/s. A root with a non-zero
+ * imaginary part stands for a complex-conjugate pair, so each pair
+ * is only listed once
+*/
+typedef struct {
+    double re;  //!< Real part
+    double im;  //!< Imaginary part (0.0 iff the root is real)
+} Root;
+
+
+/* Design Constants */
+
+
+/// No prewarping (plain Tustin/bilinear transform)
+#define NO_PREWARP 0.0
+
+
+/* Design Functions */
+
+
+/**
+ * Discretizes a continuous section of at most second order
+ * 
+ * Uses the Tustin (bilinear) transform, s = K(1 - z^-1)/(1 + z^-1),
+ * where K = 2/timestep, or K = prewarp/tan(prewarp * timestep / 2)
+ * so that the discrete and continuous responses agree at prewarp.
+ * A first order section (numerator[0] and denominator[0] both zero)
+ * stays first order, with its z^-2 coefficients zero
+ * 
+ * @param numerator The numerator coefficients, in decreasing powers
+ * of s (s^2, s^1, s^0)
+ * @param denominator The denominator coefficients, in decreasing powers
+ * of s (s^2, s^1, s^0)
+ * @param timestep The timestep, in seconds
+ * @param prewarp The frequency to prewarp at (rad/s), or NO_PREWARP
+ * @param result A return parameter, which becomes the normalized biquad
+ * 
+ * @return 0 upon success, EXIT_FAILURE if the section is degenerate
+*/
+int DesignSection(double numerator[3],
+                  double denominator[3],
+                  double timestep,
+                  double prewarp,
+                  Biquad *result);
+
+/**
+ * Discretizes a continuous system given by its zeros, poles and gain,
+ * H(s) = gain * (s - z_1)...(s - z_m) / ((s - p_1)...(s - p_n)),
+ * into a cascade of biquads (see DesignSection())
+ * 
+ * Each section with a finite, nonzero gain at DC is scaled to unity
+ * gain there, and what remains of gain is applied once, on the last
+ * section
+ * 
+ * @param zeros The zeros (each complex pair listed once)
+ * @param num_zeros The size of zeros
+ * @param poles The poles (each complex pair listed once)
+ * @param num_poles The size of poles
+ * @param gain The gain
+ * @param timestep The timestep, in seconds
+ * @param prewarp The frequency to prewarp at (rad/s), or NO_PREWARP
+ * @param result A return parameter, which becomes the cascade
+ * @param max_size The size of result
+ * 
+ * @return The number of biquads in result upon success, negative if
+ * the system is improper or does not fit in result
+*/
+int DesignZPK(Root zeros[],
+              int num_zeros,
+              Root poles[],
+              int num_poles,
+              double gain,
+              double timestep,
+              double prewarp,
+              Biquad result[],
+              int max_size);
+
+/**
+ * Designs a Butterworth low-pass filter, prewarped at its cutoff
+ * 
+ * @param order The order of the filter
+ * @param cutoff The cutoff (-3 dB) frequency (rad/s)
+ * @param timestep The timestep, in seconds
+ * @param result A return parameter, which becomes the cascade
+ * @param max_size The size of result
+ * 
+ * @return The number of biquads in result ((order + 1) / 2) upon success,
+ * negative otherwise
+*/
+int DesignButterworthLowPass(int order,
+                             double cutoff,
+                             double timestep,
+                             Biquad result[],
+                             int max_size);
+
+/**
+ * Designs a notch filter, (s^2 + w^2) / (s^2 + bw * s + w^2), prewarped
+ * so that the notch is exactly at center
+ * 
+ * @param center The frequency to reject, w (rad/s), such as PENDULUM_FREQ
+ * @param bandwidth The -3 dB width of the notch, bw (rad/s)
+ * @param timestep The timestep, in seconds
+ * @param result A return parameter, which becomes the biquad
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+*/
+int DesignNotch(double center,
+                double bandwidth,
+                double timestep,
+                Biquad *result);
+
+/**
+ * Designs a linear-phase FIR low-pass filter, a sinc windowed by a
+ * Hamming window, with unity gain at DC. Its group delay is
+ * (taps - 1) / 2 timesteps, at every frequency
+ * 
+ * @param taps The number of taps
+ * @param cutoff The cutoff (-6 dB) frequency (rad/s), under Nyquist
+ * @param timestep The timestep, in seconds
+ * @param result A return parameter, which becomes the taps
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+*/
+int DesignWindowedSinc(int taps,
+                       double cutoff,
+                       double timestep,
+                       Real result[]);
+
+#endif  // FILTER_DESIGN_H_
@@ -0,0 +1,136 @@
+/**
+ * @file flight-log.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Memory-Mapped Flight Log
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+// For posix_fallocate() and MAP_POPULATE
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "thread-lib.h"
+
+#include "flight-log.h"
+
+
+/* Flight Log Constants */
+
+
+/// Alignment of the first slot (bytes), a cache line
+#define FLIGHT_LOG_ALIGN 64
+
+
+/* Flight Log Function Definitions */
+
+
+int FlightLogOpen(FlightLog *log,
+                  const char *path,
+                  int num_entries,
+                  uint32_t sample_size,
+                  uint32_t stride,
+                  uint32_t capacity) {
+    uint32_t header_size = (sizeof(FlightLogHeader) + FLIGHT_LOG_ALIGN - 1)
+                           / FLIGHT_LOG_ALIGN * FLIGHT_LOG_ALIGN;
+    size_t size = header_size + (size_t) capacity * stride;
+    FlightLogHeader *header;
+    int fd;
+
+    log->header = NULL;
+    if (num_entries < 1 || num_entries > FLIGHT_LOG_MAX_ENTRIES ||
+        stride < sample_size || capacity == 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Allocate the blocks now, so that writing back never fails
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return EXIT_FAILURE;
+    if (posix_fallocate(fd, 0, size)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    header = (FlightLogHeader *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, fd, 0);
+    // The mapping keeps the file open
+    close(fd);
+    if (header == MAP_FAILED) return EXIT_FAILURE;
+
+    // Fault in every page, as a write would
+    memset(header, 0, size);
+    memcpy(header->magic, FLIGHT_LOG_MAGIC, sizeof(header->magic));
+    header->version = FLIGHT_LOG_VERSION;
+    header->header_size = header_size;
+    header->num_entries = num_entries;
+    header->sample_size = sample_size;
+    header->stride = stride;
+    header->capacity = capacity;
+    header->bti_us = BTI_US;
+
+    log->header = header;
+    log->slots = (char *) header + header_size;
+    log->size = size;
+    return EXIT_SUCCESS;
+}
+
+void FlightLogSetEntry(FlightLog *log,
+                       int entry,
+                       const char *name,
+                       MatType type,
+                       uint32_t offset) {
+    FlightLogHeader *header = log->header;
+    if (header == NULL || entry < 0 || entry >= (int) header->num_entries) {
+        return;
+    }
+    strncpy(header->names[entry], name, FLIGHT_LOG_NAME_LEN - 1);
+    header->types[entry] = type;
+    header->offsets[entry] = offset;
+}
+
+int FlightLogSync(FlightLog *log) {
+    if (log->header == NULL) return EXIT_SUCCESS;
+    return msync(log->header, log->size, MS_SYNC) ?
+           EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int FlightLogCopy(FlightLog *log, const char *path) {
+    const char *bytes = (const char *) log->header;
+    size_t length = log->size;
+    int err = EXIT_SUCCESS;
+    int fd;
+
+    if (log->header == NULL) return EXIT_FAILURE;
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return EXIT_FAILURE;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written <= 0) {
+            err = EXIT_FAILURE;
+            break;
+        }
+        bytes += written;
+        length -= written;
+    }
+    if (fsync(fd)) err = EXIT_FAILURE;
+    if (close(fd)) err = EXIT_FAILURE;
+    return err;
+}
+
+int FlightLogClose(FlightLog *log) {
+    int err = FlightLogSync(log);
+    if (log->header != NULL && munmap(log->header, log->size)) {
+        err = EXIT_FAILURE;
+    }
+    log->header = NULL;
+    return err;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file flight-log.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Memory-Mapped Flight Log Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * A flight log is a fixed-size circular log of the last samples of a
+ * data file, in a shared mapping of a file. FlightLogWrite() only
+ * stores into the mapping (no system calls), and the kernel owns the
+ * pages, so the log survives the process crashing. Convert it with
+ * tracking-src/Analysis/flight.py.
+ * 
+ * Storing into a page that is being written back still faults, and
+ * may wait on the filesystem (mlockall() does not prevent it), so a
+ * flight log is written off the control path (see record.h).
+ * 
+ * The file is a FlightLogHeader, then capacity slots of stride bytes,
+ * each holding a sample as it was in memory (native byte order). Sample
+ * n is in slot n % capacity, and head counts the samples written; the
+ * slot at head % capacity may be torn.
+ */
+
+#ifndef FLIGHT_LOG_H_
+#define FLIGHT_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "mat-stream.h"
+
+
+/* Flight Log Constants */
+
+
+/// Identifies a flight log
+#define FLIGHT_LOG_MAGIC "ASFLIGHT"
+/// The layout's version
+#define FLIGHT_LOG_VERSION 2u
+/// The most entries a flight log holds
+#define FLIGHT_LOG_MAX_ENTRIES 32
+/// The longest entry name (bytes, with the terminator)
+#define FLIGHT_LOG_NAME_LEN 32
+
+
+/* Flight Log Data Structures */
+
+
+/**
+ * @brief A Flight Log's Header (at the start of its file)
+*/
+typedef struct {
+    char magic[8];  ///< FLIGHT_LOG_MAGIC (without a terminator)
+    uint32_t version;  ///< FLIGHT_LOG_VERSION
+    uint32_t header_size;  ///< offset of the first slot (bytes)
+    uint32_t num_entries;  ///< entries in each sample
+    uint32_t sample_size;  ///< length of each sample (bytes)
+    uint32_t stride;  ///< distance between samples (bytes)
+    uint32_t capacity;  ///< samples held
+    uint64_t head;  ///< samples written (stored after each sample)
+    uint32_t bti_us;  ///< base tick interval (us)
+    uint32_t reserved;  ///< zero
+    /// The entries' names (zero-padded)
+    char names[FLIGHT_LOG_MAX_ENTRIES][FLIGHT_LOG_NAME_LEN];
+    /// The entries' types (MatType)
+    uint32_t types[FLIGHT_LOG_MAX_ENTRIES];
+    /// The entries' offsets in each sample (bytes)
+    uint32_t offsets[FLIGHT_LOG_MAX_ENTRIES];
+} FlightLogHeader;
+
+/**
+ * @brief An Open Flight Log
+*/
+typedef struct {
+    FlightLogHeader *header;  ///< the mapping (NULL if closed)
+    char *slots;  ///< the first slot, in the mapping
+    size_t size;  ///< the mapping's length (bytes)
+} FlightLog;
+
+
+/* Flight Log Functions */
+
+
+/**
+ * Creates a flight log
+ * 
+ * Reserves the file's storage and faults in the mapping, so that no
+ * write ever allocates
+ * 
+ * @param log The FlightLog to open
+ * @param path The file's path (replaced if it exists)
+ * @param num_entries The number of entries (at most FLIGHT_LOG_MAX_ENTRIES)
+ * @param sample_size The length of each sample (bytes)
+ * @param stride The distance between samples (bytes, >= sample_size)
+ * @param capacity The number of samples to hold
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @post Every entry must be described with FlightLogSetEntry()
+*/
+int FlightLogOpen(FlightLog *log,
+                  const char *path,
+                  int num_entries,
+                  uint32_t sample_size,
+                  uint32_t stride,
+                  uint32_t capacity);
+
+/**
+ * Describes an entry of a flight log's samples
+ * 
+ * @param log The FlightLog
+ * @param entry The entry's index
+ * @param name The entry's name
+ * @param type The entry's type
+ * @param offset The entry's offset in each sample (bytes)
+*/
+void FlightLogSetEntry(FlightLog *log,
+                       int entry,
+                       const char *name,
+                       MatType type,
+                       uint32_t offset);
+
+/**
+ * Writes a sample, over the oldest once the log is full
+ * 
+ * Plain stores into the mapping, which may still fault (see above).
+ * Only one thread may write to a log.
+ * 
+ * @param log The FlightLog (a no-op if it is closed)
+ * @param sample The sample (sample_size bytes)
+*/
+static inline void FlightLogWrite(FlightLog *log, const void *sample) {
+    FlightLogHeader *header = log->header;
+    uint64_t head;
+
+    if (header == NULL) return;
+    head = header->head;
+    memcpy(log->slots + (head % header->capacity) * header->stride,
+           sample, header->sample_size);
+    // Count the sample only once it is whole
+    __atomic_store_n(&(header->head), head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes a flight log back to storage
+ * 
+ * @param log The FlightLog
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int FlightLogSync(FlightLog *log);
+
+/**
+ * Copies a flight log to another file, as it is now
+ * 
+ * @param log The FlightLog
+ * @param path The copy's path (replaced if it exists)
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int FlightLogCopy(FlightLog *log, const char *path);
+
+/**
+ * Closes a flight log (its file is kept)
+ * 
+ * @param log The FlightLog to close
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int FlightLogClose(FlightLog *log);
+
+#endif  // FLIGHT_LOG_H_
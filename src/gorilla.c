@@ -0,0 +1,291 @@
+/**
+ * @file gorilla.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Lossless Time-Series Compression
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Bits are packed most significant first. A block is its first value
+ * verbatim, then for each value:
+ * 
+ * float (W = 32 or 64 bits), by x, the XOR with the last value:
+ *   0                              x is 0
+ *   10 <bits>                      x fits the last window (its bits)
+ *   11 <leading:5> <length-1:L> <bits>  a new window (L = 5 or 6)
+ * 
+ * int32, by the delta-of-delta d (wrapping):
+ *   0                              d is 0
+ *   10 <d+63:7>                    -63 <= d <= 64
+ *   110 <d+255:9>                  -255 <= d <= 256
+ *   1110 <d+2047:12>               -2047 <= d <= 2048
+ *   1111 <d:32>                    otherwise
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gorilla.h"
+
+
+/* Gorilla Constants */
+
+
+/// Most bits an int32 takes (after the first)
+#define INT32_MAX_BITS (4 + 32)
+/// Most bits a single takes (after the first)
+#define SINGLE_MAX_BITS (2 + 5 + 5 + 32)
+/// Most bits a double takes (after the first)
+#define DOUBLE_MAX_BITS (2 + 5 + 6 + 64)
+/// Most leading zeros a window stores
+#define MAX_LEADING 31
+
+
+/* Static Helper Functions */
+
+
+/**
+ * Appends bits to a block
+ * 
+ * @param encoder The GorillaEncoder
+ * @param value The bits (in its low n bits)
+ * @param n The number of bits (1 to 64)
+*/
+static inline void PutBits(GorillaEncoder *encoder, uint64_t value, int n) {
+    while (n > 0) {
+        int room = 8 - (int) (encoder->bits & 7u);
+        int take = n < room ? n : room;
+        uint32_t part = (uint32_t) (value >> (n - take)) & ((1u << take) - 1);
+        encoder->block[encoder->bits >> 3] |=
+            (uint8_t) (part << (room - take));
+        encoder->bits += take;
+        n -= take;
+    }
+}
+
+/**
+ * Reads bits from a block
+ * 
+ * @param block The block
+ * @param length The block's length (bits)
+ * @param position The next bit, which is advanced
+ * @param n The number of bits (1 to 64)
+ * @param value A return parameter, which becomes the bits
+ * 
+ * @return 0 upon success, EXIT_FAILURE past the block's end
+*/
+static inline int GetBits(const uint8_t *block,
+                          size_t length,
+                          size_t *position,
+                          int n,
+                          uint64_t *value) {
+    uint64_t bits = 0;
+    if (*position + n > length) return EXIT_FAILURE;
+    while (n > 0) {
+        int room = 8 - (int) (*position & 7u);
+        int take = n < room ? n : room;
+        uint32_t part = (block[*position >> 3] >> (room - take))
+                        & ((1u << take) - 1);
+        bits = (bits << take) | part;
+        *position += take;
+        n -= take;
+    }
+    *value = bits;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Gets the width of a type's values
+ * 
+ * @param type The MatType
+ * 
+ * @return The width (bits)
+*/
+static inline int Width(MatType type) {
+    return (int) MatTypeSize(type) * 8;
+}
+
+
+/* Gorilla Function Definitions */
+
+
+size_t GorillaBlockCapacity(MatType type, uint32_t count) {
+    size_t per_value = type == MAT_INT32 ? INT32_MAX_BITS :
+                       type == MAT_SINGLE ? SINGLE_MAX_BITS : DOUBLE_MAX_BITS;
+    return ((size_t) count * per_value + 7) / 8;
+}
+
+int GorillaInit(GorillaEncoder *encoder, MatType type,
+                uint32_t block_values) {
+    memset(encoder, 0, sizeof(GorillaEncoder));
+    encoder->type = type;
+    encoder->capacity = GorillaBlockCapacity(type, block_values);
+    encoder->block = (uint8_t *) malloc(encoder->capacity);
+    if (encoder->block == NULL) return EXIT_FAILURE;
+    // Fault in the block, which PutBits() ORs into
+    memset(encoder->block, 0, encoder->capacity);
+    GorillaReset(encoder);
+    return EXIT_SUCCESS;
+}
+
+void GorillaPut(GorillaEncoder *encoder, const void *value) {
+    int width = Width(encoder->type);
+    uint64_t bits = 0;
+
+    if (width == 64) {
+        memcpy(&bits, value, sizeof(uint64_t));
+    } else {
+        uint32_t word;
+        memcpy(&word, value, sizeof(uint32_t));
+        bits = word;
+    }
+
+    if (encoder->count++ == 0) {
+        PutBits(encoder, bits, width);
+    } else if (encoder->type == MAT_INT32) {
+        uint32_t delta = (uint32_t) bits - (uint32_t) encoder->last;
+        int32_t dod = (int32_t) (delta - encoder->delta);
+        if (dod == 0) {
+            PutBits(encoder, 0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            PutBits(encoder, 2, 2);
+            PutBits(encoder, (uint32_t) (dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            PutBits(encoder, 6, 3);
+            PutBits(encoder, (uint32_t) (dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            PutBits(encoder, 14, 4);
+            PutBits(encoder, (uint32_t) (dod + 2047), 12);
+        } else {
+            PutBits(encoder, 15, 4);
+            PutBits(encoder, (uint32_t) dod, 32);
+        }
+        encoder->delta = delta;
+    } else {
+        uint64_t x = bits ^ encoder->last;
+        if (x == 0) {
+            PutBits(encoder, 0, 1);
+        } else {
+            int leading = __builtin_clzll(x) - (64 - width);
+            int trailing = __builtin_ctzll(x);
+            if (leading > MAX_LEADING) leading = MAX_LEADING;
+            if (encoder->leading >= 0 && leading >= encoder->leading &&
+                trailing >= encoder->trailing) {
+                // Within the last window
+                PutBits(encoder, 2, 2);
+                PutBits(encoder, x >> encoder->trailing,
+                        width - encoder->leading - encoder->trailing);
+            } else {
+                int length = width - leading - trailing;
+                PutBits(encoder, 3, 2);
+                PutBits(encoder, leading, 5);
+                PutBits(encoder, length - 1, width == 64 ? 6 : 5);
+                PutBits(encoder, x >> trailing, length);
+                encoder->leading = leading;
+                encoder->trailing = trailing;
+            }
+        }
+    }
+    encoder->last = bits;
+}
+
+void GorillaReset(GorillaEncoder *encoder) {
+    memset(encoder->block, 0, GorillaLength(encoder));
+    encoder->bits = 0;
+    encoder->count = 0;
+    encoder->last = 0;
+    encoder->delta = 0;
+    encoder->leading = -1;
+    encoder->trailing = 0;
+}
+
+void GorillaFree(GorillaEncoder *encoder) {
+    free(encoder->block);
+    encoder->block = NULL;
+}
+
+int GorillaDecode(MatType type,
+                  const uint8_t *block,
+                  size_t length,
+                  uint32_t count,
+                  void *values) {
+    int width = Width(type);
+    size_t bits_len = length * 8;
+    size_t position = 0;
+    uint64_t last = 0;
+    uint64_t bits;
+    uint32_t delta = 0;
+    int leading = 0;
+    int trailing = 0;
+    uint32_t k;
+
+    for (k = 0; k < count; k++) {
+        if (k == 0) {
+            if (GetBits(block, bits_len, &position, width, &last)) {
+                return EXIT_FAILURE;
+            }
+        } else if (type == MAT_INT32) {
+            int32_t dod;
+            int ones = 0;
+            // The prefix: up to four 1s, ended by a 0
+            while (ones < 4) {
+                if (GetBits(block, bits_len, &position, 1, &bits)) {
+                    return EXIT_FAILURE;
+                }
+                if (bits == 0) break;
+                ones++;
+            }
+            if (ones == 0) {
+                dod = 0;
+            } else {
+                static const int lengths[] = {0, 7, 9, 12, 32};
+                static const int32_t biases[] = {0, 63, 255, 2047, 0};
+                if (GetBits(block, bits_len, &position, lengths[ones],
+                            &bits)) {
+                    return EXIT_FAILURE;
+                }
+                dod = (int32_t) ((uint32_t) bits - (uint32_t) biases[ones]);
+            }
+            delta += (uint32_t) dod;
+            last = (uint32_t) ((uint32_t) last + delta);
+        } else {
+            if (GetBits(block, bits_len, &position, 1, &bits)) {
+                return EXIT_FAILURE;
+            }
+            if (bits != 0) {
+                if (GetBits(block, bits_len, &position, 1, &bits)) {
+                    return EXIT_FAILURE;
+                }
+                if (bits != 0) {
+                    uint64_t field;
+                    if (GetBits(block, bits_len, &position, 5, &field)) {
+                        return EXIT_FAILURE;
+                    }
+                    leading = (int) field;
+                    if (GetBits(block, bits_len, &position,
+                                width == 64 ? 6 : 5, &field)) {
+                        return EXIT_FAILURE;
+                    }
+                    trailing = width - leading - ((int) field + 1);
+                    if (trailing < 0) return EXIT_FAILURE;
+                }
+                if (GetBits(block, bits_len, &position,
+                            width - leading - trailing, &bits)) {
+                    return EXIT_FAILURE;
+                }
+                last ^= bits << trailing;
+            }
+        }
+
+        if (width == 64) {
+            memcpy((char *) values + (size_t) k * 8, &last, 8);
+        } else {
+            uint32_t word = (uint32_t) last;
+            memcpy((char *) values + (size_t) k * 4, &word, 4);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file gorilla.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Lossless Time-Series Compression Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Compresses a column of values in blocks, as Gorilla (Pelkonen et
+ * al., VLDB 2015) does: each float is stored as its XOR with the last
+ * one (a single bit when they are equal, and only the bits that differ
+ * otherwise), and each int32 as its delta-of-delta (a single bit when
+ * it steps as it last did). Each block starts over, so it decodes on
+ * its own.
+ * 
+ * A series file (<name> with a .series extension, see
+ * RecordSetCompression()) is a GorillaHeader, then frames one after
+ * another: a GorillaFrame, then its block of length bytes (native byte
+ * order). Decode it with tools/unpack.c.
+ */
+
+#ifndef GORILLA_H_
+#define GORILLA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mat-stream.h"
+
+
+/* Series File Constants */
+
+
+/// Identifies a series file
+#define GORILLA_MAGIC "ASSERIES"
+/// The layout's version
+#define GORILLA_VERSION 1u
+/// The most columns a series file holds (32 entries and the indices)
+#define GORILLA_MAX_COLUMNS 33
+/// The longest column name (bytes, with the terminator)
+#define GORILLA_NAME_LEN 32
+
+
+/* Gorilla Data Structures */
+
+
+/**
+ * @brief A Series File's Header (at the start of its file)
+*/
+typedef struct {
+    char magic[8];  ///< GORILLA_MAGIC (without a terminator)
+    uint32_t version;  ///< GORILLA_VERSION
+    uint32_t num_columns;  ///< columns in the file
+    uint32_t block_values;  ///< the most values in each block
+    uint32_t reserved;  ///< zero
+    /// The columns' names (zero-padded)
+    char names[GORILLA_MAX_COLUMNS][GORILLA_NAME_LEN];
+    /// The columns' types (MatType)
+    uint32_t types[GORILLA_MAX_COLUMNS];
+} GorillaHeader;
+
+/**
+ * @brief A Block's Frame (before the block)
+*/
+typedef struct {
+    uint32_t column;  ///< the column's index
+    uint32_t count;  ///< the values in the block (never 0)
+    uint32_t length;  ///< the block's length (bytes)
+} GorillaFrame;
+
+/**
+ * @brief A Column's Encoder
+*/
+typedef struct {
+    MatType type;  ///< the values' type
+    uint8_t *block;  ///< the block being encoded
+    size_t capacity;  ///< the block's capacity (bytes)
+    uint32_t bits;  ///< the bits encoded into the block
+    uint32_t count;  ///< the values encoded into the block
+    uint64_t last;  ///< the last value's bits
+    uint32_t delta;  ///< the last delta (int32)
+    int leading;  ///< the last XOR's leading zeros (float, -1 if none)
+    int trailing;  ///< the last XOR's trailing zeros (float)
+} GorillaEncoder;
+
+
+/* Gorilla Functions */
+
+
+/**
+ * Gets the most bytes a block can take
+ * 
+ * @param type The values' type
+ * @param count The values in the block
+ * 
+ * @return The block's worst-case length (bytes)
+*/
+size_t GorillaBlockCapacity(MatType type, uint32_t count);
+
+/**
+ * Allocates an encoder
+ * 
+ * @param encoder The GorillaEncoder
+ * @param type The values' type
+ * @param block_values The most values in each block
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int GorillaInit(GorillaEncoder *encoder, MatType type,
+                uint32_t block_values);
+
+/**
+ * Encodes a value into the block
+ * 
+ * @param encoder The GorillaEncoder
+ * @param value The value (of the encoder's type)
+ * 
+ * @pre The block holds fewer than block_values values
+*/
+void GorillaPut(GorillaEncoder *encoder, const void *value);
+
+/**
+ * Gets the length of the block
+ * 
+ * @param encoder The GorillaEncoder
+ * 
+ * @return The block's length (bytes)
+*/
+static inline uint32_t GorillaLength(const GorillaEncoder *encoder) {
+    return (encoder->bits + 7u) / 8u;
+}
+
+/**
+ * Starts a new block
+ * 
+ * @param encoder The GorillaEncoder
+*/
+void GorillaReset(GorillaEncoder *encoder);
+
+/**
+ * Frees an encoder
+ * 
+ * @param encoder The GorillaEncoder
+*/
+void GorillaFree(GorillaEncoder *encoder);
+
+/**
+ * Decodes a block
+ * 
+ * @param type The values' type
+ * @param block The block
+ * @param length The block's length (bytes)
+ * @param count The values in the block
+ * @param values A return parameter, which becomes the values (count
+ * values of the type)
+ * 
+ * @return 0 upon success, EXIT_FAILURE if the block is too short
+*/
+int GorillaDecode(MatType type,
+                  const uint8_t *block,
+                  size_t length,
+                  uint32_t count,
+                  void *values);
+
+#endif  // GORILLA_H_
@@ -0,0 +1,270 @@
+/**
+ * @file hal-myrio.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Hardware Abstraction Layer (myRIO Backend)
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#ifndef HAL_SIM
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "MyRio.h"
+#include "AIO.h"
+#include "DIO.h"
+#include "T1.h"
+#include "conC_Encoder_initialize.h"
+
+#include "error.h"
+#include "thread-lib.h"
+
+#include "hal.h"
+
+
+/* Connector ID Convention */
+
+
+/// X Motor Encoder Connector ID (on Connector C)
+#define X_CONNECTOR_ID 0
+/// Y Motor Encoder Connector ID (on Connector C)
+#define Y_CONNECTOR_ID 1
+
+
+/* Channels */
+
+
+/// Motor Encoders (X, then Y)
+static MyRio_Encoder encoder[2];
+/// Encoder Error Mask
+static const Encoder_StatusMask enc_st_mask =
+    (Encoder_StError);
+/// Potentiometers (X, then Y)
+static MyRio_Aio potentiometer[2];
+/// Motor Voltage Channels (X, then Y)
+static MyRio_Aio motor[2];
+
+
+/* MyRio Session (thread-lib.h declares it only for the FPGA timer) */
+
+
+#ifdef HOST_TIMER
+extern NiFpga_Session myrio_session;
+#endif
+
+
+/* Timer Declaration */
+
+
+#ifndef HOST_TIMER
+/// Universal Timer
+MyRio_IrqTimer timer;
+#endif
+
+
+/* Keyboard Definitions and Variables */
+
+
+/// Number of Channels
+#define CHANNELS 16
+/// Keyboard channels (the columns, then the rows)
+static MyRio_Dio channel[CHANNELS];
+/// Keyboard lock
+static pthread_mutex_t keyboard;
+
+
+/// Local Error Flag
+static int error;
+
+
+/* Static Helper Functions */
+
+
+/**
+ * Waits for approximate 5 ms
+ * 
+ * @post About 5 ms have passed
+*/
+static inline void wait() {
+    uint32_t i;
+/// Wait Constant
+#define WAIT_CONST 417000
+
+    i = 0;
+    while (i++ < WAIT_CONST) {}
+
+    return;
+#undef WAIT_CONST
+}
+
+/**
+ * Drives one keypad column low (and the rest high)
+ * 
+ * @param column The column
+*/
+static inline void SelectColumn(uint8_t column) {
+    uint8_t j;
+    for (j = 0; j < HAL_KEYPAD_LEN; j++) {
+        Dio_WriteBit(channel + j, j == column ? NiFpga_False : NiFpga_True);
+    }
+}
+
+
+/* Backend Functions */
+
+
+static int MyRioOpen() {
+    return MyRio_IsNotSuccess(MyRio_Open()) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int MyRioClose() {
+    return MyRio_Close();
+}
+
+static int MyRioSetup() {
+    uint8_t i;
+
+#ifndef HOST_TIMER
+    /// Setup Timer
+    timer.timerWrite = IRQTIMERWRITE;
+    timer.timerSet = IRQTIMERSETTIME;
+#endif
+
+    /// Setup Encoders Channels
+    conC_Encoder_initialize(myrio_session, encoder + HAL_X, X_CONNECTOR_ID);
+    conC_Encoder_initialize(myrio_session, encoder + HAL_Y, Y_CONNECTOR_ID);
+
+    /// Setup Potentiometer Voltage Channels (are swapped)
+    Aio_InitCI1(potentiometer + HAL_X);
+    Aio_InitCI0(potentiometer + HAL_Y);
+
+    /// Setup Motor Channels
+    Aio_InitCO0(motor + HAL_X);
+    Aio_InitCO1(motor + HAL_Y);
+
+    /// Setup Keyboard Channels & Resources
+    for (i = 0; i < CHANNELS; i++) {
+        channel[i].dir = DIOB_70DIR;
+        channel[i].out = DIOB_70OUT;
+        channel[i].in = DIOB_70IN;
+        channel[i].bit = i;
+    }
+    VERIFY(error, pthread_mutex_init(&keyboard, NULL));
+
+    return EXIT_SUCCESS;
+}
+
+static int MyRioShutdown() {
+    /// Dissasociate with Encoders, Potentiometers and Motors
+    memset(encoder, 0, sizeof(encoder));
+    memset(potentiometer, 0, sizeof(potentiometer));
+    memset(motor, 0, sizeof(motor));
+
+    /// Destroy Keyboard Lock
+    VERIFY(error, pthread_mutex_destroy(&keyboard));
+
+    return EXIT_SUCCESS;
+}
+
+static void MyRioReadSensors(HalSensors *sensors) {
+    uint8_t i;
+
+    /// The counters first, back to back, then the rest
+    sensors->encoder[HAL_X] = (int32_t) Encoder_Counter(encoder + HAL_X);
+    sensors->encoder[HAL_Y] = (int32_t) Encoder_Counter(encoder + HAL_Y);
+    sensors->potentiometer[HAL_X] = Aio_Read(potentiometer + HAL_X);
+    sensors->potentiometer[HAL_Y] = Aio_Read(potentiometer + HAL_Y);
+    for (i = HAL_X; i <= HAL_Y; i++) {
+        sensors->encoder_fault[i] =
+            (Encoder_Status(encoder + i) & enc_st_mask) != 0;
+        if (!sensors->encoder_fault[i]) continue;
+
+        /// conC_Encoder_initialize(myrio_session, encoder + i, ...);
+        Encoder_Configure(encoder + i,
+                          Encoder_Error | Encoder_Enable |
+                          Encoder_SignalMode,
+                          Encoder_ClearError | Encoder_Enabled |
+                          Encoder_QuadPhase);
+    }
+}
+
+static void MyRioReadPotentiometers(double voltage[2]) {
+    voltage[HAL_X] = Aio_Read(potentiometer + HAL_X);
+    voltage[HAL_Y] = Aio_Read(potentiometer + HAL_Y);
+}
+
+static void MyRioWriteMotors(double x_voltage, double y_voltage) {
+    Aio_Write(motor + HAL_X, x_voltage);
+    Aio_Write(motor + HAL_Y, y_voltage);
+}
+
+static uint16_t MyRioScanKeypad(uint16_t columns) {
+    uint16_t keys = 0;
+    uint8_t i, j;
+
+    pthread_mutex_lock(&keyboard);
+    for (i = 0; i < HAL_KEYPAD_LEN; i++) {
+        if (!(columns & (1u << i))) continue;
+        SelectColumn(i);
+        for (j = 0; j < HAL_KEYPAD_LEN; j++) {
+            if (!Dio_ReadBit(channel + HAL_KEYPAD_LEN + j)) {
+                keys |= HAL_KEY_BIT(j, i);
+            }
+        }
+    }
+    pthread_mutex_unlock(&keyboard);
+    return keys;
+}
+
+static char MyRioGetKey() {
+    uint8_t i, j;
+
+    /// Keypad characters
+    static char keypad[HAL_KEYPAD_LEN][HAL_KEYPAD_LEN] = HAL_KEYPAD;
+    /// Locking style allows for getkey() to take precedence
+    /// over all other keyboard commands
+    pthread_mutex_lock(&keyboard);
+    while (NiFpga_True) {
+        for (i = 0; i < HAL_KEYPAD_LEN; i++) {
+            SelectColumn(i);
+            for (j = HAL_KEYPAD_LEN; j < 2 * HAL_KEYPAD_LEN; j++) {
+                if (!Dio_ReadBit(channel + j)) {
+                    while (!Dio_ReadBit(channel + j)) {}
+                    pthread_mutex_unlock(&keyboard);
+                    return keypad[j - HAL_KEYPAD_LEN][i];
+                }
+            }
+            wait();
+        }
+    }
+    pthread_mutex_unlock(&keyboard);
+    return '\0';
+}
+
+
+/* Backend Definition */
+
+
+/// The myRIO's Function Table
+static const Hal myrio_hal = {"myRIO",
+                              MyRioOpen,
+                              MyRioClose,
+                              MyRioSetup,
+                              MyRioShutdown,
+                              MyRioReadSensors,
+                              MyRioReadPotentiometers,
+                              MyRioWriteMotors,
+                              MyRioScanKeypad,
+                              MyRioGetKey};
+
+const Hal *hal = &myrio_hal;
+
+#endif  // HAL_SIM
@@ -0,0 +1,553 @@
+/**
+ * @file hal-sim.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Hardware Abstraction Layer (Simulated Plant Backend)
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Each axis is a trolley (of mass m_dt for X, which carries the Y
+ * trolley, and m_st for Y) driven by its motor's force
+ * (VOLTAGE_TO_FORCE()) against viscous friction, with a point mass m_p
+ * hanging from it by a rope of length l (angle from vertical, positive
+ * toward the trolley's positive direction):
+ * 
+ *   x'' = (F - b x' + m_p l w^2 sin(a) + m_p g sin(a) cos(a))
+ *         / (M + m_p sin(a)^2)
+ *   a'' = -(x'' cos(a) + g sin(a)) / l
+ * 
+ * It is integrated (RK4) in SIM_SUBSTEPS steps per base tick, up to
+ * the model's time (the host's clock since Open(), HOST_TIME_SCALE
+ * times faster), whenever the backend is called; motor voltages are
+ * held between writes. The encoders read whole counts, and the
+ * potentiometers and motors are 12-bit over +/-10 V, as the myRIO's.
+ * 
+ * Keys are read from stdin: each is held for SIM_KEY_NS of the model's
+ * time, once the last has been released (or taken by getkey()). A
+ * newline is ENT, a backspace is DEL, and a space holds nothing. So
+ * that a script can be piped in, e.g.
+ * 
+ *   (echo; echo 2; printf '6    x'; echo 4) | anti-sway-sim
+ * 
+ * calibrates, runs anti-sway, moves +X for a key's time, waits four
+ * keys' time, and leaves (the program exits when the keys run out).
+ * 
+ * With the virtual clock (-DVIRTUAL_TIMER, see dispatcher.h), the model
+ * advances a base tick at a time, in lockstep with the tasks, and the
+ * whole of stdin is read at Open() as a script (typed at time 0), so
+ * that each run of a script gives the same results. The main thread's
+ * keypad scans (PressedDelete()) and waits for keys each take a tick.
+ */
+
+#ifdef HAL_SIM
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "thread-lib.h"
+#include "dispatcher.h"
+#include "io.h"
+
+#include "hal.h"
+
+
+/* Simulator Constants */
+
+
+/// Model steps per base tick
+#define SIM_SUBSTEPS 10
+/// Model step (ns)
+#define SIM_STEP_NS (BTI_US * 1000u / SIM_SUBSTEPS)
+/// Trolley Viscous Friction (N s/m), as simulation_parameters.txt's b1
+#define SIM_FRICTION 3.0
+/// Analog Full Scale (V, either way)
+#define SIM_AIO_RANGE 10.0
+/// Analog Resolution (V): 12 bits over the full scale
+#define SIM_AIO_LSB (2.0 * SIM_AIO_RANGE / 4096.0)
+/// Potentiometer Voltage with the rope hanging straight down (V)
+#define SIM_POT_REST 0.8
+/// How long each key is held (ns of the model's time)
+#define SIM_KEY_NS 500000000u
+/// Most keys waiting to be pressed
+#define SIM_KEYS_LEN 4096
+/// A pause (holds nothing, typed as a space)
+#define SIM_PAUSE '\0'
+
+
+/* Simulator Data Structures */
+
+
+/**
+ * @brief An Axis's State
+*/
+typedef struct {
+    double mass;  ///< the trolley's mass (kg)
+    double state[4];  ///< position (m), velocity, angle (rad), rate
+    double voltage;  ///< the motor's voltage (V), held between writes
+} SimAxis;
+
+/**
+ * @brief A Key, waiting to be pressed
+*/
+typedef struct {
+    char key;  ///< the key (or SIM_PAUSE)
+    uint64_t arrival_ns;  ///< when it was typed (model's time)
+} SimKey;
+
+
+/* Simulator State */
+
+
+/// Guards the model and the keys
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+/// The Axes (X, then Y)
+static SimAxis axes[2];
+/// The host's clock at Open() (ns)
+static uint64_t start_ns;
+/// The model's time (ns)
+static uint64_t model_ns;
+/// The keys typed, waiting to be pressed (a ring)
+static SimKey keys[SIM_KEYS_LEN];
+/// The next key's index in keys
+static uint32_t key_head;
+/// The number of keys waiting
+static uint32_t key_count;
+/// Whether the next key's press and release are known
+static bool key_timed;
+/// When the next key is pressed (model's time, ns)
+static uint64_t key_press_ns;
+/// When the next key is released (model's time, ns)
+static uint64_t key_release_ns;
+/// When the last key was released (model's time, ns)
+static uint64_t last_release_ns;
+/// Whether stdin has ended
+static bool keys_ended;
+#ifndef VIRTUAL_TIMER
+/// Reads the keys from stdin
+static pthread_t key_thread;
+#endif
+
+
+/* Model Functions */
+
+
+/**
+ * Gets the model's time from the host's clock
+ * 
+ * @return The model's time (ns)
+*/
+static inline uint64_t Now() {
+    return (ThreadClockNs() - start_ns) * HOST_TIME_SCALE;
+}
+
+/**
+ * Differentiates an axis's state
+ * 
+ * @param axis The SimAxis (for its mass and voltage)
+ * @param state The state
+ * @param rate A return parameter, which becomes the state's derivative
+*/
+static void Derivative(const SimAxis *axis,
+                       const double state[4],
+                       double rate[4]) {
+    double sin_a = sin(state[2]);
+    double cos_a = cos(state[2]);
+    double accel = (VOLTAGE_TO_FORCE(axis->voltage)
+                    - SIM_FRICTION * state[1]
+                    + m_p * l * state[3] * state[3] * sin_a
+                    + m_p * g * sin_a * cos_a)
+                   / (axis->mass + m_p * sin_a * sin_a);
+
+    rate[0] = state[1];
+    rate[1] = accel;
+    rate[2] = state[3];
+    rate[3] = -(accel * cos_a + g * sin_a) / l;
+}
+
+/**
+ * Advances an axis by one model step (RK4)
+ * 
+ * @param axis The SimAxis
+*/
+static void Step(SimAxis *axis) {
+    const double h = SIM_STEP_NS * 1e-9;
+    double k[4][4];
+    double temp[4];
+    int i;
+
+    Derivative(axis, axis->state, k[0]);
+    for (i = 0; i < 4; i++) temp[i] = axis->state[i] + h / 2 * k[0][i];
+    Derivative(axis, temp, k[1]);
+    for (i = 0; i < 4; i++) temp[i] = axis->state[i] + h / 2 * k[1][i];
+    Derivative(axis, temp, k[2]);
+    for (i = 0; i < 4; i++) temp[i] = axis->state[i] + h * k[2][i];
+    Derivative(axis, temp, k[3]);
+    for (i = 0; i < 4; i++) {
+        axis->state[i] += h / 6 * (k[0][i] + 2 * k[1][i] + 2 * k[2][i]
+                                   + k[3][i]);
+    }
+}
+
+/**
+ * Quantizes a voltage as the myRIO's analog channels do
+ * 
+ * @param voltage The voltage (V)
+ * 
+ * @return The voltage, clipped to the full scale and rounded to the
+ * resolution
+*/
+static inline double Quantize(double voltage) {
+    if (voltage > SIM_AIO_RANGE - SIM_AIO_LSB) {
+        voltage = SIM_AIO_RANGE - SIM_AIO_LSB;
+    }
+    if (voltage < -SIM_AIO_RANGE) voltage = -SIM_AIO_RANGE;
+    return round(voltage / SIM_AIO_LSB) * SIM_AIO_LSB;
+}
+
+/**
+ * Reads an axis's potentiometer
+ * 
+ * @param axis The SimAxis
+ * 
+ * @return The (quantized) voltage
+*/
+static inline double PotentiometerVoltage(const SimAxis *axis) {
+    return Quantize(SIM_POT_REST + axis->state[2] / POTENTIOMETER_SLOPE);
+}
+
+
+/* Key Functions */
+
+
+/**
+ * Removes the next key
+ * 
+ * @param release_ns When it was released (model's time, ns)
+*/
+static inline void PopKey(uint64_t release_ns) {
+    key_head = (key_head + 1) % SIM_KEYS_LEN;
+    key_count--;
+    key_timed = false;
+    last_release_ns = release_ns;
+}
+
+/**
+ * Releases the keys whose time is up
+*/
+static void KeyHelper() {
+    while (key_count > 0) {
+        if (!key_timed) {
+            uint64_t arrival_ns = keys[key_head].arrival_ns;
+            key_press_ns = arrival_ns > last_release_ns ?
+                           arrival_ns : last_release_ns;
+            key_release_ns = key_press_ns + SIM_KEY_NS;
+            key_timed = true;
+        }
+        if (key_release_ns > model_ns) break;
+        PopKey(key_release_ns);
+    }
+}
+
+/**
+ * Brings the model (and the keys) up to the model's time
+ * 
+ * @pre sim_lock is held
+*/
+static void Advance() {
+    uint64_t now = Now();
+    while (model_ns + SIM_STEP_NS <= now) {
+        Step(axes + HAL_X);
+        Step(axes + HAL_Y);
+        model_ns += SIM_STEP_NS;
+    }
+    KeyHelper();
+}
+
+/**
+ * Gets the key being held
+ * 
+ * @return The key, or SIM_PAUSE if none is
+ * 
+ * @pre sim_lock is held, and Advance() has been called
+*/
+static inline char Held() {
+    if (key_count == 0 || key_press_ns > model_ns) return SIM_PAUSE;
+    return keys[key_head].key;
+}
+
+/**
+ * Queues a character typed on stdin as a key
+ * 
+ * @param c The character
+ * @param arrival_ns When it was typed (model's time, ns)
+ * 
+ * @pre sim_lock is held
+*/
+static void TypeKey(int c, uint64_t arrival_ns) {
+    SimKey *next = keys + (key_head + key_count) % SIM_KEYS_LEN;
+
+    if (key_count == SIM_KEYS_LEN) return;
+    if (c == '\n' || c == '\r') {
+        next->key = ENT;
+    } else if (c == '\b' || c == 0x7f) {
+        next->key = DEL;
+    } else if (c == ' ') {
+        next->key = SIM_PAUSE;
+    } else if (c != '\0' && strchr("0123456789.-udex", c) != NULL) {
+        next->key = (char) c;
+    } else {
+        return;
+    }
+    next->arrival_ns = arrival_ns;
+    key_count++;
+}
+
+#ifndef VIRTUAL_TIMER
+/**
+ * Reads keys from stdin until it ends
+ * 
+ * @param unused Unused
+ * 
+ * @return NULL
+*/
+static void *KeyThread(void *unused) {
+    int c;
+
+    while ((c = getchar()) != EOF) {
+        pthread_mutex_lock(&sim_lock);
+        TypeKey(c, Now());
+        pthread_mutex_unlock(&sim_lock);
+    }
+    pthread_mutex_lock(&sim_lock);
+    keys_ended = true;
+    pthread_mutex_unlock(&sim_lock);
+    return NULL;
+}
+#endif
+
+
+/* Backend Functions */
+
+
+static int SimOpen() {
+#ifdef VIRTUAL_TIMER
+    int c;
+#endif
+
+    pthread_mutex_lock(&sim_lock);
+    memset(axes, 0, sizeof(axes));
+    axes[HAL_X].mass = m_dt;
+    axes[HAL_Y].mass = m_st;
+    start_ns = ThreadClockNs();
+    model_ns = 0;
+    key_head = 0;
+    key_count = 0;
+    key_timed = false;
+    last_release_ns = 0;
+    keys_ended = false;
+    pthread_mutex_unlock(&sim_lock);
+
+#ifdef VIRTUAL_TIMER
+    // The whole script, before anything runs
+    pthread_mutex_lock(&sim_lock);
+    while ((c = getchar()) != EOF) TypeKey(c, 0);
+    keys_ended = true;
+    pthread_mutex_unlock(&sim_lock);
+    printf("Simulated plant, on the virtual clock\n");
+#else
+    if (pthread_create(&key_thread, NULL, KeyThread, NULL)) {
+        return EXIT_FAILURE;
+    }
+    pthread_detach(key_thread);
+    printf("Simulated plant, %u times faster than real time\n",
+           (unsigned) HOST_TIME_SCALE);
+#endif
+    return EXIT_SUCCESS;
+}
+
+static int SimClose() {
+    return EXIT_SUCCESS;
+}
+
+static int SimSetup() {
+    pthread_mutex_lock(&sim_lock);
+    Advance();
+    axes[HAL_X].voltage = 0.0;
+    axes[HAL_Y].voltage = 0.0;
+    pthread_mutex_unlock(&sim_lock);
+    return EXIT_SUCCESS;
+}
+
+static int SimShutdown() {
+    return SimSetup();
+}
+
+static void SimReadSensors(HalSensors *sensors) {
+    uint8_t i;
+
+    // Both axes at the same instant
+    pthread_mutex_lock(&sim_lock);
+    Advance();
+    for (i = HAL_X; i <= HAL_Y; i++) {
+        sensors->encoder[i] =
+            (int32_t) floor(axes[i].state[0] / M_PER_REV * ENC_CNT_REV);
+        sensors->encoder_fault[i] = false;
+        sensors->potentiometer[i] = PotentiometerVoltage(axes + i);
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void SimReadPotentiometers(double voltage[2]) {
+    uint8_t i;
+
+    pthread_mutex_lock(&sim_lock);
+    Advance();
+    for (i = HAL_X; i <= HAL_Y; i++) {
+        voltage[i] = PotentiometerVoltage(axes + i);
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void SimWriteMotors(double x_voltage, double y_voltage) {
+    pthread_mutex_lock(&sim_lock);
+    Advance();
+    axes[HAL_X].voltage = Quantize(x_voltage);
+    axes[HAL_Y].voltage = Quantize(y_voltage);
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static uint16_t SimScanKeypad(uint16_t columns) {
+    static const char keypad[HAL_KEYPAD_LEN][HAL_KEYPAD_LEN] = HAL_KEYPAD;
+    uint16_t pressed = 0;
+    char key;
+    uint8_t i, j;
+
+    // (the main thread's scans each wait a tick, with the virtual clock)
+    DispatcherYield();
+    pthread_mutex_lock(&sim_lock);
+    Advance();
+    key = Held();
+    pthread_mutex_unlock(&sim_lock);
+    if (key == SIM_PAUSE) return 0;
+
+    for (i = 0; i < HAL_KEYPAD_LEN; i++) {
+        for (j = 0; j < HAL_KEYPAD_LEN; j++) {
+            if (keypad[i][j] == key && (columns & (1u << j))) {
+                pressed |= HAL_KEY_BIT(i, j);
+            }
+        }
+    }
+    return pressed;
+}
+
+static char SimGetKey() {
+    char key;
+
+    while (true) {
+        pthread_mutex_lock(&sim_lock);
+        Advance();
+        if ((key = Held()) != SIM_PAUSE) {
+            PopKey(model_ns);
+            pthread_mutex_unlock(&sim_lock);
+            return key;
+        }
+        if (key_count == 0 && keys_ended) {
+            pthread_mutex_unlock(&sim_lock);
+            printf("\nSimulated keypad: no more keys\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_mutex_unlock(&sim_lock);
+        // Let time pass (a tick, with the virtual clock)
+        DispatcherYield();
+#ifndef VIRTUAL_TIMER
+        usleep(1000);
+#endif
+    }
+}
+
+
+/* T1 Library Stand-Ins */
+
+
+int printf_lcd(const char *format, ...) {
+    char text[256];
+    char *c;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    // Each screen starts on a new line, with the model's time
+    for (c = text; *c != '\0'; c++) {
+        if (*c == '\f') {
+            pthread_mutex_lock(&sim_lock);
+            Advance();
+            printf("\n[%.3f s]\n", model_ns * 1e-9);
+            pthread_mutex_unlock(&sim_lock);
+        } else {
+            putchar(*c);
+        }
+    }
+    fflush(stdout);
+    return length;
+}
+
+int getchar_keypad() {
+    /// The line typed (with its '\n')
+    static char line[40];
+    /// The line's length
+    static int length;
+    /// The next character to get
+    static int next;
+    char key;
+
+    if (next == length) {
+        length = 0;
+        next = 0;
+        while ((key = getkey()) != ENT) {
+            if (key == DEL) {
+                if (length > 0) length--;
+            } else if (('0' <= key && key <= '9') || key == '.' ||
+                       key == '-') {
+                if (length < (int) sizeof(line) - 1) {
+                    line[length++] = key;
+                    printf_lcd("%c", key);
+                }
+            }
+        }
+        line[length++] = '\n';
+    }
+    return line[next++];
+}
+
+
+/* Backend Definition */
+
+
+/// The Simulated Plant's Function Table
+static const Hal sim_hal = {"simulated plant",
+                            SimOpen,
+                            SimClose,
+                            SimSetup,
+                            SimShutdown,
+                            SimReadSensors,
+                            SimReadPotentiometers,
+                            SimWriteMotors,
+                            SimScanKeypad,
+                            SimGetKey};
+
+const Hal *hal = &sim_hal;
+
+#endif  // HAL_SIM
@@ -0,0 +1,179 @@
+/**
+ * @file hal.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Hardware Abstraction Layer Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * io.c reaches the hardware only through the function table hal points
+ * to, which one backend provides. Every sensor is read at once (each
+ * register once, see HalSensors), and both motors are written at once,
+ * so that each control cycle sees X and Y at the same instant:
+ * 
+ * hal-myrio.c (by default): the myRIO's FPGA (encoders on Connector C,
+ * potentiometers and motors on its analog channels, and the keypad on
+ * its digital channels), and the T1 library's LCD.
+ * 
+ * hal-sim.c (built with -DHAL_SIM -DHOST_TIMER, make sim): a
+ * cart-pendulum model of each axis (see thread-lib.h's physical
+ * constants), read through quantized encoders and potentiometers, with
+ * keys from stdin and the LCD on stdout. It runs on a Linux host, so
+ * that the unmodified state machine (SystemExec()) can be run against
+ * it, HOST_TIME_SCALE times faster than real time.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef HAL_SIM
+#ifndef HOST_TIMER
+#error "The simulated plant (HAL_SIM) needs the host timer (HOST_TIMER)"
+#endif
+#include <stdio.h>
+#else
+#include "T1.h"
+#endif
+
+
+/* Sensor Constants */
+
+
+/// Best-Fit Potentiometer Slope (rad/V)
+/// TODO(nguy8tri): Find this quantity
+#define POTENTIOMETER_SLOPE (-2.11 * PI / 180.0)
+/// Number of counts in one revolution
+/// TODO(nguy8tri): Find this quantity
+#define ENC_CNT_REV 2000.0
+/// Meters per revolution
+/// Diameter of upper pulley (12 mm) * PI
+#define M_PER_REV (0.01267 * PI)
+
+
+/* Keypad Layout */
+
+
+#ifdef HAL_SIM
+/// Up Key (as T1.h defines it)
+#define UP 'u'
+/// Down Key (as T1.h defines it)
+#define DN 'd'
+/// Enter Key (as T1.h defines it)
+#define ENT 'e'
+/// Delete Key (as T1.h defines it)
+#define DEL 'x'
+#endif
+
+/// Keypad Rows and Columns
+#define HAL_KEYPAD_LEN 4
+/// The keypad's keys, by row, then column
+#define HAL_KEYPAD {{'1', '2', '3', UP}, \
+                    {'4', '5', '6', DN}, \
+                    {'7', '8', '9', ENT}, \
+                    {'0', '.', '-', DEL}}
+/**
+ * A key's bit in the keys a keypad scan finds pressed
+ * 
+ * @param row The key's row
+ * @param column The key's column
+*/
+#define HAL_KEY_BIT(row, column) \
+    (1u << ((row) * HAL_KEYPAD_LEN + (column)))
+
+
+/* HAL Data Structures */
+
+
+/**
+ * @brief An Axis (which an encoder, potentiometer and motor serve)
+*/
+typedef enum {
+    HAL_X = 0,  ///< X Axis
+    HAL_Y = 1   ///< Y Axis
+} HalAxis;
+
+/**
+ * @brief Every Sensor, Read Together (by axis, see HalAxis)
+*/
+typedef struct {
+    /// Encoder counts
+    int32_t encoder[2];
+    /// Whether each encoder had an error (which the read clears)
+    bool encoder_fault[2];
+    /// Potentiometer voltages (V)
+    double potentiometer[2];
+} HalSensors;
+
+/**
+ * @brief A Backend's Function Table
+ * 
+ * Only io.c (and setup.c, for open and close) calls these
+*/
+typedef struct {
+    /// The backend's name
+    const char *name;
+    /// Opens the hardware (0 upon success)
+    int (*open)();
+    /// Closes the hardware (0 upon success)
+    int (*close)();
+    /// Sets up every channel (0 upon success)
+    int (*setup)();
+    /// Releases every channel (0 upon success)
+    int (*shutdown)();
+    /// Reads every sensor, each once, in one pass
+    void (*read_sensors)(HalSensors *sensors);
+    /// Reads only the potentiometers' voltages (V, by axis), for
+    /// oversampling them (from a thread of its own)
+    void (*read_potentiometers)(double voltage[2]);
+    /// Sets both motors' voltages (V), in one pass
+    void (*write_motors)(double x_voltage, double y_voltage);
+    /// Scans the keypad's columns in a mask (bit j for column j), and
+    /// gets the keys pressed in them (see HAL_KEY_BIT())
+    uint16_t (*scan_keypad)(uint16_t columns);
+    /// Waits for a key to be pressed (and released), and gets it
+    char (*get_key)();
+} Hal;
+
+
+/* HAL Backend */
+
+
+/// The backend in use (hal-myrio.c's, or hal-sim.c's with HAL_SIM)
+extern const Hal *hal;
+
+
+/* T1 Library Stand-Ins (the simulated LCD and keypad) */
+
+
+#ifdef HAL_SIM
+/**
+ * Prints to the LCD (stdout, where \\f starts a new screen)
+ * 
+ * @param format The format, as printf()'s
+ * 
+ * @return The number of characters printed
+*/
+int printf_lcd(const char *format, ...);
+
+/**
+ * Gets the next character of a line typed on the keypad (echoed on the
+ * LCD, and ended by ENT, as '\\n')
+ * 
+ * @return The character
+*/
+int getchar_keypad();
+
+/**
+ * Waits for a key to be pressed (and released), and gets it
+ * 
+ * @return The key
+*/
+char getkey();
+#endif
+
+#endif  // HAL_H_
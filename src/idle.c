@@ -16,12 +16,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#include "T1.h"
-
 #include "setup.h"
 #include "io.h"
 #include "thread-lib.h"
 #include "discrete-lib.h"
+#include "hal.h"
 
 
 #include "idle.h"
@@ -33,18 +32,36 @@
 /// Thread ID
 pthread_t idle_thread;
 /// Thread Resources (Shared Resources)
-ThreadResource resource;
+static ThreadResource resource;
+/// Display Thread ID
+static pthread_t display_thread;
+/// Display Thread Resources
+static ThreadResource display_resource;
 /// Local Error Code
 static int error;
 
 
+/* Shared Readings (Idle Thread -> Display Thread) */
+
+
+/// Latest trolley position
+static Positions trolley_pos;
+/// Latest trolley velocity
+static Velocities trolley_vel;
+/// Latest rope angle
+static Angles rope_ang;
+/// Guards the latest readings
+static pthread_mutex_t readings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
 /* Thread Function */
 
 
 /**
  * @brief Idle Mode Thread Function
  * 
- * The Thread Function for Idle Mode
+ * The Thread Function for Idle Mode, which samples the
+ * sensors at the control rate
  * 
  * @param resource A pointer to a Resource sturcture
  * for Idle Mode
@@ -53,20 +70,39 @@ static int error;
 */
 static void *IdleModeThread(void *resource);
 
+/**
+ * @brief Idle Mode Display Thread Function
+ * 
+ * Prints the latest readings to the LCD, at the
+ * (much lower) display rate
+ * 
+ * @param resource A pointer to a Resource sturcture
+ * for the display
+ * 
+ * @return NULL
+*/
+static void *IdleDisplayThread(void *resource);
+
 
 /* Tracking Mode Function Definitions */
 
 
 int IdleFork() {
 	printf("Starting Idle Mode\n");
-    REGISTER_TIMER(resource);
+    REGISTER_TASK(resource, CONTROL_PERIOD, CONTROL_PHASE,
+                  CONTROL_PRIORITY, CONTROL_CPU);
+    REGISTER_TASK(display_resource, DISPLAY_PERIOD, DISPLAY_PHASE,
+                  DISPLAY_PRIORITY, DISPLAY_CPU);
     START_THREAD(idle_thread, IdleModeThread, resource);
+    START_THREAD(display_thread, IdleDisplayThread, display_resource);
     return EXIT_SUCCESS;
 }
 
 int IdleJoin() {
+    STOP_THREAD(display_thread, display_resource);
     STOP_THREAD(idle_thread, resource);
-    UNREGISTER_TIMER(resource);
+    UNREGISTER_TASK(display_resource);
+    UNREGISTER_TASK(resource);
     return EXIT_SUCCESS;
 }
 
@@ -78,29 +114,45 @@ static void *IdleModeThread(void *resource) {
 
     while (thread_resource->irq_thread_rdy) {
         uint32_t irq_assert = 0;
-        TIMER_TRIGGER(irq_assert, thread_resource);
-        static Positions trolley_pos;
-        static Velocities trolley_vel;
-        static Angles rope_ang;
-        t += BTI_S;
+        TASK_TRIGGER(irq_assert, thread_resource);
+        SensorSnapshot sensors;
         if (irq_assert) {
-            // Do the loop for both motors
-
-            // Get trolley info
+            t += BTI_S;
 
-            if (GetTrolleyPosition(&trolley_pos)) {
-            	printf("Trolley Pos not okay\n");
+            // Get trolley info (and the rope angle)
+            if (ReadSensorSnapshot(&sensors)) {
+            	printf("Trolley/Rope not okay\n");
             	EXIT_THREAD();
             }
 
-            if (GetTrolleyVelocity(&trolley_vel)) {
-            	printf("Trolley Vel not okay\n");
-            	EXIT_THREAD();
-            }
+            // Hand the trolley info to the display
+            pthread_mutex_lock(&readings_lock);
+            trolley_pos = sensors.pos;
+            trolley_vel = sensors.vel;
+            rope_ang = sensors.angle;
+            pthread_mutex_unlock(&readings_lock);
+        }
+    }
 
-            if (GetAngle(&rope_ang)) {
-            	EXIT_THREAD();
-            }
+    printf("Time: %f s", t);
+    EXIT_THREAD();
+}
+
+static void *IdleDisplayThread(void *resource) {
+    ThreadResource *thread_resource = (ThreadResource *) resource;
+
+    while (thread_resource->irq_thread_rdy) {
+        uint32_t irq_assert = 0;
+        TASK_TRIGGER(irq_assert, thread_resource);
+        Positions pos;
+        Velocities vel;
+        Angles ang;
+        if (irq_assert) {
+            pthread_mutex_lock(&readings_lock);
+            pos = trolley_pos;
+            vel = trolley_vel;
+            ang = rope_ang;
+            pthread_mutex_unlock(&readings_lock);
 
             // Output the trolley info
 /// How many decimal places to include
@@ -114,17 +166,14 @@ static void *IdleModeThread(void *resource) {
                                             DECIMAL_PRECISION "f) m/s"
                     "A:(%." DECIMAL_PRECISION "f, %."
                                     DECIMAL_PRECISION "f) deg\n\n",
-                    trolley_pos.x_pos, trolley_pos.y_pos,
-                    trolley_vel.x_vel, trolley_vel.y_vel,
-                    RAD_2_DEG(rope_ang.x_angle),
-                    RAD_2_DEG(rope_ang.y_angle));
+                    pos.x_pos, pos.y_pos,
+                    vel.x_vel, vel.y_vel,
+                    RAD_2_DEG(ang.x_angle),
+                    RAD_2_DEG(ang.y_angle));
 #undef DECIMAL_PRECISION
 #undef RAD_2_DEG
-
-            Irq_Acknowledge(irq_assert);
         }
     }
 
-    printf("Time: %f s", t);
     EXIT_THREAD();
 }
@@ -11,21 +11,20 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
 #include <pthread.h>
-#include <math.h>
 
-#include "MyRio.h"
-#include "DIO.h"
-#include "T1.h"
-#include "conC_Encoder_initialize.h"
 #include "discrete-lib.h"
 
 #include "error.h"
 #include "thread-lib.h"
+#include "hal.h"
 
 #include "io.h"
 
@@ -36,29 +35,14 @@
 static bool reset;
 
 
-/* Connector ID Convention */
-
-/// X Motor Encoder Connector ID (on Connector C)
-#define X_CONNECTOR_ID 0
-/// Y Motor Encoder Connector ID (on Connector C)
-#define Y_CONNECTOR_ID 1
-
-
 /* Potentiometers */
 
-/// Best-Fit Potentiometer Slope (rad/V)
-/// TODO(nguy8tri): Find this quantity
-#define POTENTIOMETER_SLOPE -2.11 * PI / 180.0
 /// Calibrated Voltage Intercept (x-intercept)
 /// for X Potentiometer
 static float potentiometer_v_x_intercept;
 /// Calibrated Voltage Intercept (x-intercept)
 /// for Y Potentiometer
 static float potentiometer_v_y_intercept;
-/// X Potentiometer
-static MyRio_Aio x_potentiometer;
-/// Y Potentiometer
-static MyRio_Aio y_potentiometer;
 
 
 /* Potentiometer Saturation Bounds */
@@ -70,42 +54,46 @@ static MyRio_Aio y_potentiometer;
 #define POT_V_LIM_HI 20.0
 
 
+/* Potentiometer Front-End */
+
+
+/// Potentiometer samples per BTI (the decimation factor)
+#define POT_DECIMATION (BTI_US / POT_SAMPLE_US)
+#ifdef HOST_TIMER
+/// Potentiometer sampling period of the host's clock (ns)
+#define POT_SAMPLE_NS (POT_SAMPLE_US * 1000u / HOST_TIME_SCALE)
+#else
+/// Potentiometer sampling period (ns)
+#define POT_SAMPLE_NS (POT_SAMPLE_US * 1000u)
+#endif
+
+/// The potentiometers' decimating filter (X, then Y)
+static Decimator pot_filter;
+#ifndef VIRTUAL_TIMER
+/// Potentiometer Sampler Thread
+static pthread_t sampler_thread;
+/// Potentiometer Sampler Thread Attributes
+static ThreadAttributes sampler_attributes = {SAMPLER_PRIORITY,
+                                              SAMPLER_CPU, 0, NULL};
+/// Whether the potentiometer sampler is running
+static bool sampler_running = false;
+#endif
+
+
 /* Encoders and Encoder Constants */
 
 
-/// X Motor Encoder
-static MyRio_Encoder x_encoder;
-/// Y Motor Encoder
-static MyRio_Encoder y_encoder;
 /// First Encoder state for both the
 /// X and Y Encoders
 static int32_t first_enc_state[2];
-/// Previous Encoder state (from the last time
-/// either GetTrolleyPosition or GetTrolleyVelocity
-/// is caled), for both the X and Y Encoders
-static int32_t prev_enc_state[2];
-/// Indicator if the holding for velocity is set
-static bool holding_vel_set;
-/// Indicator if the holding for position is set
-static bool holding_pos_set;
-/// Encoder Holding for velocity
-static Velocities holding_vel;
-/// Encoder Holding for position
-static Positions holding_pos;
-/// Encoder Error Mask
-static const Encoder_StatusMask enc_st_mask =
-    (Encoder_StError);
+/// Velocity Estimators, for both the X and
+/// Y Encoders (see VelocityEstimator)
+static VelocityEstimator velocity[2];
 
 
 /* Encoder Interpretation Macros */
 
 
-/// Number of counts in one revolution
-/// TODO(nguy8tri): Find this quantity
-#define ENC_CNT_REV 2000.0
-/// Meters per revolution
-/// Diameter of upper pulley (12 mm) * PI
-#define M_PER_REV 0.01267 * PI
 /**
  * Converts a BDI quantity to meters
  * 
@@ -113,13 +101,16 @@ static const Encoder_StatusMask enc_st_mask =
 */
 #define ENC_2_POS(value) \
     (value) / ENC_CNT_REV * M_PER_REV
-/**
- * Converts a BDI/BTI quantity to meters per second
- * 
- * @param value The value to convert
-*/
-#define ENC_2_VEL(value) \
-    (value) / (BTI_S * ENC_CNT_REV) * M_PER_REV
+
+
+/* Velocity Estimation Constants */
+
+
+/// Tracking loop bandwidth (rad/s)
+#define VEL_PLL_BANDWIDTH (2 * PI * 10.0)
+/// The counts (over VEL_WINDOW_MAX BTIs) under which
+/// the tracking loop is used (bench/velocity.c)
+#define VEL_PLL_COUNTS 2
 
 
 /* Encoder Limits */
@@ -137,35 +128,6 @@ static const Encoder_StatusMask enc_st_mask =
 #define VEL_LIM_ABS 1.0
 
 
-/* Motors and Motor Constants */
-
-
-/// X Motor Voltage Channel
-MyRio_Aio x_motor;
-/// Y Motor Voltage Channel
-MyRio_Aio y_motor;
-
-
-
-/* Timer Declaration */
-
-/// Universal Timer
-MyRio_IrqTimer timer;
-
-
-/* Keyboard Definitions and Variables */
-
-
-/// Number of Channels
-#define CHANNELS 16
-/// Keypad Length
-#define LCD_KEYPAD_LEN 4
-/// Keyboard channels
-static MyRio_Dio channel[CHANNELS];
-/// Keyboard lock
-static pthread_mutex_t keyboard;
-
-
 /* Keymap Thread Data Structures */
 
 
@@ -204,7 +166,7 @@ static int error;
 
 /**
  * Obtains the numerical buttons pressed
- * (1 through 9)
+ * (1 through 9), every KEYPAD_PERIOD base ticks
  * 
  * @return NULL
  * 
@@ -214,6 +176,24 @@ static int error;
 static inline void *KeymapThread(void *resource);
 
 
+/* Potentiometer Sampler Thread Function */
+
+
+#ifndef VIRTUAL_TIMER
+/**
+ * @brief Potentiometer Sampler Thread Function
+ * 
+ * Samples both potentiometers into pot_filter every POT_SAMPLE_US, on
+ * absolute deadlines of its own (not the dispatcher's), until stopped
+ * 
+ * @param unused Unused
+ * 
+ * @return NULL
+*/
+static void *SamplerThread(void *unused);
+#endif
+
+
 /* Limit Functions */
 
 
@@ -223,6 +203,7 @@ static inline void *KeymapThread(void *resource);
  * 
  * @param curr_pos The current position
  * @param curr_vel The current velocity
+ * @param faults Whether each encoder had an error
  * 
  * @return 0 upon no error, negative otherwise (using the universal
  * error codes)
@@ -230,7 +211,8 @@ static inline void *KeymapThread(void *resource);
  * @post Iff negative is returned, both motors are switched off
 */
 static inline int HandleEncoderError(Positions *curr_pos,
-                                      Velocities *curr_vel);
+                                      Velocities *curr_vel,
+                                      const bool faults[2]);
 
 
 /**
@@ -243,50 +225,21 @@ static inline int HandleEncoderError(Positions *curr_pos,
 static inline int HandlePotentiometerError(Angles *curr_ang);
 
 
-/* Secret Override of getkey() for thread-safety */
-
-
-/**
- * Waits for approximate 5 ms
- * 
- * @post About 5 ms have passed
-*/
-static inline void wait();
-
-
 /* Setup/Shutdown Functions */
 
 
 int IOSetup() {
-    /// Setup Timer
-    timer.timerWrite = IRQTIMERWRITE;
-    timer.timerSet = IRQTIMERSETTIME;
-
-    /// Setup Encoders Channels
-    conC_Encoder_initialize(myrio_session, &x_encoder, X_CONNECTOR_ID);
-    conC_Encoder_initialize(myrio_session, &y_encoder, Y_CONNECTOR_ID);
-
-    /// Setup Potentiometer Voltage Channels (are swapped)
-    Aio_InitCI1(&x_potentiometer);
-    Aio_InitCI0(&y_potentiometer);
-
-    /// Setup Motor Channels
-    Aio_InitCO0(&x_motor);
-    Aio_InitCO1(&y_motor);
-
-    /// Setup Keyboard Channels & Resources
-    uint8_t i;
-    for (i = 0; i < CHANNELS; i++) {
-        channel[i].dir = DIOB_70DIR;
-        channel[i].out = DIOB_70OUT;
-        channel[i].in = DIOB_70IN;
-        channel[i].bit = i;
-    }
-    VERIFY(error, pthread_mutex_init(&keyboard, NULL));
+    HalSensors sensors;
+
+    /// Setup the Timer, Encoder, Potentiometer, Motor and
+    /// Keyboard Channels
+    VERIFY(error, hal->setup());
     memset(keymap, false, sizeof(Keymap));
 
-    /// Setup Reset flag
+    /// Setup Reset flag and Velocity Estimators
     reset = true;
+    VelocityEstimatorInit(VEL_PLL_BANDWIDTH, VEL_PLL_COUNTS, velocity + 0);
+    VelocityEstimatorInit(VEL_PLL_BANDWIDTH, VEL_PLL_COUNTS, velocity + 1);
 
     /// Calibration Message
     printf_lcd("\fPlease stablize for calibration.\n"
@@ -294,41 +247,45 @@ int IOSetup() {
     while (getkey() != ENT) {}
     printf_lcd("\fCalibrating...\n");
 
-    /// Set Reference Positions
-    first_enc_state[0] = Encoder_Counter(&x_encoder);
-    first_enc_state[1] = Encoder_Counter(&y_encoder);
+    hal->read_sensors(&sensors);
 
-    /// Setup the holding
-    holding_vel_set = false;
-    holding_pos_set = false;
+    /// Set Reference Positions
+    first_enc_state[0] = sensors.encoder[HAL_X];
+    first_enc_state[1] = sensors.encoder[HAL_Y];
 
     /// Calibrate voltage intercepts for potentiometer
-    potentiometer_v_x_intercept = Aio_Read(&x_potentiometer);
-    potentiometer_v_y_intercept = Aio_Read(&y_potentiometer);
+    potentiometer_v_x_intercept = sensors.potentiometer[HAL_X];
+    potentiometer_v_y_intercept = sensors.potentiometer[HAL_Y];
 
     printf_lcd("Calibration Finished\n");
 
+    /// Set up the Potentiometer Filter (the BTI's mean), and Start Sampling
+    Real taps[POT_TAPS];
+    int tap;
+    for (tap = 0; tap < POT_TAPS; tap++) taps[tap] = 1.0 / POT_TAPS;
+    VERIFY(error, DecimatorInit(taps, POT_TAPS, 2, &pot_filter));
+#ifndef VIRTUAL_TIMER
+    sampler_running = true;
+    VERIFY(error, ThreadCreate(&sampler_thread, SamplerThread, NULL,
+                               &sampler_attributes));
+#endif
+
     return EXIT_SUCCESS;
 }
 
 int IOShutdown() {
-    /// Dissasociate with Encoders
-    memset(&x_encoder, 0, sizeof(MyRio_Encoder));
-    memset(&y_encoder, 0, sizeof(MyRio_Encoder));
-
-    /// Dissasociate with Potentiometers
-    memset(&x_potentiometer, 0, sizeof(MyRio_Aio));
-    memset(&y_potentiometer, 0, sizeof(MyRio_Aio));
+#ifndef VIRTUAL_TIMER
+    /// Stop Sampling
+    __atomic_store_n(&sampler_running, false, __ATOMIC_RELEASE);
+    VERIFY(error, pthread_join(sampler_thread, NULL));
+#endif
+
+    /// Dissasociate with Encoders, Potentiometers and Motor,
+    /// and Destroy Keyboard Lock
+    VERIFY(error, hal->shutdown());
     potentiometer_v_x_intercept = 0.0;
     potentiometer_v_y_intercept = 0.0;
 
-    /// Disassociate with Motor
-    memset(&x_motor, 0, sizeof(MyRio_Aio));
-    memset(&y_motor, 0, sizeof(MyRio_Aio));
-
-    /// Destroy Keyboard Lock
-    VERIFY(error, pthread_mutex_destroy(&keyboard));
-
     return EXIT_SUCCESS;
 }
 
@@ -375,97 +332,55 @@ int GetReferenceAngleCommand(Angles *result) {
     return EXIT_SUCCESS;
 }
 
-int GetAngle(Angles *result) {
-    float x_voltage = Aio_Read(&x_potentiometer);
-    float y_voltage = Aio_Read(&y_potentiometer);
-
-    result->x_angle =
-        POTENTIOMETER_SLOPE * (x_voltage - potentiometer_v_x_intercept);
-    result->y_angle =
-        POTENTIOMETER_SLOPE * (y_voltage - potentiometer_v_y_intercept);
-
-    return HandlePotentiometerError(result);
-}
-
-int GetTrolleyPosition(Positions *result) {
-    static int32_t next_enc_state[2];
-    if (reset) {
-        prev_enc_state[0] = Encoder_Counter(&x_encoder);
-        prev_enc_state[1] = Encoder_Counter(&y_encoder);
-        reset = false;
-        holding_vel_set = false;
-        holding_pos_set = false;
-    }
-
-    if (holding_pos_set) {
-        result->x_pos = holding_pos.x_pos;
-        result->y_pos = holding_pos.y_pos;
-
-        holding_pos_set = false;
-
-        return EXIT_SUCCESS;
-    }
-
-    next_enc_state[0] = (int32_t) Encoder_Counter(&x_encoder);
-    next_enc_state[1] = (int32_t) Encoder_Counter(&y_encoder);
-
-    result->x_pos
-        = ENC_2_POS((double) (next_enc_state[0] - first_enc_state[0]));
-    result->y_pos
-        = ENC_2_POS((double) (next_enc_state[1] - first_enc_state[1]));
-
-	holding_vel.x_vel
-		= ENC_2_VEL((double) (next_enc_state[0] - prev_enc_state[0]));
-	holding_vel.y_vel
-		= ENC_2_VEL((double) (next_enc_state[1] - prev_enc_state[1]));
-	holding_vel_set = true;
-
-    prev_enc_state[0] = next_enc_state[0];
-    prev_enc_state[1] = next_enc_state[1];
-
-    return HandleEncoderError(result, &holding_vel);
-}
+int ReadSensorSnapshot(SensorSnapshot *result) {
+    HalSensors sensors;
+    int32_t *counts = sensors.encoder;
+    Real pot[2];
+    double t;
+
+    result->t_ns = ThreadClockNs();
+    hal->read_sensors(&sensors);
+#ifdef HOST_TIMER
+    // The plant's time, which runs HOST_TIME_SCALE times the host's
+    t = result->t_ns * (double) HOST_TIME_SCALE * 1e-9;
+#else
+    t = result->t_ns * 1e-9;
+#endif
+
+    /// This read's voltages, until the filter has enough samples
+    pot[HAL_X] = sensors.potentiometer[HAL_X];
+    pot[HAL_Y] = sensors.potentiometer[HAL_Y];
+#ifdef VIRTUAL_TIMER
+    uint32_t i;
+    // The virtual clock stands still within a BTI, so each of its
+    // samples is this read
+    for (i = 0; i < POT_DECIMATION; i++) DecimatorPush(&pot_filter, pot);
+#endif
+    DecimatorOutput(&pot_filter, pot);
 
-int GetTrolleyVelocity(Velocities *result) {
-    static int32_t next_enc_state[2];
     if (reset) {
-        prev_enc_state[0] = Encoder_Counter(&x_encoder);
-        prev_enc_state[1] = Encoder_Counter(&y_encoder);
+        VelocityEstimatorReset(velocity + 0);
+        VelocityEstimatorReset(velocity + 1);
         reset = false;
-        holding_vel_set = false;
-        holding_pos_set = false;
-
-        result->x_vel = 0.0;
-        result->y_vel = 0.0;
-
-        return EXIT_SUCCESS;
-    }
-
-    if (holding_vel_set) {
-        result->x_vel = holding_vel.x_vel;
-        result->y_vel = holding_vel.y_vel;
-
-        holding_vel_set = false;
-
-        return EXIT_SUCCESS;
     }
 
-    next_enc_state[0] = (int32_t) Encoder_Counter(&x_encoder);
-    next_enc_state[1] = (int32_t) Encoder_Counter(&y_encoder);
-
-    result->x_vel = ENC_2_VEL((double) (next_enc_state[0] - prev_enc_state[0]));
-    result->y_vel = ENC_2_VEL((double) (next_enc_state[1] - prev_enc_state[1]));
-
-	holding_pos.x_pos
-		= ENC_2_POS((double) (next_enc_state[0] - first_enc_state[0]));
-	holding_pos.y_pos
-		= ENC_2_POS((double) (next_enc_state[1] - first_enc_state[1]));
-	holding_pos_set = true;
-
-    prev_enc_state[0] = next_enc_state[0];
-    prev_enc_state[1] = next_enc_state[1];
-
-    return HandleEncoderError(&holding_pos, result);
+    result->angle.x_angle = POTENTIOMETER_SLOPE *
+        (pot[HAL_X] - potentiometer_v_x_intercept);
+    result->angle.y_angle = POTENTIOMETER_SLOPE *
+        (pot[HAL_Y] - potentiometer_v_y_intercept);
+
+    result->pos.x_pos
+        = ENC_2_POS((double) (counts[HAL_X] - first_enc_state[0]));
+    result->pos.y_pos
+        = ENC_2_POS((double) (counts[HAL_Y] - first_enc_state[1]));
+    result->vel.x_vel
+        = ENC_2_POS(EstimateVelocity(velocity + 0, counts[HAL_X], t));
+    result->vel.y_vel
+        = ENC_2_POS(EstimateVelocity(velocity + 1, counts[HAL_Y], t));
+
+    if (HandlePotentiometerError(&(result->angle))) return u_error;
+    return HandleEncoderError(&(result->pos), &(result->vel),
+                              sensors.encoder_fault);
 }
 
 int GetUserPosition(Angles *angle, Positions *pos, Positions *result) {
@@ -485,13 +400,8 @@ int GetUserVelocity(Angles *angle, Velocities *vel, Velocities *result) {
 /* Actuator Functions */
 
 
-int SetXVoltage(Voltage voltage) {
-    Aio_Write(&x_motor, voltage);
-    return EXIT_SUCCESS;
-}
-
-int SetYVoltage(Voltage voltage) {
-    Aio_Write(&y_motor, voltage);
+int SetVoltages(Voltage x_voltage, Voltage y_voltage) {
+    hal->write_motors(x_voltage, y_voltage);
     return EXIT_SUCCESS;
 }
 
@@ -500,27 +410,17 @@ int SetYVoltage(Voltage voltage) {
 
 
 bool PressedDelete() {
-#define DEL_ROW 7  ///< The Delete Key's Row
+#define DEL_ROW 3  ///< The Delete Key's Row
 #define DEL_COL 3  ///< The Delete Key's Column
-	pthread_mutex_lock(&keyboard);
-    uint8_t j;
-    for (j = 0; j < LCD_KEYPAD_LEN; j++) {
-        Dio_WriteBit(channel + j, j == DEL_COL ? NiFpga_False : NiFpga_True);
-    }
-
-    if (!Dio_ReadBit(channel + DEL_ROW)) {
-    	pthread_mutex_unlock(&keyboard);
-        return true;
-    }
-
-    pthread_mutex_unlock(&keyboard);
-    return false;
+    return hal->scan_keypad(1u << DEL_COL) & HAL_KEY_BIT(DEL_ROW, DEL_COL);
 #undef DEL_ROW
 #undef DEL_COL
 }
 
 int KeyboardControlFork() {
     /// Begin Keyboard Thread
+    REGISTER_TASK(keymap_resource, KEYPAD_PERIOD, KEYPAD_PHASE,
+                  KEYPAD_PRIORITY, KEYPAD_CPU);
     START_THREAD(keymap_thread, KeymapThread, keymap_resource);
     return EXIT_FAILURE;
 }
@@ -528,6 +428,7 @@ int KeyboardControlFork() {
 int KeyboardControlJoin() {
     /// Destroy Keymap Thread
     STOP_THREAD(keymap_thread, keymap_resource);
+    UNREGISTER_TASK(keymap_resource);
     return EXIT_SUCCESS;
 }
 
@@ -538,29 +439,62 @@ int KeyboardControlJoin() {
 static inline void *KeymapThread(void *resource) {
     ThreadResource *thread_resource = (ThreadResource *) resource;
     uint8_t i, j;
+    uint16_t keys;
 
     while (thread_resource->irq_thread_rdy) {
-        pthread_mutex_lock(&keyboard);
-        for (i = 0; i < LCD_KEYPAD_LEN - 1; i++) {
-            for (j = 0; j < LCD_KEYPAD_LEN; j++) {
-                Dio_WriteBit(channel + j, i == j ? NiFpga_False : NiFpga_True);
-            }
-            for (j = LCD_KEYPAD_LEN; j < 2 * LCD_KEYPAD_LEN - 1; j++) {
-                keymap[3 * (j - LCD_KEYPAD_LEN) + i]
-                    = !Dio_ReadBit(channel + j);
+        uint32_t irq_assert = 0;
+        TASK_TRIGGER(irq_assert, thread_resource);
+        if (!irq_assert) continue;
+
+        /// The first three columns, of which
+        /// the first three rows are 1 through 9
+        keys = hal->scan_keypad(0x7u);
+        for (i = 0; i < HAL_KEYPAD_LEN - 1; i++) {
+            for (j = 0; j < HAL_KEYPAD_LEN - 1; j++) {
+                keymap[3 * j + i] = (keys & HAL_KEY_BIT(j, i)) != 0;
             }
         }
-        pthread_mutex_unlock(&keyboard);
     }
     EXIT_THREAD();
 }
 
 
+/* Potentiometer Sampler Thread Function */
+
+
+#ifndef VIRTUAL_TIMER
+static void *SamplerThread(void *unused) {
+    struct timespec deadline;
+    uint64_t deadline_ns = ThreadClockNs();
+    double voltage[2];
+    Real sample[2];
+
+    while (__atomic_load_n(&sampler_running, __ATOMIC_ACQUIRE)) {
+        hal->read_potentiometers(voltage);
+        sample[HAL_X] = voltage[HAL_X];
+        sample[HAL_Y] = voltage[HAL_Y];
+        DecimatorPush(&pot_filter, sample);
+
+        // Absolute deadlines, so that late wake-ups do not accumulate,
+        // but the samples already missed are skipped, not taken at once
+        deadline_ns += POT_SAMPLE_NS;
+        if (deadline_ns < ThreadClockNs()) deadline_ns = ThreadClockNs();
+        deadline.tv_sec = deadline_ns / 1000000000u;
+        deadline.tv_nsec = deadline_ns % 1000000000u;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                               &deadline, NULL) == EINTR) {}
+    }
+    EXIT_THREAD();
+}
+#endif
+
+
 /* Limit Functions */
 
 
 static inline int HandleEncoderError(Positions *curr_pos,
-                                      Velocities *curr_vel) {
+                                      Velocities *curr_vel,
+                                      const bool faults[2]) {
     /// Check Positional Limits first
     u_error = EXIT_SUCCESS;
     if ((curr_pos->x_pos > X_LIM_HI && curr_vel->x_vel > 0.0) ||
@@ -574,28 +508,18 @@ static inline int HandleEncoderError(Positions *curr_pos,
         fabsf(curr_vel->y_vel) > VEL_LIM_ABS) {
         u_error = EVTYE;
     }
-    /// Now, check if there is an encoder error
-    if (Encoder_Status(&x_encoder) & enc_st_mask) {
-
+    /// Now, check if there is an encoder error (which is cleared)
+    if (faults[HAL_X]) {
     		/// u_error = EENCR;
-    		/// conC_Encoder_initialize(myrio_session, &x_encoder, X_CONNECTOR_ID);
-
     		printf("Attempting to Reset X Encoder\n");
-    		Encoder_Configure(&x_encoder, Encoder_Error | Encoder_Enable | Encoder_SignalMode,
-    							Encoder_ClearError | Encoder_Enabled | Encoder_QuadPhase);
     }
-    if (Encoder_Status(&y_encoder) & enc_st_mask) {
-
+    if (faults[HAL_Y]) {
         	/// u_error = EENCR;
-        	/// conC_Encoder_initialize(myrio_session, &y_encoder, Y_CONNECTOR_ID);
         	printf("Attempting to Reset Y Encoder\n");
-        	Encoder_Configure(&y_encoder, Encoder_Error | Encoder_Enable | Encoder_SignalMode,
-        	    							Encoder_ClearError | Encoder_Enabled | Encoder_QuadPhase);
     }
     /// Output Error
     if (u_error) {
-        SetXVoltage(0.0);
-        SetYVoltage(0.0);
+        SetVoltages(0.0, 0.0);
     }
 
     return u_error;
@@ -612,8 +536,7 @@ static inline int HandlePotentiometerError(Angles *curr_ang) {
         u_error = ESTRN;
     }
     if (u_error) {
-        SetXVoltage(0.0);
-        SetYVoltage(0.0);
+        SetVoltages(0.0, 0.0);
     }
     return u_error;
 }
@@ -622,44 +545,6 @@ static inline int HandlePotentiometerError(Angles *curr_ang) {
 /* Secret Override of getkey() function for thread-safety */
 
 
-static inline void wait() {
-    uint32_t i;
-/// Wait Constant
-#define WAIT_CONST 417000
-
-    i = 0;
-    while (i++ < WAIT_CONST) {}
-
-    return;
-#undef WAIT_CONST
-}
-
 char getkey() {
-    uint8_t i, j;
-
-    /// Keypad characters
-    static char keypad[LCD_KEYPAD_LEN][LCD_KEYPAD_LEN] = {{'1', '2', '3', UP},
-                                                          {'4', '5', '6', DN},
-                                                          {'7', '8', '9', ENT},
-                                                          {'0', '.', '-', DEL}};
-    /// Locking style allows for getkey() to take precedence
-    /// over all other keyboard commands
-    pthread_mutex_lock(&keyboard);
-    while (NiFpga_True) {
-        for (i = 0; i < LCD_KEYPAD_LEN; i++) {
-            for (j = 0; j < LCD_KEYPAD_LEN; j++) {
-                Dio_WriteBit(channel + j, i == j ? NiFpga_False : NiFpga_True);
-            }
-            for (j = LCD_KEYPAD_LEN; j < 2 * LCD_KEYPAD_LEN; j++) {
-                if (!Dio_ReadBit(channel + j)) {
-                    while (!Dio_ReadBit(channel + j)) {}
-                    pthread_mutex_unlock(&keyboard);
-                    return keypad[j - LCD_KEYPAD_LEN][i];
-                }
-            }
-            wait();
-        }
-    }
-    pthread_mutex_unlock(&keyboard);
-    return '\0';
+    return hal->get_key();
 }
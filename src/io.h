@@ -13,9 +13,12 @@
 #ifndef IO_H_
 #define IO_H_
 
+#include <stdint.h>
 #include <stdbool.h>
 
+#ifndef HOST_TIMER
 #include "TimerIRQ.h"
+#endif
 
 
 /* Input/Output Data Types */
@@ -69,9 +72,39 @@ typedef struct {
     Velocity y_vel;
 } Velocities;
 
+/**
+ * @brief A Sensor Snapshot
+ * 
+ * Every sensor, read together (once per control cycle), so that
+ * the X and Y samples are of the same instant
+*/
+typedef struct {
+    ///! When the sensors were read (ThreadClockNs(), ns)
+    uint64_t t_ns;
+    ///! Rope Angles
+    Angles angle;
+    ///! Trolley Positions
+    Positions pos;
+    ///! Trolley Velocities
+    Velocities vel;
+} SensorSnapshot;
+
 /* Sensor Variables */
+#ifndef HOST_TIMER
 /// The Timer
 extern MyRio_IrqTimer timer;
+#endif
+
+/* Potentiometer Front-End */
+/// Potentiometer Sampling Period (us): a thread of its own samples
+/// both potentiometers at 5 kHz, between control cycles
+#define POT_SAMPLE_US 200u
+/// Potentiometer Filter Taps (one BTI of samples), of equal weight:
+/// the mean of the BTI (see bench/oversample.c)
+#define POT_TAPS 25
+/// Potentiometer Filter Group Delay (us): how old the (filtered)
+/// angles of a SensorSnapshot are
+#define POT_DELAY_US ((POT_TAPS - 1) * POT_SAMPLE_US / 2)
 
 /* Actuator Limits */
 /// Motor Voltage High Limit (V)
@@ -136,11 +169,10 @@ int IOShutdown();
 
 
 /**
- * Resets GetTrolleyPosition and
- * GetTrolleyVelocity by setting the
- * velocity to zero
+ * Resets ReadSensorSnapshot by setting
+ * the velocity to zero
  * 
- * @post The next time GetTrolleyVelocity
+ * @post The next time ReadSensorSnapshot
  * is called, both velocities are zero
 */
 void Reset();
@@ -176,50 +208,28 @@ int GetReferenceVelocityCommand(Velocities *result);
 int GetReferenceAngleCommand(Angles *result);
 
 /**
- * Obtains the angle of the harness
- * 
- * @param result A return parameter, which
- * will become the angle along both directions
- * 
- * @return 0 upon success, other integers
- * if otherwise
- * @return result, which will define the
- * angle of the harness along 
- * both lateral directions
-*/
-int GetAngle(Angles *result);
-
-/**
- * Obtains the Trolley Position
- * 
- * @param result A return parameter, which
- * will become the position of the trolley
- * 
- * @return 0 upon success, other integers
- * if otherwise
- * @return A Positions structure, which
- * defines the Position of the Motor in
- * the lateral plane
+ * Reads every sensor at once (each FPGA register once), and checks the
+ * limits (once)
  * 
- * @pre This is called precisely once every BTI
-*/
-int GetTrolleyPosition(Positions *result);
-
-/**
- * Obtains the Trolley Velocity
+ * The rope angles are the mean of the potentiometers' samples over
+ * the last BTI (see Decimator), so that they are POT_DELAY_US old,
+ * but with little of the samples' noise (until there are enough
+ * samples, they are this read's). On the virtual clock, which stands
+ * still within a BTI, there is no sampler: this read stands for each
+ * of the BTI's samples instead
  * 
  * @param result A return parameter, which
- * will become the velocity of the trolley
+ * will become the snapshot: the rope angles
+ * (filtered), and the trolley's position and velocity
+ * (over an adaptive window, see VelocityEstimator)
  * 
  * @return 0 upon success, other integers
- * if otherwise
- * @return A Velocities structure, which
- * defines the velocity of the trolley in
- * the lateral plane
+ * if otherwise (using the universal error
+ * codes, after which both motors are off)
  * 
  * @pre This is called precisely once every BTI
 */
-int GetTrolleyVelocity(Velocities *result);
+int ReadSensorSnapshot(SensorSnapshot *result);
 
 /**
  * Obtains the User Position
@@ -258,20 +268,16 @@ int GetUserVelocity(Angles *angle, Velocities *vel, Velocities *result);
 
 
 /**
- * Sets the voltage of the X motor
+ * Sets the voltages of both motors
+ * at once
  * 
- * @return 0 upon success, other integers
- * if otherwise
-*/
-int SetXVoltage(Voltage voltage);
-
-/**
- * Sets the voltage of the Y motor
+ * @param x_voltage The X motor's voltage
+ * @param y_voltage The Y motor's voltage
  * 
  * @return 0 upon success, other integers
  * if otherwise
 */
-int SetYVoltage(Voltage voltage);
+int SetVoltages(Voltage x_voltage, Voltage y_voltage);
 
 
 /* Keyboard Functions */
@@ -0,0 +1,240 @@
+/**
+ * @file mat-stream.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Streaming MAT-File (Level 5) Writer
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mat-stream.h"
+
+
+/* MAT v5 Constants */
+
+
+/// Header Length (bytes)
+#define MAT_HEADER_LEN 128
+/// Header Text Length (bytes)
+#define MAT_HEADER_TEXT_LEN 116
+/// 8-bit Signed Integer Type
+#define MI_INT8 1
+/// 32-bit Signed Integer Type
+#define MI_INT32 5
+/// 32-bit Unsigned Integer Type
+#define MI_UINT32 6
+/// Matrix Type
+#define MI_MATRIX 14
+/// Double Array Class
+#define MX_DOUBLE_CLASS 6
+/// Single Array Class
+#define MX_SINGLE_CLASS 7
+/// 32-bit Signed Integer Array Class
+#define MX_INT32_CLASS 12
+
+
+/* Static Helper Functions */
+
+
+/**
+ * Rounds a length up to a whole number of 8-byte words
+ * 
+ * @param bytes The length (bytes)
+ * 
+ * @return The padded length (bytes)
+*/
+static inline uint32_t Pad8(uint32_t bytes) {
+    return (bytes + 7u) & ~7u;
+}
+
+/**
+ * Writes a whole buffer at an offset
+ * 
+ * @param fd The file's descriptor
+ * @param buffer The buffer
+ * @param length The buffer's length (bytes)
+ * @param offset The file offset
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+*/
+static int WriteAt(int fd, const void *buffer, size_t length, off_t offset) {
+    const char *bytes = (const char *) buffer;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, bytes, length, offset);
+        if (written <= 0) return EXIT_FAILURE;
+        bytes += written;
+        length -= written;
+        offset += written;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Writes a matrix's header at the end of the file
+ * 
+ * The header holds the matrix tag, array flags, dimensions and
+ * name, and the tag of its values
+ * 
+ * @param mat The MatStream
+ * @param name The matrix's name
+ * @param type The type of the matrix's values
+ * @param rows The number of rows
+ * @param cols The number of columns
+ * 
+ * @return 0 upon success, EXIT_FAILURE otherwise
+ * 
+ * @post mat->end is the offset of the matrix's values
+*/
+static int WriteMatrixHeader(MatStream *mat,
+                             const char *name,
+                             MatType type,
+                             uint32_t rows,
+                             uint32_t cols) {
+    uint32_t name_len = strlen(name);
+    uint32_t data_len = rows * cols * MatTypeSize(type);
+    uint32_t header[14];
+    char padded_name[64];
+    int n = 0;
+
+    if (name_len > sizeof(padded_name)) return EXIT_FAILURE;
+    memset(padded_name, 0, sizeof(padded_name));
+    memcpy(padded_name, name, name_len);
+
+    header[n++] = MI_MATRIX;
+    header[n++] = 16 + 16 + 8 + Pad8(name_len) + 8 + Pad8(data_len);
+    header[n++] = MI_UINT32;  // array flags
+    header[n++] = 8;
+    header[n++] = type == MAT_INT32 ? MX_INT32_CLASS :
+                  type == MAT_SINGLE ? MX_SINGLE_CLASS : MX_DOUBLE_CLASS;
+    header[n++] = 0;
+    header[n++] = MI_INT32;  // dimensions
+    header[n++] = 8;
+    header[n++] = rows;
+    header[n++] = cols;
+    header[n++] = MI_INT8;  // name
+    header[n++] = name_len;
+    if (WriteAt(mat->fd, header, n * sizeof(uint32_t), mat->end)) {
+        return EXIT_FAILURE;
+    }
+    mat->end += n * sizeof(uint32_t);
+    if (WriteAt(mat->fd, padded_name, Pad8(name_len), mat->end)) {
+        return EXIT_FAILURE;
+    }
+    mat->end += Pad8(name_len);
+
+    header[0] = type;  // real part
+    header[1] = data_len;
+    if (WriteAt(mat->fd, header, 2 * sizeof(uint32_t), mat->end)) {
+        return EXIT_FAILURE;
+    }
+    mat->end += 2 * sizeof(uint32_t);
+    return EXIT_SUCCESS;
+}
+
+
+/* MAT Stream Function Definitions */
+
+
+int MatStreamOpen(MatStream *mat, const char *path) {
+    char header[MAT_HEADER_LEN];
+    uint16_t version = 0x0100;
+    uint16_t endian = ('M' << 8) | 'I';
+#ifdef VIRTUAL_TIMER
+    // The same header in every run
+    time_t now = 0;
+#else
+    time_t now = time(NULL);
+#endif
+    int length;
+
+    mat->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    mat->end = 0;
+    if (mat->fd < 0) return EXIT_FAILURE;
+
+    // Descriptive text (space-padded), subsystem offset (none),
+    // version, and endian indicator (reads as "IM" when little-endian)
+    memset(header, ' ', MAT_HEADER_TEXT_LEN);
+    length = snprintf(header, MAT_HEADER_TEXT_LEN,
+                      "MATLAB 5.0 MAT-file, Platform: myRIO, Created on: %s",
+                      ctime(&now));
+    if (length > 0 && length < MAT_HEADER_TEXT_LEN) {
+        // Replace the terminator (and ctime()'s newline) with spaces
+        header[length] = ' ';
+        if (header[length - 1] == '\n') header[length - 1] = ' ';
+    }
+    memset(header + MAT_HEADER_TEXT_LEN, 0, 8);
+    memcpy(header + 124, &version, sizeof(version));
+    memcpy(header + 126, &endian, sizeof(endian));
+
+    if (WriteAt(mat->fd, header, MAT_HEADER_LEN, 0)) {
+        close(mat->fd);
+        mat->fd = -1;
+        return EXIT_FAILURE;
+    }
+    mat->end = MAT_HEADER_LEN;
+    return EXIT_SUCCESS;
+}
+
+int MatStreamAddMatrix(MatStream *mat,
+                       const char *name,
+                       const double *values,
+                       uint32_t rows,
+                       uint32_t cols) {
+    size_t length = (size_t) rows * cols * sizeof(double);
+    if (WriteMatrixHeader(mat, name, MAT_DOUBLE, rows, cols)) {
+        return EXIT_FAILURE;
+    }
+    if (WriteAt(mat->fd, values, length, mat->end)) return EXIT_FAILURE;
+    mat->end += length;
+    return EXIT_SUCCESS;
+}
+
+int MatStreamAddElements(MatStream *mat,
+                         const void *elements,
+                         size_t length) {
+    if (length % 8) return EXIT_FAILURE;
+    if (WriteAt(mat->fd, elements, length, mat->end)) return EXIT_FAILURE;
+    mat->end += length;
+    return EXIT_SUCCESS;
+}
+
+int MatStreamBeginMatrix(MatStream *mat,
+                         const char *name,
+                         MatType type,
+                         uint32_t rows,
+                         uint32_t cols,
+                         off_t *data) {
+    if (WriteMatrixHeader(mat, name, type, rows, cols)) return EXIT_FAILURE;
+    *data = mat->end;
+    // Data elements end on 8-byte boundaries
+    mat->end += Pad8(rows * cols * MatTypeSize(type));
+    // Extend the file over the values, in case they are never written
+    return ftruncate(mat->fd, mat->end) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int MatStreamWriteValues(MatStream *mat,
+                         off_t offset,
+                         const void *values,
+                         size_t length) {
+    return WriteAt(mat->fd, values, length, offset);
+}
+
+int MatStreamClose(MatStream *mat) {
+    int err = EXIT_SUCCESS;
+    if (mat->fd < 0) return EXIT_SUCCESS;
+    if (fsync(mat->fd)) err = EXIT_FAILURE;
+    if (close(mat->fd)) err = EXIT_FAILURE;
+    mat->fd = -1;
+    return err;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file mat-stream.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Streaming MAT-File (Level 5) Writer Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Writes uncompressed, little-endian MAT v5 files (as MATLAB and
+ * scipy.io.loadmat read them) one data element at a time, so nothing
+ * has to be held in memory until the file is closed. A matrix may be
+ * written whole, or its header first and its data later (in any order)
+ * with pwrite(), once its dimensions are known.
+ * 
+ * Matrices written whole are doubles; reserved matrices may also be
+ * int32 or single, and are read back as that class.
+ */
+
+#ifndef MAT_STREAM_H_
+#define MAT_STREAM_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+
+/* MAT Stream Data Structures */
+
+
+/**
+ * @brief A MAT Data Type (the value of its miXXX tag)
+*/
+typedef enum {
+    MAT_INT32 = 5,  ///< miINT32, read as an int32 matrix
+    MAT_SINGLE = 7,  ///< miSINGLE, read as a single matrix
+    MAT_DOUBLE = 9,  ///< miDOUBLE, read as a double matrix
+} MatType;
+
+/**
+ * @brief A MAT File being written
+*/
+typedef struct {
+    int fd;  ///< the file's descriptor (-1 if closed)
+    off_t end;  ///< the end of the last data element
+} MatStream;
+
+
+/* MAT Stream Functions */
+
+
+/**
+ * Creates a MAT file
+ * 
+ * @param mat The MatStream to open
+ * @param path The file's path (replaced if it exists)
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @post mat holds the file, with its header written
+*/
+int MatStreamOpen(MatStream *mat, const char *path);
+
+/**
+ * Writes a double matrix
+ * 
+ * @param mat The MatStream
+ * @param name The matrix's name
+ * @param values The values (column-major)
+ * @param rows The number of rows
+ * @param cols The number of columns
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int MatStreamAddMatrix(MatStream *mat,
+                       const char *name,
+                       const double *values,
+                       uint32_t rows,
+                       uint32_t cols);
+
+/**
+ * Writes data elements verbatim, e.g. another MAT file's (after its
+ * header)
+ * 
+ * @param mat The MatStream
+ * @param elements The data elements
+ * @param length The elements' length (bytes, a multiple of 8)
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int MatStreamAddElements(MatStream *mat,
+                         const void *elements,
+                         size_t length);
+
+/**
+ * Gets the size of a MatType's values
+ * 
+ * @param type The MatType
+ * 
+ * @return The size of each value (bytes)
+*/
+static inline uint32_t MatTypeSize(MatType type) {
+    return type == MAT_DOUBLE ? 8u : 4u;
+}
+
+/**
+ * Writes a matrix's header, and reserves its data
+ * 
+ * @param mat The MatStream
+ * @param name The matrix's name
+ * @param type The type of the matrix's values
+ * @param rows The number of rows
+ * @param cols The number of columns
+ * @param data A return parameter, which becomes the file offset of
+ * the matrix's values (column-major), for pwrite()
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @post The next data element is written after the reserved values
+*/
+int MatStreamBeginMatrix(MatStream *mat,
+                         const char *name,
+                         MatType type,
+                         uint32_t rows,
+                         uint32_t cols,
+                         off_t *data);
+
+/**
+ * Writes values reserved by MatStreamBeginMatrix()
+ * 
+ * @param mat The MatStream
+ * @param offset The file offset to write at
+ * @param values The values (of the matrix's type)
+ * @param length The values' length (bytes)
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int MatStreamWriteValues(MatStream *mat,
+                         off_t offset,
+                         const void *values,
+                         size_t length);
+
+/**
+ * Closes a MAT file
+ * 
+ * @param mat The MatStream to close
+ * 
+ * @return 0 upon success, negative otherwise
+ * 
+ * @post The file is flushed to storage
+*/
+int MatStreamClose(MatStream *mat);
+
+#endif  // MAT_STREAM_H_
@@ -8,15 +8,53 @@
  * 
  * @copyright Copyright (c) 2024
  * 
+ * Samples are appended to a spool file next to each data file at
+ * every drain, so memory stays at one chunk per file however long the
+ * run. One-time values are written to the MAT file as they come.
+ * SaveDataFiles() transposes each spool into the MAT file's columns, a
+ * chunk at a time; until then, the MAT file holds no samples.
+ * 
+ * Each channel may be switched off or decimated, and a file may keep
+ * only windows around triggers (see RecordSetCapture()). The spool
+ * (<name>.spool, see spool.h) describes its channels in its header,
+ * then holds one record per kept sample. A spool left by a crash is
+ * expanded with tools/unpack.c; it holds the samples up to the last
+ * drain (the last sync, if the system went down too).
+ * 
+ * Each sample drained from a ring is also written to the file's flight
+ * log (<name> with a .flight extension), which keeps the last
+ * RECORD_FLIGHT_SECONDS even if the process crashes.
+ * 
+ * A compressed file encodes its columns as it records instead (see
+ * gorilla.h), and spools their blocks, each framed, after the series
+ * file's header; closing the file keeps the spool as the series file.
+ * A compressed spool left by a crash decodes up to each column's last
+ * whole block (the blocks being encoded are lost).
+ * 
+ * RecordEndRun() cuts a file's spool at the end of each run: the
+ * segment writer thread turns the run's spool into its own file (as
+ * SaveDataFiles() would), and then adds the run to the file's index.
  */
 
+// For posix_fallocate(), pread() and pwrite()
+#define _GNU_SOURCE
+
+#include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-
-#include "matlabfiles.h"
-
+#include "mat-stream.h"
+#include "flight-log.h"
+#include "gorilla.h"
+#include "spool.h"
 #include "setup.h"
+#include "thread-lib.h"
 
 #include "record.h"
 
@@ -26,35 +64,183 @@
 
 /// Default number of Files to remember
 #define DEFAULT_NUM_FILES 3
-/// Default number of values for data arrays
-#define DEFAULT_NUM_VALS 10
 /// Default resize factor
 #define DEFAULT_RESIZE_FACTOR 2
 
 
+/* Chunk Constants */
+
+
+/// Samples per chunk (5.12 s at 5 ms)
+#define CHUNK_SAMPLES 1024
+/// Cache line size (bytes), which samples and chunks are aligned to
+#define CACHE_LINE 64
+/// The largest channel (bytes)
+#define MAX_CHANNEL_SIZE 8
+/// The length of a record's index and mask (bytes, see spool.h)
+#define RECORD_HEADER_LEN SPOOL_RECORD_HEADER_LEN
+
+
+/* Segment Constants */
+
+
+/// The longest line of a run index (bytes)
+#define INDEX_LINE_LEN 1024
+
+
 /* Internal DataFile Representation */
 
 
+/**
+ * @brief Channel Settings
+*/
+typedef struct {
+    /// Whether the channel is recorded
+    bool enabled;
+    /// The channel is recorded at samples whose index it divides
+    uint32_t decimation;
+    /// The magnitude at which the channel triggers a capture (0 if never)
+    double threshold;
+    /// The number of values recorded
+    uint32_t num_vals;
+    /// Whether the channel's RMS and peak go into the run index
+    bool metric;
+    /// The sum of the squares of the run's values
+    double sum_sq;
+    /// The largest magnitude of the run's values
+    double peak;
+} ChannelState;
+
+
 /**
  * @brief Data File
  * 
  * Internal Representation of a Data File
 */
 typedef struct {
-    /// The MATFILE that this DataFile will store its data into
-    MATFILE *file;
+    /// The MAT file that this DataFile will stream its data into
+    MatStream mat;
+    /// The spool file, which holds the samples until the MAT file closes
+    int spool;
+    /// The spool file's path
+    char *spool_path;
+    /// The flight log's path
+    char *flight_path;
     /// The number of arrays in this file
     int num_entries;
-    /// The names of all arrays in this file
-    char **entry_names;
-    /// The number of values in each array
-    int num_vals;
-    /// The capacity of the arrays in the data structure below
-    int vals_capacity;
-    /// A pointer to pointers to arrays for the data being stored (2D array)
-    double **entry_values;
+    /// The arrays in this file (with their names copied)
+    RecordChannel *channels;
+    /// The settings of each array
+    ChannelState *state;
+    /// The length of each sample (bytes)
+    uint32_t sample_size;
+    /// The number of samples seen (the index of the next)
+    uint32_t num_samples;
+    /// The number of records spooled (samples with a channel recorded)
+    uint32_t num_records;
+    /// The records not yet spooled, one after another
+    char *chunk;
+    /// The length of the records in chunk (bytes)
+    size_t chunk_len;
+    /// The capacity of chunk (bytes)
+    size_t chunk_capacity;
+    /// The length of the spool (bytes)
+    off_t spooled;
+    /// The length of the spool last synced to storage (bytes)
+    off_t synced;
+    /// Samples kept before each trigger (0 to record continuously,
+    /// unless post is set)
+    uint32_t pre;
+    /// Samples kept after each trigger
+    uint32_t post;
+    /// The last pre samples (a circular buffer)
+    char *history;
+    /// The index of each sample in history
+    uint32_t *history_index;
+    /// The number of samples in history
+    uint32_t history_len;
+    /// The slot in history to write next
+    uint32_t history_next;
+    /// The number of samples left to keep after the last trigger
+    uint32_t post_left;
+    /// The number of RecordTrigger() calls handled
+    uint32_t triggers;
+    /// Each channel's encoder, then the samples' indices' (NULL unless
+    /// compressed)
+    GorillaEncoder *series;
+    /// The series file's path
+    char *series_path;
+    /// The file's name without its extension
+    char *stem;
+    /// The number of runs ended (see RecordEndRun())
+    int runs;
+    /// The index of the current run's first sample
+    uint32_t run_start;
+    /// The run index (-1 until the first run ends)
+    int index;
 } DataFile_t;
 
+/**
+ * @brief Segment
+ * 
+ * A spool cut from a data file, and everything needed to write it
+ * into its own file without the data file
+*/
+typedef struct Segment {
+    /// The spool (closed once written)
+    int spool;
+    /// The spool's path
+    char *spool_path;
+    /// The length of the spool (bytes)
+    off_t spooled;
+    /// The number of records in the spool
+    uint32_t num_records;
+    /// The number of values of each channel in the spool
+    uint32_t num_vals[RECORD_MAX_ENTRIES];
+    /// The number of channels
+    int num_entries;
+    /// The channels (the data file's, which outlive the segment)
+    const RecordChannel *channels;
+    /// The length of each sample (bytes)
+    uint32_t sample_size;
+    /// Whether the spool holds blocks (see gorilla.h), not records
+    bool compressed;
+    /// The path to write the segment to (its series file, if compressed)
+    char *path;
+    /// The run index to add the run to (-1 for none)
+    int index;
+    /// The run's line in the index
+    char line[INDEX_LINE_LEN];
+    /// The next segment to write
+    struct Segment *next;
+} Segment;
+
+/**
+ * @brief Sample Ring
+ * 
+ * A single-producer/single-consumer ring of samples: the producer
+ * only writes head, and the consumer only writes tail
+*/
+typedef struct {
+    /// The queued samples
+    char samples[RECORD_RING_LEN][RECORD_MAX_SAMPLE];
+    /// The length of each sample (bytes)
+    uint32_t sample_size;
+    /// The next slot to write (written by the producer)
+    uint32_t head;
+    /// The next slot to read (written by the consumer)
+    uint32_t tail;
+    /// Samples dropped on a full ring (written by the producer)
+    uint32_t overflows;
+    /// The sample marked by the last RecordTrigger()
+    uint32_t trigger_at;
+    /// The number of RecordTrigger() calls (stored after trigger_at)
+    uint32_t triggers;
+    /// The last samples drained, not the dropped ones (written by the
+    /// consumer, in DrainHelper())
+    FlightLog flight;
+} SampleRing;
+
 
 /* Internal File Tracking Variables */
 
@@ -65,6 +251,43 @@ static DataFile_t *files = NULL;
 static int num_files = 0;
 /// The number of files this module can handle
 static int capacity_files = 0;
+/// Guards files (and the data files), but never the rings
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+/// The sample ring of each file (allocated with the file, never moved)
+static SampleRing *rings[RECORD_MAX_FILES];
+/// The number of flight log copies saved by RecordFlightSave()
+static int num_flight_saves;
+
+
+/* Recorder Thread & Resources */
+
+
+/// Recorder Thread ID
+static pthread_t recorder_thread;
+/// Recorder Thread Resources
+static ThreadResource recorder_resource;
+/// Local Error Code
+static int error;
+
+
+/* Segment Writer Thread & Resources */
+
+
+/// Segment Writer Thread ID
+static pthread_t writer_thread;
+/// Segment Writer Thread Attributes (the default policy, below every
+/// real-time task, as it may write for seconds)
+static ThreadAttributes writer_attributes = {0, RECORDER_CPU, 0, NULL};
+/// Whether the segment writer is running
+static bool writer_running = false;
+/// The segments to write, oldest first
+static Segment *segments = NULL;
+/// The number of segments that could not be written
+static int segment_failures = 0;
+/// Guards the segment writer's variables
+static pthread_mutex_t segments_lock = PTHREAD_MUTEX_INITIALIZER;
+/// Signals a segment to write (or the writer to stop)
+static pthread_cond_t segments_ready = PTHREAD_COND_INITIALIZER;
 
 
 /* Static Helper Functions */
@@ -76,166 +299,1501 @@ static int capacity_files = 0;
 static inline void DeallocateHelper();
 
 /**
- * Reallocates the entry_values for a DataFile_t
+ * Frees a data file and its ring
+ * 
+ * @param file A pointer to the DataFile_t (its pointers NULL if unset)
+ * @param ring The file's SampleRing
+*/
+static inline void FreeHelper(DataFile_t *file, SampleRing *ring);
+
+/**
+ * Undoes a data file that failed to open: frees it and its ring, and
+ * removes its spool
+ * 
+ * @param file A pointer to the DataFile_t (its pointers NULL if unset)
+ * @param ring The file's SampleRing
+ * 
+ * @return -1
+*/
+static inline FileID_t DiscardHelper(DataFile_t *file, SampleRing *ring);
+
+/**
+ * Checks that a file is open, without files_lock
+ * 
+ * @param file The FileID_t
+ * 
+ * @return Whether file is open
+*/
+static inline bool OpenedHelper(FileID_t file);
+
+/**
+ * Writes a DataFile_t's unspooled records to its spool
+ * 
+ * @param f A pointer to the DataFile_t to flush
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @post f's chunk is empty
+*/
+static inline int SpoolHelper(DataFile_t *f);
+
+/**
+ * Finds a channel by name
+ * 
+ * @param f A pointer to the DataFile_t
+ * @param name The channel's name
+ * 
+ * @return The channel's index, or -1 if there is none
+*/
+static inline int FindHelper(DataFile_t *f, const char *name);
+
+/**
+ * Starts a capture window: records the samples in history, and keeps
+ * the next post samples
+ * 
+ * @param f A pointer to the DataFile_t
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held
+*/
+static inline int TriggerHelper(DataFile_t *f);
+
+/**
+ * Forgets the samples in history, recording their decimated channels
+ * 
+ * @param f A pointer to the DataFile_t
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held
+*/
+static inline int ForgetHelper(DataFile_t *f);
+
+/**
+ * Writes a sample's recorded channels to the chunk
+ * 
+ * @param f A pointer to the DataFile_t to record upon
+ * @param index The sample's index
+ * @param sample The sample (sample_size bytes)
+ * @param decimated Whether to write only the decimated channels (for a
+ * sample outside any capture window)
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held
+*/
+static inline int StoreHelper(DataFile_t *f,
+                              uint32_t index,
+                              const char *sample,
+                              bool decimated);
+
+/**
+ * Encodes a sample's recorded channels, spooling each full block
+ * 
+ * @param f A pointer to the compressed DataFile_t to record upon
+ * @param index The sample's index
+ * @param sample The sample (sample_size bytes)
+ * @param decimated Whether to encode only the decimated channels
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held
+*/
+static inline int EncodeHelper(DataFile_t *f,
+                               uint32_t index,
+                               const char *sample,
+                               bool decimated);
+
+/**
+ * Frames a column's block into the chunk, and starts its next block
+ * 
+ * @param f A pointer to the compressed DataFile_t
+ * @param column The column's index (num_entries for the indices)
+ * 
+ * @return 0 iff success, negative upon error
+*/
+static inline int BlockHelper(DataFile_t *f, int column);
+
+/**
+ * Writes the series file's header to a compressed file's empty chunk,
+ * to lead its spool
+ * 
+ * @param f A pointer to the compressed DataFile_t
+*/
+static inline void SeriesHeaderHelper(DataFile_t *f);
+
+/**
+ * Writes the spool's header to an uncompressed file's empty chunk, to
+ * lead its spool
+ * 
+ * @param f A pointer to the uncompressed DataFile_t
+*/
+static inline void SpoolHeaderHelper(DataFile_t *f);
+
+/**
+ * Reads a channel's value from a sample
+ * 
+ * @param channel The channel
+ * @param sample The sample
+ * 
+ * @return The channel's value
+*/
+static inline double ValueHelper(const RecordChannel *channel,
+                                 const char *sample);
+
+/**
+ * Records every sample queued in a file's ring
+ * 
+ * @param file The FileID_t to drain
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held
+*/
+static inline int DrainHelper(FileID_t file);
+
+/**
+ * Moves a DataFile_t's spool (after spooling the rest of its records)
+ * into a Segment
+ * 
+ * @param f A pointer to the DataFile_t
+ * @param segment A return parameter, which becomes the spool's
+ * Segment (with no path, and no index)
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @post f has no spool, and no records
+*/
+static inline int DetachHelper(DataFile_t *f, Segment *segment);
+
+/**
+ * Cuts a DataFile_t's run into a Segment, and starts the next run
+ * 
+ * @param f A pointer to the DataFile_t
+ * @param run The run's ID
+ * @param segment A return parameter, which becomes the run's Segment
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @pre files_lock is held, and f's ring is drained
+*/
+static inline int SegmentHelper(DataFile_t *f, int run, Segment *segment);
+
+/**
+ * Writes a Segment into its own file, adds it to its run index, and
+ * frees it
+ * 
+ * @param segment A pointer to the Segment
+ * 
+ * @return 0 iff success, negative upon error
+*/
+static inline int WriteHelper(Segment *segment);
+
+/**
+ * Takes the oldest segment to write
+ * 
+ * @param wait Whether to wait for one while the writer is running
+ * 
+ * @return The Segment, or NULL if there is none
+*/
+static inline Segment *PopHelper(bool wait);
+
+/**
+ * @brief Segment Writer Thread Function
+ * 
+ * Writes each segment as it is cut, until stopped and none are left
+ * 
+ * @param arg Unused
+ * 
+ * @return NULL
+*/
+static void *WriterThread(void *arg);
+
+/**
+ * Writes a column's buffered values to the MAT file
+ * 
+ * @param mat The MAT file
+ * @param data The offset of the column's values in the MAT file
+ * @param size The size of each value (bytes)
+ * @param values The buffered values
+ * @param count The number of buffered values
+ * @param written The number of values written before, which is
+ * updated
+ * 
+ * @return 0 iff success, negative upon error
+*/
+static inline int ColumnHelper(MatStream *mat,
+                               off_t data,
+                               uint32_t size,
+                               const char *values,
+                               uint32_t count,
+                               uint32_t *written);
+
+/**
+ * Writes a Segment's samples into a MAT file, and closes it
+ * 
+ * @param segment A pointer to the Segment to close
+ * @param mat The MAT file (NULL for none, if the Segment is
+ * compressed)
+ * 
+ * @return 0 iff success, negative upon error
+ * 
+ * @post Each entry is a row vector of its recorded values (of its
+ * channel's type) in the MAT file, as is "sample_index" of the index
+ * of each sample recorded, and the spool is removed (or, if the
+ * Segment is compressed, renamed to its path)
+*/
+static inline int CloseHelper(Segment *segment, MatStream *mat);
+
+/**
+ * Opens a data file
+ * 
+ * @param name The name of the file
+ * @param channels The sample's members
+ * @param num_channels The number of channels
+ * @param sample_size The size of each sample (bytes)
+ * @param expected_duration The expected recording time (s)
+ * 
+ * @return The file ID upon success, or -1 upon failure (with nothing
+ * left allocated)
+ * 
+ * @pre files_lock is held
+*/
+static inline FileID_t OpenHelper(char *name,
+                                  const RecordChannel channels[],
+                                  int num_channels,
+                                  uint32_t sample_size,
+                                  double expected_duration);
+
+/**
+ * Records a sample, as the file's settings select
  * 
- * @param f A pointer to the DataFile_t to resize
+ * Checks the triggers, and either records the sample or keeps it in
+ * the history for the next capture window
+ * 
+ * @param f A pointer to the DataFile_t to record upon
+ * @param ring The file's SampleRing (for its RecordTrigger() calls)
+ * @param sample The sample (sample_size bytes)
  * 
  * @return 0 iff success, negative upon error
  * 
- * @post for all 0 <= i <= f->num_entries, 
- * f->entry_values[i] is now double its capacity
- * from before, if, at the beginning of this function,
- * f->num_vals == f->vals->capacity
+ * @pre files_lock is held
+*/
+static inline int AppendHelper(DataFile_t *f,
+                               SampleRing *ring,
+                               const char *sample);
+
+/**
+ * @brief Recorder Thread Function
+ * 
+ * Drains the sample rings at every release
+ * 
+ * @param resource A pointer to the recorder's ThreadResource
+ * 
+ * @return NULL
 */
-static inline int ReallocateHelper(DataFile_t *f);
+static void *RecorderThread(void *resource);
 
 
 /* Function Definitions */
 
 
-FileID_t OpenDataFile(char *name, char **entry_names, int num_entries) {
-    // Make sure there's space for another file
-    if (files == NULL) {
-        files = (DataFile_t *) malloc(DEFAULT_NUM_FILES * sizeof(DataFile_t));
-        if (files == NULL) {
-            return EXIT_FAILURE;
-        }
-        capacity_files = DEFAULT_NUM_FILES;
-    } else if (num_files == capacity_files) {
-    	capacity_files *= DEFAULT_RESIZE_FACTOR;
-        files = (DataFile_t *) realloc(files,
-            capacity_files * sizeof(DataFile_t));
-        if (files == NULL) {
-            DeallocateHelper();
-            return EXIT_FAILURE;
+FileID_t OpenDataFile(char *name,
+                      const RecordChannel channels[],
+                      int num_channels,
+                      uint32_t sample_size,
+                      double expected_duration) {
+    FileID_t id;
+    int i;
+    if (num_channels < 1 || num_channels > RECORD_MAX_ENTRIES ||
+        sample_size > RECORD_MAX_SAMPLE) {
+        return -1;
+    }
+    for (i = 0; i < num_channels; i++) {
+        if (channels[i].offset + MatTypeSize(channels[i].type)
+            > sample_size) {
+            return -1;
         }
     }
 
-    if (num_entries < 1) {
+    pthread_mutex_lock(&files_lock);
+    id = OpenHelper(name, channels, num_channels, sample_size,
+                    expected_duration);
+    pthread_mutex_unlock(&files_lock);
+    return id;
+}
+
+int RecordData(FileID_t file, const void *sample) {
+    int err;
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    err = AppendHelper(&(files[file]), rings[file],
+                       (const char *) sample);
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
+
+int RecordSample(FileID_t file, const void *sample) {
+    SampleRing *ring;
+    uint32_t head;
+
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    ring = rings[file];
+    head = ring->head;
+    if (head - __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE)
+        == RECORD_RING_LEN) {
+        __atomic_store_n(&(ring->overflows), ring->overflows + 1,
+                         __ATOMIC_RELAXED);
         return EXIT_FAILURE;
     }
+    memcpy(ring->samples[head % RECORD_RING_LEN], sample,
+           ring->sample_size);
+    // Publish the sample
+    __atomic_store_n(&(ring->head), head + 1, __ATOMIC_RELEASE);
+    return EXIT_SUCCESS;
+}
 
-    // Copy the names into an allocated buffer
-    char **entry_names_ = (char **) malloc(num_entries * sizeof(char *));
-    if (entry_names == NULL) {
-        return EXIT_FAILURE;
+void RecordTrigger(FileID_t file) {
+    SampleRing *ring;
+    uint32_t head;
+
+    if (!OpenedHelper(file)) return;
+    ring = rings[file];
+    head = __atomic_load_n(&(ring->head), __ATOMIC_RELAXED);
+    // Mark the last queued sample
+    __atomic_store_n(&(ring->trigger_at), head - (head > 0),
+                     __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(ring->triggers), 1, __ATOMIC_RELEASE);
+}
+
+int RecordSetChannel(FileID_t file,
+                     const char *name,
+                     bool enabled,
+                     uint32_t decimation) {
+    DataFile_t *f;
+    int err = EXIT_SUCCESS;
+    int j;
+    if (decimation == 0 || !OpenedHelper(file)) return EXIT_FAILURE;
+
+    pthread_mutex_lock(&files_lock);
+    f = files + file;
+    j = name != NULL ? FindHelper(f, name) : 0;
+    if (j < 0) {
+        err = EXIT_FAILURE;
+    } else {
+        int last = name != NULL ? j : f->num_entries - 1;
+        for (; j <= last; j++) {
+            f->state[j].enabled = enabled;
+            f->state[j].decimation = decimation;
+        }
     }
-    int i;
-    for (i = 0; i < num_entries; i++) {
-        int str_len = strlen(entry_names[i]) + 1;
-        char *copy_name = (char *) malloc(str_len * sizeof(char));
-        if (copy_name == NULL) {
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
+
+int RecordSetTrigger(FileID_t file, const char *name, double threshold) {
+    int j;
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    j = FindHelper(files + file, name);
+    if (j >= 0) {
+        files[file].state[j].threshold = fabs(threshold);
+    }
+    pthread_mutex_unlock(&files_lock);
+    return j >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int RecordSetCapture(FileID_t file, uint32_t pre, uint32_t post) {
+    DataFile_t *f;
+    char *history = NULL;
+    uint32_t *history_index = NULL;
+
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    // Allocate outside the lock, so that the recorder is not held up
+    if (pre > 0) {
+        history = (char *) malloc((size_t) pre * RECORD_MAX_SAMPLE);
+        history_index = (uint32_t *) malloc(pre * sizeof(uint32_t));
+        if (history == NULL || history_index == NULL) {
+            free(history);
+            free(history_index);
             return EXIT_FAILURE;
         }
-        snprintf(copy_name, str_len, entry_names[i]);
-        entry_names_[i] = copy_name;
+        memset(history, 0, (size_t) pre * RECORD_MAX_SAMPLE);
     }
 
-    // Create data recorders
-    double **entry_values_ = (double **) malloc(num_entries * sizeof(double *));
-    if (entry_values_ == NULL) {
+    pthread_mutex_lock(&files_lock);
+    f = files + file;
+    if (f->pre > 0 && ForgetHelper(f)) {
+        pthread_mutex_unlock(&files_lock);
+        free(history);
+        free(history_index);
         return EXIT_FAILURE;
     }
-    for (i = 0; i < num_entries; i++) {
-        double *temp = (double *) malloc(DEFAULT_NUM_VALS * sizeof(double));
-        if (temp == NULL) {
+    free(f->history);
+    free(f->history_index);
+    f->history = history;
+    f->history_index = history_index;
+    f->history_len = 0;
+    f->history_next = 0;
+    f->post_left = 0;
+    f->pre = pre;
+    f->post = post;
+    pthread_mutex_unlock(&files_lock);
+    return EXIT_SUCCESS;
+}
+
+int RecordSetCompression(FileID_t file, bool compressed) {
+    DataFile_t *f;
+    int err = EXIT_SUCCESS;
+    int j;
+
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    f = files + file;
+    if (f->num_samples > 0) {
+        err = EXIT_FAILURE;
+    } else if (!compressed) {
+        for (j = 0; f->series != NULL && j <= f->num_entries; j++) {
+            GorillaFree(f->series + j);
+        }
+        free(f->series);
+        f->series = NULL;
+        SpoolHeaderHelper(f);
+    } else if (f->series == NULL) {
+        f->series = (GorillaEncoder *) calloc(f->num_entries + 1,
+                                              sizeof(GorillaEncoder));
+        if (f->series == NULL) {
+            pthread_mutex_unlock(&files_lock);
             return EXIT_FAILURE;
         }
-        entry_values_[i] = temp;
+        for (j = 0; j <= f->num_entries && !err; j++) {
+            err = GorillaInit(f->series + j, j < f->num_entries ?
+                              f->channels[j].type : MAT_INT32,
+                              CHUNK_SAMPLES);
+        }
+        if (!err) {
+            SeriesHeaderHelper(f);
+        }
     }
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
 
-    DataFile_t *file = files + num_files;
-
-    int err;
-    file->file = openmatfile(name, &err);
-    file->num_entries = num_entries;
-    file->entry_names = entry_names_;
-    file->num_vals = 0;
-    file->vals_capacity = DEFAULT_NUM_VALS;
-    file->entry_values = entry_values_;
-    return num_files++;
+int RecordSetMetric(FileID_t file, const char *name) {
+    int j;
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    j = FindHelper(files + file, name);
+    if (j >= 0) {
+        files[file].state[j].metric = true;
+    }
+    pthread_mutex_unlock(&files_lock);
+    return j >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-int RecordData(FileID_t file, double data[], int data_length) {
-    DataFile_t *f = &(files[file]);
+int RecordEndRun(FileID_t file, int run) {
+    Segment *segment;
+    Segment **last;
+    int err;
 
-    if (ReallocateHelper(f)) {
-        DeallocateHelper();
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    segment = (Segment *) malloc(sizeof(Segment));
+    if (segment == NULL) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    err = DrainHelper(file);
+    // A window's lead-up does not reach back into the last run
+    if (!err && files[file].pre > 0) {
+        err = ForgetHelper(files + file);
+    }
+    if (!err) {
+        err = SegmentHelper(files + file, run, segment);
+    }
+    pthread_mutex_unlock(&files_lock);
+    if (err) {
+        free(segment);
         return EXIT_FAILURE;
     }
 
-    int i;
-    for (i = 0; i < f->num_entries; i++) {
-        f->entry_values[i][f->num_vals] = data[i];
+    // Queue the segment for the writer, or write it now without one
+    pthread_mutex_lock(&segments_lock);
+    if (writer_running) {
+        for (last = &segments; *last != NULL; last = &((*last)->next)) {}
+        *last = segment;
+        pthread_cond_signal(&segments_ready);
+        segment = NULL;
     }
-    f->num_vals++;
-
-    return EXIT_SUCCESS;
+    pthread_mutex_unlock(&segments_lock);
+    return segment != NULL ? WriteHelper(segment) : EXIT_SUCCESS;
 }
 
-int RecordValue(FileID_t file, char *value_name, double value) {
-    DataFile_t *f = &(files[file]);
-    matfile_addmatrix(f->file,
-                      value_name,
-                      &value,
-                      1,
-                      1,
-                      0);
-    return EXIT_SUCCESS;
+uint32_t RecordOverflows(FileID_t file) {
+    if (!OpenedHelper(file)) return 0;
+    return __atomic_load_n(&(rings[file]->overflows), __ATOMIC_RELAXED);
 }
 
-int SaveDataFiles() {
-    DataFile_t *file;
+int RecordDrain() {
     int err = EXIT_SUCCESS;
-    for (file = files; file < files + num_files; file++) {
-        int j;
-        for (j = 0; j < file->num_entries; j++) {
-            matfile_addmatrix(file->file,
-                              file->entry_names[j],
-                              file->entry_values[j],
-                              1,
-                              file->num_vals,
-                              0);
-        }
-        if (matfile_close(file->file)) {
-            err = EXIT_FAILURE;
-        }
-    }
+    int i;
 
-    DeallocateHelper();
+    pthread_mutex_lock(&files_lock);
+    for (i = 0; i < num_files && !err; i++) {
+        err = DrainHelper(i);
+    }
+    pthread_mutex_unlock(&files_lock);
     return err;
 }
 
-
-/* Static Helper Functions */
-
-
-static inline int ReallocateHelper(DataFile_t *f) {
-    if (f->vals_capacity == f->num_vals) {
-        int i;
-        f->vals_capacity *= DEFAULT_RESIZE_FACTOR;
-        for (i = 0; i < f->num_entries; i++) {
-            f->entry_values[i] = (double *) realloc(f->entry_values[i],
-                f->vals_capacity * sizeof(double));
-            if (f->entry_values[i] == NULL) {
-                return EXIT_FAILURE;
-            }
-        }
-    }
+int RecorderFork() {
+    REGISTER_TASK(recorder_resource, RECORDER_PERIOD, RECORDER_PHASE,
+                  RECORDER_PRIORITY, RECORDER_CPU);
+    START_THREAD(recorder_thread, RecorderThread, recorder_resource);
+    writer_running = true;
+    VERIFY(error, ThreadCreate(&writer_thread, WriterThread, NULL,
+                               &writer_attributes));
     return EXIT_SUCCESS;
 }
 
-static inline void DeallocateHelper() {
-    int j;
-    DataFile_t *file = files;
+int RecorderJoin() {
+    int i;
+    STOP_THREAD(recorder_thread, recorder_resource);
+    UNREGISTER_TASK(recorder_resource);
+    // Let the writer finish the segments already cut
+    pthread_mutex_lock(&segments_lock);
+    writer_running = false;
+    pthread_cond_signal(&segments_ready);
+    pthread_mutex_unlock(&segments_lock);
+    VERIFY(error, pthread_join(writer_thread, NULL));
+    for (i = 0; i < num_files; i++) {
+        if (RecordOverflows(i)) {
+            printf("data file %d: %u sample(s) dropped\n",
+                   i, RecordOverflows(i));
+        }
+    }
+    return RecordDrain();
+}
 
+int RecordFlightSave() {
+    char path[256];
+    int err = EXIT_SUCCESS;
+    int i;
+
+    pthread_mutex_lock(&files_lock);
+    num_flight_saves++;
+    for (i = 0; i < num_files; i++) {
+        snprintf(path, sizeof(path), "%s.%d",
+                 files[i].flight_path, num_flight_saves);
+        // The samples still queued, up to the fault
+        if (DrainHelper(i)) {
+            err = EXIT_FAILURE;
+        }
+        if (FlightLogSync(&(rings[i]->flight)) ||
+            FlightLogCopy(&(rings[i]->flight), path)) {
+            err = EXIT_FAILURE;
+        }
+    }
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
+
+int RecordValue(FileID_t file, char *value_name, double value) {
+    return RecordVector(file, value_name, &value, 1);
+}
+
+int RecordVector(FileID_t file, char *value_name, double values[], int length) {
+    int err;
+    if (!OpenedHelper(file)) return EXIT_FAILURE;
+    pthread_mutex_lock(&files_lock);
+    err = MatStreamAddMatrix(&(files[file].mat), value_name, values,
+                             1, length);
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
+
+int RecordThreadStats(FileID_t file, int run, ThreadResource *resource) {
+    double summary[THREAD_STATS_LEN];
+    char name[32];
+    snprintf(name, sizeof(name), "timing_%d", run);
+    ThreadStatsSummary(resource, summary);
+    return RecordVector(file, name, summary, THREAD_STATS_LEN);
+}
+
+int SaveDataFiles() {
+    DataFile_t *file;
+    Segment *segment;
+    int err = RecordDrain();
+    int i;
+    for (i = 0; i < num_files; i++) {
+        RecordValue(i, "overflows", RecordOverflows(i));
+    }
+
+    // Any segments the writer left
+    while ((segment = PopHelper(false)) != NULL) {
+        WriteHelper(segment);
+    }
+    if (segment_failures > 0) {
+        err = EXIT_FAILURE;
+    }
+
+    pthread_mutex_lock(&files_lock);
     for (file = files; file < files + num_files; file++) {
-        for (j = 0; j < file->num_entries; j++) {
-            free(file->entry_names[j]);
-            free(file->entry_values[j]);
+        Segment rest;
+        if ((file->pre > 0 && ForgetHelper(file)) ||
+            DetachHelper(file, &rest)) {
+            err = EXIT_FAILURE;
+            continue;
+        }
+        rest.path = file->series_path;
+        if (file->runs > 0 && rest.num_records == 0) {
+            // Every sample is in a run's segment
+            close(rest.spool);
+            unlink(rest.spool_path);
+            free(rest.spool_path);
+            if (MatStreamClose(&(file->mat))) {
+                err = EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (CloseHelper(&rest, &(file->mat))) {
+            err = EXIT_FAILURE;
+        }
+        free(rest.spool_path);
+    }
+
+    DeallocateHelper();
+    pthread_mutex_unlock(&files_lock);
+    return err;
+}
+
+
+/* Static Helper Functions */
+
+
+static inline FileID_t OpenHelper(char *name,
+                                  const RecordChannel channels[],
+                                  int num_channels,
+                                  uint32_t sample_size,
+                                  double expected_duration) {
+    if (num_files == RECORD_MAX_FILES) {
+        return -1;
+    }
+
+    // Make sure there's space for another file
+    if (files == NULL) {
+        files = (DataFile_t *) malloc(DEFAULT_NUM_FILES * sizeof(DataFile_t));
+        if (files == NULL) {
+            return -1;
+        }
+        capacity_files = DEFAULT_NUM_FILES;
+    } else if (num_files == capacity_files) {
+        DataFile_t *grown = (DataFile_t *) realloc(files,
+            capacity_files * DEFAULT_RESIZE_FACTOR * sizeof(DataFile_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        files = grown;
+        capacity_files *= DEFAULT_RESIZE_FACTOR;
+    }
+
+    // Create the sample ring, with its samples on cache line boundaries
+    SampleRing *ring;
+    if (posix_memalign((void **) &ring, CACHE_LINE, sizeof(SampleRing))) {
+        return -1;
+    }
+    memset(ring, 0, sizeof(SampleRing));
+    ring->sample_size = sample_size;
+
+    DataFile_t *file = files + num_files;
+    memset(file, 0, sizeof(DataFile_t));
+    file->sample_size = sample_size;
+    file->spool = -1;
+    file->index = -1;
+
+    // Copy the channels (and their names) into an allocated buffer
+    file->channels = (RecordChannel *) calloc(num_channels,
+                                              sizeof(RecordChannel));
+    if (file->channels == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    file->num_entries = num_channels;
+    int i;
+    for (i = 0; i < num_channels; i++) {
+        int str_len = strlen(channels[i].name) + 1;
+        char *copy_name = (char *) malloc(str_len * sizeof(char));
+        if (copy_name == NULL) {
+            return DiscardHelper(file, ring);
+        }
+        snprintf(copy_name, str_len, "%s", channels[i].name);
+        file->channels[i] = channels[i];
+        file->channels[i].name = copy_name;
+    }
+
+    // Record every channel at every sample, until told otherwise
+    file->state = (ChannelState *) calloc(num_channels, sizeof(ChannelState));
+    if (file->state == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    for (i = 0; i < num_channels; i++) {
+        file->state[i].enabled = true;
+        file->state[i].decimation = 1;
+    }
+
+    // Allocate (and fault in) the chunk
+    file->chunk_capacity = CHUNK_SAMPLES * (RECORD_HEADER_LEN + sample_size);
+    if (posix_memalign((void **) &(file->chunk), CACHE_LINE,
+                       file->chunk_capacity)) {
+        file->chunk = NULL;
+        return DiscardHelper(file, ring);
+    }
+    memset(file->chunk, 0, file->chunk_capacity);
+
+    // Open the spool, and reserve its storage for the expected duration
+    int path_len = strlen(name) + sizeof(".spool");
+    file->spool_path = (char *) malloc(path_len);
+    if (file->spool_path == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    snprintf(file->spool_path, path_len, "%s.spool", name);
+    file->spool = open(file->spool_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file->spool < 0) {
+        return DiscardHelper(file, ring);
+    }
+    SpoolHeaderHelper(file);
+    off_t expected = (off_t) (expected_duration / BTI_S)
+                     * (RECORD_HEADER_LEN + sample_size);
+    if (expected > 0) {
+        posix_fallocate(file->spool, 0, expected);
+    }
+
+    // Open the flight log, named as the data file with a .flight extension
+    char *extension = strrchr(name, '.');
+    int stem_len = extension != NULL ? (int) (extension - name)
+                                     : (int) strlen(name);
+    path_len = stem_len + sizeof(".flight");
+    file->flight_path = (char *) malloc(path_len);
+    if (file->flight_path == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    snprintf(file->flight_path, path_len, "%.*s.flight", stem_len, name);
+    path_len = stem_len + sizeof(".series");
+    file->series_path = (char *) malloc(path_len);
+    if (file->series_path == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    snprintf(file->series_path, path_len, "%.*s.series", stem_len, name);
+    file->stem = (char *) malloc(stem_len + 1);
+    if (file->stem == NULL) {
+        return DiscardHelper(file, ring);
+    }
+    snprintf(file->stem, stem_len + 1, "%.*s", stem_len, name);
+    // Pad its samples to a power of two within a cache line, or to
+    // whole cache lines, so that each touches as few lines as it can
+    uint32_t pad = 1;
+    while (pad < sample_size && pad < CACHE_LINE) {
+        pad *= 2;
+    }
+    if (FlightLogOpen(&(ring->flight), file->flight_path, num_channels,
+                      sample_size, (sample_size + pad - 1) / pad * pad,
+                      RECORD_FLIGHT_SECONDS * 1000u / BTI_MS)) {
+        return DiscardHelper(file, ring);
+    }
+    for (i = 0; i < num_channels; i++) {
+        FlightLogSetEntry(&(ring->flight), i, channels[i].name,
+                          channels[i].type, channels[i].offset);
+    }
+
+    if (MatStreamOpen(&(file->mat), name)) {
+        return DiscardHelper(file, ring);
+    }
+    // Publish the ring last: a file is open once its ring is
+    __atomic_store_n(rings + num_files, ring, __ATOMIC_RELEASE);
+    return num_files++;
+}
+
+static inline bool OpenedHelper(FileID_t file) {
+    return file >= 0 && file < RECORD_MAX_FILES &&
+           __atomic_load_n(rings + file, __ATOMIC_ACQUIRE) != NULL;
+}
+
+static inline FileID_t DiscardHelper(DataFile_t *file, SampleRing *ring) {
+    if (file->spool >= 0) {
+        close(file->spool);
+        unlink(file->spool_path);
+    }
+    FreeHelper(file, ring);
+    return -1;
+}
+
+static inline void FreeHelper(DataFile_t *file, SampleRing *ring) {
+    int j;
+    for (j = 0; file->channels != NULL && j < file->num_entries; j++) {
+        free((char *) file->channels[j].name);
+    }
+    free(file->channels);
+    free(file->state);
+    free(file->history);
+    free(file->history_index);
+    free(file->chunk);
+    free(file->spool_path);
+    free(file->flight_path);
+    for (j = 0; file->series != NULL && j <= file->num_entries; j++) {
+        GorillaFree(file->series + j);
+    }
+    free(file->series);
+    free(file->series_path);
+    free(file->stem);
+    if (file->index >= 0) {
+        close(file->index);
+    }
+    FlightLogClose(&(ring->flight));
+    free(ring);
+}
+
+static inline int AppendHelper(DataFile_t *f,
+                               SampleRing *ring,
+                               const char *sample) {
+    uint32_t index = f->num_samples++;
+    bool triggered = false;
+    bool late = false;
+    int j;
+
+    // The run's metrics, over every sample
+    for (j = 0; j < f->num_entries; j++) {
+        double value;
+        if (!f->state[j].metric) continue;
+        value = fabs(ValueHelper(f->channels + j, sample));
+        f->state[j].sum_sq += value * value;
+        if (value > f->state[j].peak) f->state[j].peak = value;
+    }
+
+    // Record continuously, unless capturing windows
+    if (f->pre == 0 && f->post == 0) {
+        return StoreHelper(f, index, sample, false);
+    }
+
+    if (f->triggers != __atomic_load_n(&(ring->triggers), __ATOMIC_ACQUIRE)
+        && (int32_t) (index - ring->trigger_at) >= 0) {
+        f->triggers = ring->triggers;
+        triggered = true;
+        late = index != ring->trigger_at;
+    }
+    for (j = 0; j < f->num_entries && !triggered; j++) {
+        if (f->state[j].threshold == 0.0) continue;
+        triggered = fabs(ValueHelper(f->channels + j, sample))
+                    >= f->state[j].threshold;
+    }
+
+    if (triggered) {
+        if (TriggerHelper(f)) return EXIT_FAILURE;
+        // This sample opens the window, unless it follows the marked one
+        if (!late) f->post_left++;
+    }
+    if (f->post_left > 0) {
+        f->post_left--;
+        return StoreHelper(f, index, sample, false);
+    }
+    // Outside the windows, the decimated channels are still recorded, as
+    // each sample leaves history (so that the indices stay in order)
+    if (f->pre == 0) {
+        return StoreHelper(f, index, sample, true);
+    }
+    if (f->history_len == f->pre &&
+        StoreHelper(f, f->history_index[f->history_next],
+                    f->history + f->history_next * f->sample_size, true)) {
+        return EXIT_FAILURE;
+    }
+    memcpy(f->history + f->history_next * f->sample_size,
+           sample, f->sample_size);
+    f->history_index[f->history_next] = index;
+    f->history_next = (f->history_next + 1) % f->pre;
+    if (f->history_len < f->pre) f->history_len++;
+    return EXIT_SUCCESS;
+}
+
+static inline int TriggerHelper(DataFile_t *f) {
+    uint32_t k;
+    // The lead-up, oldest first
+    for (k = 0; k < f->history_len; k++) {
+        uint32_t slot = (f->history_next + f->pre - f->history_len + k)
+                        % f->pre;
+        if (StoreHelper(f, f->history_index[slot],
+                        f->history + slot * f->sample_size, false)) {
+            return EXIT_FAILURE;
+        }
+    }
+    f->history_len = 0;
+    f->post_left = f->post;
+    return EXIT_SUCCESS;
+}
+
+static inline int ForgetHelper(DataFile_t *f) {
+    uint32_t k;
+    // Oldest first
+    for (k = 0; k < f->history_len; k++) {
+        uint32_t slot = (f->history_next + f->pre - f->history_len + k)
+                        % f->pre;
+        if (StoreHelper(f, f->history_index[slot],
+                        f->history + slot * f->sample_size, true)) {
+            return EXIT_FAILURE;
+        }
+    }
+    f->history_len = 0;
+    return EXIT_SUCCESS;
+}
+
+static inline int StoreHelper(DataFile_t *f,
+                              uint32_t index,
+                              const char *sample,
+                              bool decimated) {
+    char *record;
+    uint32_t mask = 0;
+    uint32_t length = RECORD_HEADER_LEN;
+    int j;
+
+    if (f->series != NULL) {
+        return EncodeHelper(f, index, sample, decimated);
+    }
+    if (f->chunk_len + RECORD_HEADER_LEN + f->sample_size > f->chunk_capacity
+        && SpoolHelper(f)) {
+        return EXIT_FAILURE;
+    }
+    record = f->chunk + f->chunk_len;
+    for (j = 0; j < f->num_entries; j++) {
+        ChannelState *state = f->state + j;
+        uint32_t size = MatTypeSize(f->channels[j].type);
+        if (!state->enabled || index % state->decimation ||
+            (decimated && state->decimation == 1)) {
+            continue;
+        }
+        memcpy(record + length, sample + f->channels[j].offset, size);
+        length += size;
+        mask |= 1u << j;
+        state->num_vals++;
+    }
+    if (mask == 0) return EXIT_SUCCESS;
+
+    memcpy(record, &index, sizeof(index));
+    memcpy(record + sizeof(index), &mask, sizeof(mask));
+    f->chunk_len += length;
+    f->num_records++;
+    return EXIT_SUCCESS;
+}
+
+static inline int EncodeHelper(DataFile_t *f,
+                               uint32_t index,
+                               const char *sample,
+                               bool decimated) {
+    bool recorded = false;
+    int j;
+
+    for (j = 0; j < f->num_entries; j++) {
+        ChannelState *state = f->state + j;
+        if (!state->enabled || index % state->decimation ||
+            (decimated && state->decimation == 1)) {
+            continue;
+        }
+        GorillaPut(f->series + j, sample + f->channels[j].offset);
+        state->num_vals++;
+        recorded = true;
+        if (f->series[j].count == CHUNK_SAMPLES && BlockHelper(f, j)) {
+            return EXIT_FAILURE;
         }
-        free(file->entry_names);
-        free(file->entry_values);
+    }
+    if (!recorded) return EXIT_SUCCESS;
+
+    GorillaPut(f->series + f->num_entries, &index);
+    f->num_records++;
+    if (f->series[f->num_entries].count == CHUNK_SAMPLES) {
+        return BlockHelper(f, f->num_entries);
+    }
+    return EXIT_SUCCESS;
+}
+
+static inline int BlockHelper(DataFile_t *f, int column) {
+    GorillaEncoder *encoder = f->series + column;
+    GorillaFrame frame;
+
+    if (encoder->count == 0) return EXIT_SUCCESS;
+    frame.column = column;
+    frame.count = encoder->count;
+    frame.length = GorillaLength(encoder);
+    if (f->chunk_len + sizeof(frame) + frame.length > f->chunk_capacity
+        && SpoolHelper(f)) {
+        return EXIT_FAILURE;
+    }
+    memcpy(f->chunk + f->chunk_len, &frame, sizeof(frame));
+    memcpy(f->chunk + f->chunk_len + sizeof(frame), encoder->block,
+           frame.length);
+    f->chunk_len += sizeof(frame) + frame.length;
+    GorillaReset(encoder);
+    return EXIT_SUCCESS;
+}
+
+static inline double ValueHelper(const RecordChannel *channel,
+                                 const char *sample) {
+    double value;
+    if (channel->type == MAT_INT32) {
+        int32_t v;
+        memcpy(&v, sample + channel->offset, sizeof(v));
+        value = v;
+    } else if (channel->type == MAT_SINGLE) {
+        float v;
+        memcpy(&v, sample + channel->offset, sizeof(v));
+        value = v;
+    } else {
+        memcpy(&value, sample + channel->offset, sizeof(value));
+    }
+    return value;
+}
+
+static inline void SeriesHeaderHelper(DataFile_t *f) {
+    GorillaHeader header;
+    int j;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GORILLA_MAGIC, sizeof(header.magic));
+    header.version = GORILLA_VERSION;
+    header.num_columns = f->num_entries + 1;
+    header.block_values = CHUNK_SAMPLES;
+    for (j = 0; j <= f->num_entries; j++) {
+        strncpy(header.names[j], j < f->num_entries ? f->channels[j].name
+                                                    : "sample_index",
+                GORILLA_NAME_LEN - 1);
+        header.types[j] = f->series[j].type;
+    }
+    // The series file's header leads the spool (over the other header,
+    // if that was spooled already)
+    memcpy(f->chunk, &header, sizeof(header));
+    f->chunk_len = sizeof(header);
+    f->spooled = 0;
+    f->synced = 0;
+}
+
+static inline void SpoolHeaderHelper(DataFile_t *f) {
+    SpoolHeader header;
+    int j;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SPOOL_MAGIC, sizeof(header.magic));
+    header.version = SPOOL_VERSION;
+    header.header_size = sizeof(header);
+    header.num_channels = f->num_entries;
+    for (j = 0; j < f->num_entries; j++) {
+        strncpy(header.names[j], f->channels[j].name, SPOOL_NAME_LEN - 1);
+        header.types[j] = f->channels[j].type;
+    }
+    // The spool's header leads it (over the other header, if that was
+    // spooled already), so that a spool left by a crash can be read
+    memcpy(f->chunk, &header, sizeof(header));
+    f->chunk_len = sizeof(header);
+    f->spooled = 0;
+    f->synced = 0;
+}
+
+static inline int FindHelper(DataFile_t *f, const char *name) {
+    int j;
+    for (j = 0; j < f->num_entries; j++) {
+        if (strcmp(f->channels[j].name, name) == 0) return j;
+    }
+    return -1;
+}
+
+static void *RecorderThread(void *resource) {
+    ThreadResource *thread_resource = (ThreadResource *) resource;
+    while (thread_resource->irq_thread_rdy) {
+        uint32_t irq_assert = 0;
+        TASK_TRIGGER(irq_assert, thread_resource);
+        if (irq_assert && RecordDrain()) {
+            EXIT_THREAD();
+        }
+    }
+    EXIT_THREAD();
+}
+
+static inline int DrainHelper(FileID_t file) {
+    DataFile_t *f = files + file;
+    SampleRing *ring = rings[file];
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+    int err = EXIT_SUCCESS;
+
+    for (; tail != head; tail++) {
+        const char *sample = ring->samples[tail % RECORD_RING_LEN];
+        // Here, not in RecordSample(): a store into the shared mapping
+        // can fault, and wait on the filesystem, as the page is written
+        // back
+        FlightLogWrite(&(ring->flight), sample);
+        if (AppendHelper(f, ring, sample)) {
+            err = EXIT_FAILURE;
+            break;
+        }
+    }
+    // Free the slots
+    __atomic_store_n(&(ring->tail), tail, __ATOMIC_RELEASE);
+    // A trigger on a sample already handled opens its window now
+    if (!err && f->triggers !=
+        __atomic_load_n(&(ring->triggers), __ATOMIC_ACQUIRE) &&
+        (int32_t) (ring->trigger_at - f->num_samples) < 0) {
+        f->triggers = ring->triggers;
+        err = TriggerHelper(f);
+    }
+    if (err || SpoolHelper(f)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static inline int DetachHelper(DataFile_t *f, Segment *segment) {
+    int err = EXIT_SUCCESS;
+    int j;
+
+    // Spool the partial blocks too
+    for (j = 0; f->series != NULL && j <= f->num_entries && !err; j++) {
+        err = BlockHelper(f, j);
+    }
+    if (err || SpoolHelper(f)) {
+        return EXIT_FAILURE;
+    }
+
+    memset(segment, 0, sizeof(Segment));
+    segment->spool = f->spool;
+    segment->spool_path = f->spool_path;
+    segment->spooled = f->spooled;
+    segment->num_records = f->num_records;
+    for (j = 0; j < f->num_entries; j++) {
+        segment->num_vals[j] = f->state[j].num_vals;
+        f->state[j].num_vals = 0;
+    }
+    segment->num_entries = f->num_entries;
+    segment->channels = f->channels;
+    segment->sample_size = f->sample_size;
+    segment->compressed = f->series != NULL;
+    segment->index = -1;
+
+    f->spool = -1;
+    f->spool_path = NULL;
+    f->spooled = 0;
+    f->synced = 0;
+    f->num_records = 0;
+    return EXIT_SUCCESS;
+}
+
+static inline int SegmentHelper(DataFile_t *f, int run, Segment *segment) {
+    uint32_t samples = f->num_samples - f->run_start;
+    char *spool_path;
+    int path_len = strlen(f->stem) + 32;
+    int length;
+    int j;
+
+    // Start the index, with a column per metric
+    if (f->index < 0) {
+        char path[256];
+        char header[INDEX_LINE_LEN];
+        snprintf(path, sizeof(path), "%s-runs.csv", f->stem);
+        f->index = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (f->index < 0) return EXIT_FAILURE;
+        length = snprintf(header, sizeof(header),
+                          "run,segment,samples,duration_s");
+        for (j = 0; j < f->num_entries; j++) {
+            if (!f->state[j].metric) continue;
+            length += snprintf(header + length, sizeof(header) - length,
+                               ",%s_rms,%s_peak", f->channels[j].name,
+                               f->channels[j].name);
+        }
+        snprintf(header + length, sizeof(header) - length, "\n");
+        if (write(f->index, header, strlen(header)) < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (DetachHelper(f, segment)) return EXIT_FAILURE;
+    spool_path = segment->spool_path;
+    segment->index = f->index;
+    segment->path = (char *) malloc(path_len);
+    segment->spool_path = (char *) malloc(path_len + sizeof(".spool"));
+    if (segment->path == NULL || segment->spool_path == NULL) {
+        free(segment->path);
+        free(segment->spool_path);
+        close(segment->spool);
+        return EXIT_FAILURE;
+    }
+    snprintf(segment->path, path_len, "%s-run%d.%s", f->stem, run,
+             segment->compressed ? "series" : "mat");
+    snprintf(segment->spool_path, path_len + sizeof(".spool"), "%s.spool",
+             segment->path);
+
+    // The run's line, and the next run's metrics
+    length = snprintf(segment->line, INDEX_LINE_LEN, "%d,%s,%u,%.3f",
+                      run, segment->path, samples, samples * BTI_S);
+    for (j = 0; j < f->num_entries; j++) {
+        ChannelState *state = f->state + j;
+        if (!state->metric) continue;
+        if (length < INDEX_LINE_LEN) {
+            length += snprintf(segment->line + length,
+                               INDEX_LINE_LEN - length, ",%.6g,%.6g",
+                               samples > 0 ? sqrt(state->sum_sq / samples)
+                                           : 0.0,
+                               state->peak);
+        }
+        state->sum_sq = 0.0;
+        state->peak = 0.0;
+    }
+    if (length < INDEX_LINE_LEN) {
+        snprintf(segment->line + length, INDEX_LINE_LEN - length, "\n");
+    }
+    f->run_start = f->num_samples;
+    f->runs++;
+
+    // Hand the spool over under the segment's name, and start another
+    f->spool_path = spool_path;
+    if (rename(f->spool_path, segment->spool_path)) {
+        close(segment->spool);
+        free(segment->path);
+        free(segment->spool_path);
+        return EXIT_FAILURE;
+    }
+    f->spool = open(f->spool_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->spool < 0) {
+        return EXIT_FAILURE;
+    }
+    if (f->series != NULL) {
+        SeriesHeaderHelper(f);
+    } else {
+        SpoolHeaderHelper(f);
+    }
+    return EXIT_SUCCESS;
+}
+
+static inline int WriteHelper(Segment *segment) {
+    MatStream mat;
+    int err;
+
+    if (segment->compressed) {
+        err = CloseHelper(segment, NULL);
+    } else if (MatStreamOpen(&mat, segment->path)) {
+        close(segment->spool);
+        err = EXIT_FAILURE;
+    } else {
+        err = CloseHelper(segment, &mat);
+    }
+    // List the run once its segment is whole
+    if (!err && segment->index >= 0 &&
+        (write(segment->index, segment->line, strlen(segment->line)) < 0 ||
+         fdatasync(segment->index))) {
+        err = EXIT_FAILURE;
+    }
+    if (err) {
+        printf("%s: could not be written\n", segment->path);
+        pthread_mutex_lock(&segments_lock);
+        segment_failures++;
+        pthread_mutex_unlock(&segments_lock);
+    }
+    free(segment->spool_path);
+    free(segment->path);
+    free(segment);
+    return err;
+}
+
+static inline Segment *PopHelper(bool wait) {
+    Segment *segment;
+    pthread_mutex_lock(&segments_lock);
+    while (wait && segments == NULL && writer_running) {
+        pthread_cond_wait(&segments_ready, &segments_lock);
+    }
+    segment = segments;
+    if (segment != NULL) {
+        segments = segment->next;
+    }
+    pthread_mutex_unlock(&segments_lock);
+    return segment;
+}
+
+static void *WriterThread(void *arg) {
+    Segment *segment;
+    while ((segment = PopHelper(true)) != NULL) {
+        WriteHelper(segment);
+    }
+    EXIT_THREAD();
+}
+
+static inline int SpoolHelper(DataFile_t *f) {
+    size_t length = f->chunk_len;
+    const char *bytes = f->chunk;
+
+    while (length > 0) {
+        ssize_t written = pwrite(f->spool, bytes, length, f->spooled);
+        if (written <= 0) {
+            return EXIT_FAILURE;
+        }
+        bytes += written;
+        length -= written;
+        f->spooled += written;
+    }
+    f->chunk_len = 0;
+    // Reach the storage once per chunk's worth of records
+    if (f->spooled - f->synced >= (off_t) f->chunk_capacity) {
+        fdatasync(f->spool);
+        f->synced = f->spooled;
+    }
+    return EXIT_SUCCESS;
+}
+
+static inline int CloseHelper(Segment *segment, MatStream *mat) {
+    int columns = segment->num_entries + 1;  // and the samples' indices
+    size_t column_size = CHUNK_SAMPLES * MAX_CHANNEL_SIZE;
+    size_t buffer_len = CHUNK_SAMPLES
+                        * (RECORD_HEADER_LEN + segment->sample_size);
+    char *buffer = NULL;
+    char *values = NULL;
+    uint32_t counts[RECORD_MAX_ENTRIES + 1] = {0};
+    uint32_t written[RECORD_MAX_ENTRIES + 1] = {0};
+    uint32_t sizes[RECORD_MAX_ENTRIES + 1];
+    off_t data[RECORD_MAX_ENTRIES + 1];
+    off_t position = sizeof(SpoolHeader);  // past the spool's header
+    size_t have = 0;
+    int err = EXIT_SUCCESS;
+    int j;
+
+    if (segment->compressed) {
+        // Keep the spool (its blocks spooled) as the series file
+        if (ftruncate(segment->spool, segment->spooled) ||
+            fsync(segment->spool)) {
+            err = EXIT_FAILURE;
+        }
+        if (mat != NULL && MatStreamClose(mat)) {
+            err = EXIT_FAILURE;
+        }
+        close(segment->spool);
+        if (rename(segment->spool_path, segment->path)) {
+            err = EXIT_FAILURE;
+        }
+        return err;
+    }
+
+    // Write each entry's header, reserving its values
+    for (j = 0; j < segment->num_entries && !err; j++) {
+        sizes[j] = MatTypeSize(segment->channels[j].type);
+        err = MatStreamBeginMatrix(mat, segment->channels[j].name,
+                                   segment->channels[j].type, 1,
+                                   segment->num_vals[j], data + j);
+    }
+    sizes[segment->num_entries] = sizeof(uint32_t);
+    if (!err) {
+        err = MatStreamBeginMatrix(mat, "sample_index", MAT_INT32,
+                                   1, segment->num_records,
+                                   data + segment->num_entries);
+    }
+
+    // The records, a chunk at a time, and each column's values
+    if (!err) {
+        buffer = (char *) malloc(buffer_len);
+        values = (char *) malloc(columns * column_size);
+        if (buffer == NULL || values == NULL) {
+            err = EXIT_FAILURE;
+        }
+    }
+
+    // Sort the spool's records into the columns
+    while (!err && (position < segment->spooled || have > 0)) {
+        size_t length = buffer_len - have;
+        const char *record = buffer;
+        const char *end;
+        if ((off_t) length > segment->spooled - position) {
+            length = segment->spooled - position;
+        }
+        if (pread(segment->spool, buffer + have, length, position)
+            != (ssize_t) length) {
+            err = EXIT_FAILURE;
+            break;
+        }
+        position += length;
+        have += length;
+        end = buffer + have;
+
+        while (end - record >= RECORD_HEADER_LEN) {
+            const char *value = record + RECORD_HEADER_LEN;
+            uint32_t mask;
+            memcpy(&mask, record + sizeof(uint32_t), sizeof(mask));
+            for (j = 0; j < segment->num_entries; j++) {
+                if (mask & (1u << j)) {
+                    value += sizes[j];
+                }
+            }
+            if (value > end) break;
+
+            // The index, then the channels' values
+            value = record + RECORD_HEADER_LEN;
+            memcpy(values + segment->num_entries * column_size
+                   + counts[segment->num_entries]++ * sizeof(uint32_t),
+                   record, sizeof(uint32_t));
+            for (j = 0; j < segment->num_entries; j++) {
+                if (!(mask & (1u << j))) continue;
+                memcpy(values + j * column_size + counts[j]++ * sizes[j],
+                       value, sizes[j]);
+                value += sizes[j];
+            }
+            record = value;
+
+            // Write each full column
+            for (j = 0; j < columns && !err; j++) {
+                if (counts[j] == CHUNK_SAMPLES) {
+                    err = ColumnHelper(mat, data[j], sizes[j],
+                                       values + j * column_size,
+                                       counts[j], written + j);
+                    counts[j] = 0;
+                }
+            }
+        }
+
+        // Keep the partial record for the next read
+        if (length == 0 && record == buffer) {
+            // The spool ends mid-record
+            break;
+        }
+        have = end - record;
+        memmove(buffer, record, have);
+    }
+
+    // Write the rest of each column
+    for (j = 0; j < columns && !err; j++) {
+        if (counts[j] > 0) {
+            err = ColumnHelper(mat, data[j], sizes[j],
+                               values + j * column_size,
+                               counts[j], written + j);
+        }
+    }
+    free(values);
+    free(buffer);
+
+    if (MatStreamClose(mat)) {
+        err = EXIT_FAILURE;
+    }
+    close(segment->spool);
+    // Keep the spool if the MAT file is incomplete
+    if (!err) {
+        unlink(segment->spool_path);
+    }
+    return err;
+}
+
+static inline int ColumnHelper(MatStream *mat,
+                               off_t data,
+                               uint32_t size,
+                               const char *values,
+                               uint32_t count,
+                               uint32_t *written) {
+    int err = MatStreamWriteValues(mat, data + (off_t) *written * size,
+                                   values, (size_t) count * size);
+    *written += count;
+    return err;
+}
+
+static inline void DeallocateHelper() {
+    int i;
+
+    for (i = 0; i < num_files; i++) {
+        FreeHelper(files + i, rings[i]);
+        rings[i] = NULL;
     }
     if (files != NULL) {
         free(files);
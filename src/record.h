@@ -8,35 +8,312 @@
  * 
  * @copyright Copyright (c) 2024
  * 
+ * A data file's samples are structs, described by a RecordChannel per
+ * member, so that each entry keeps its type (int32, single or double)
+ * from the control code to the MAT file.
+ * 
+ * Each channel can be switched off or decimated, and a file can keep
+ * only the samples around triggers (a threshold on a channel, or
+ * RecordTrigger()), at any time while recording.
+ * 
+ * Real-time threads record with RecordSample(), which only copies the
+ * sample into the file's single-producer/single-consumer ring. The
+ * recorder task drains the rings into the data files (which allocate
+ * as they grow) from outside the control path.
+ * 
+ * The recorder task also keeps the last RECORD_FLIGHT_SECONDS of every
+ * file in a memory-mapped flight log (see flight-log.h), which
+ * survives a crash, up to the last drain (a crash loses at most the
+ * samples of the last RECORDER_PERIOD); RecordFlightSave() keeps a copy
+ * of it.
+ * 
+ * A file may instead keep its samples compressed (see
+ * RecordSetCompression()), encoded by the recorder task.
+ * 
+ * RecordEndRun() writes each run to a segment file of its own, in the
+ * background, and lists it in the file's run index, so that one run
+ * loads without the rest of the session.
  */
 
 #ifndef RECORD_H_
 #define RECORD_H_
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "discrete-lib.h"
+#include "thread-lib.h"
+#include "mat-stream.h"
+
 /// A File
 typedef int FileID_t;
 
+/**
+ * @brief A Recorded Channel (a member of a data file's samples)
+*/
+typedef struct {
+    const char *name;  ///< the entry's name in the data file
+    MatType type;  ///< the member's type
+    uint32_t offset;  ///< the member's offset in the sample (bytes)
+} RecordChannel;
+
+/**
+ * Describes a member of a sample struct as a RecordChannel
+ * 
+ * @param name The entry's name in the data file
+ * @param sample_type The sample struct's type
+ * @param member The member (may be nested, e.g. x.voltage)
+ * @param type The member's MatType
+*/
+#define RECORD_CHANNEL(name, sample_type, member, type) \
+    {(name), (type), offsetof(sample_type, member)}
+
+/// The MatType of a Real
+#ifdef SINGLE_PRECISION
+#define MAT_REAL MAT_SINGLE
+#else
+#define MAT_REAL MAT_DOUBLE
+#endif
+
+
+/* Sample Ring Constants */
+
+
+/// The maximum number of data files
+#define RECORD_MAX_FILES 8
+/// The maximum number of entries in a sample
+#define RECORD_MAX_ENTRIES 32
+/// The maximum length of a sample (bytes)
+#define RECORD_MAX_SAMPLE (RECORD_MAX_ENTRIES * 8)
+/// Samples each ring holds (1.28 s at 5 ms, a power of two)
+#define RECORD_RING_LEN 256u
+
+
+/* Flight Log Constants */
+
+
+/// Time each flight log holds (s, at one sample per base tick)
+#define RECORD_FLIGHT_SECONDS 10u
+
+
+/* Recording Functions */
+
+
 /**
  * Opens a data file
  * 
+ * Reserves spool storage for the expected duration up front; a longer
+ * recording still fits, as the spool grows on disk, not in memory
+ * 
  * @param name The name of the file
- * @param entry_names The name of each entry
- * @param num_entries The number of entries
+ * @param channels The sample's members, in the order to record them
+ * @param num_channels The number of channels (at most RECORD_MAX_ENTRIES)
+ * @param sample_size The size of each sample, i.e. sizeof(the struct)
+ * (at most RECORD_MAX_SAMPLE)
+ * @param expected_duration The expected recording time (s), at one
+ * sample per base tick
+ * 
+ * @return The file ID upon success, or negative upon failure (which
+ * every other function rejects)
+*/
+FileID_t OpenDataFile(char *name,
+                      const RecordChannel channels[],
+                      int num_channels,
+                      uint32_t sample_size,
+                      double expected_duration);
+
+/**
+ * Records a sample
+ * 
+ * Writes to the data file, so real-time threads use RecordSample()
+ * instead
  * 
- * @return The file ID upon success, or negative upon failure
+ * @param file The FileID_t to record upon
+ * @param sample The sample (copied verbatim)
+ * 
+ * @return 0 iff success, negative upon failure
 */
-FileID_t OpenDataFile(char *name, char **entry_names, int num_entries);
+int RecordData(FileID_t file, const void *sample);
 
 /**
- * Records data for each entry
+ * Queues a sample, for the recorder task to record
+ * 
+ * Wait-free: never blocks, allocates, or touches the data file, so it
+ * is safe in the control path. Only one thread may queue into a file.
  * 
  * @param file The FileID_t to record upon
- * @param data The array of data to record (in order of the entries)
- * @param data_length The length of the data array
+ * @param sample The sample (copied verbatim)
+ * 
+ * @return 0 iff success, EXIT_FAILURE if the ring is full (the sample
+ * is dropped, and counted in RecordOverflows())
+*/
+int RecordSample(FileID_t file, const void *sample);
+
+/**
+ * Triggers a capture window at the last sample queued
+ * 
+ * Wait-free, and safe from any thread. Has no effect unless the file
+ * captures windows (see RecordSetCapture()).
+ * 
+ * @param file The FileID_t
+*/
+void RecordTrigger(FileID_t file);
+
+/**
+ * Switches a channel on or off, and sets its decimation
+ * 
+ * A channel records the samples whose index its decimation divides,
+ * so that its values line up with "sample_index" (every recorded
+ * sample's index) as long as its decimation is not changed. A
+ * decimated channel (decimation > 1) records them inside and outside
+ * capture windows alike (see RecordSetCapture()).
+ * 
+ * @param file The FileID_t
+ * @param name The channel's name, or NULL for every channel
+ * @param enabled Whether to record the channel
+ * @param decimation Record every decimation-th sample (> 0)
+ * 
+ * @return 0 iff success, EXIT_FAILURE if there is no such channel
+*/
+int RecordSetChannel(FileID_t file,
+                     const char *name,
+                     bool enabled,
+                     uint32_t decimation);
+
+/**
+ * Sets the magnitude of a channel that triggers a capture window
+ * 
+ * @param file The FileID_t
+ * @param name The channel's name
+ * @param threshold The magnitude at which to trigger (0 for never)
+ * 
+ * @return 0 iff success, EXIT_FAILURE if there is no such channel
+*/
+int RecordSetTrigger(FileID_t file, const char *name, double threshold);
+
+/**
+ * Sets the capture window around each trigger
+ * 
+ * With a window, a file records only each triggering sample, with
+ * the pre samples before and the post samples after it; triggers
+ * within a window extend it. Without one (pre and post 0), every sample is
+ * recorded. Either way, decimated channels are recorded at every
+ * sample their decimation divides, so that they stay a regular series.
+ * A window's lead-up does not reach back past RecordEndRun().
+ * 
+ * @param file The FileID_t
+ * @param pre The samples to keep before each trigger
+ * @param post The samples to keep after each trigger
  * 
  * @return 0 iff success, negative upon failure
+ * 
+ * @post The samples kept for the last window are forgotten
 */
-int RecordData(FileID_t file, double data[], int data_length);
+int RecordSetCapture(FileID_t file, uint32_t pre, uint32_t post);
+
+/**
+ * Sets whether a file's samples are compressed
+ * 
+ * A compressed file keeps its channels (and "sample_index") in a
+ * series file (<name> with a .series extension, see gorilla.h) instead
+ * of its MAT file, which keeps only the one-time values.
+ * tools/unpack.c expands the two back into one MAT file.
+ * 
+ * @param file The FileID_t
+ * @param compressed Whether to compress the samples
+ * 
+ * @return 0 iff success, negative upon failure
+ * 
+ * @pre No sample has been recorded upon the file
+*/
+int RecordSetCompression(FileID_t file, bool compressed);
+
+/**
+ * Adds a channel's RMS and peak magnitude over each run to the run
+ * index (see RecordEndRun())
+ * 
+ * @param file The FileID_t
+ * @param name The channel's name
+ * 
+ * @return 0 iff success, EXIT_FAILURE if there is no such channel
+ * 
+ * @pre No run has ended, as the index's columns are then fixed
+*/
+int RecordSetMetric(FileID_t file, const char *name);
+
+/**
+ * Ends a run: its samples go to a segment file of its own
+ * 
+ * Records the queued samples, and cuts the file's spool there; the
+ * segment writer thread (or this call, if it is not running) writes
+ * the cut into <name>-run<run>.mat (.series if compressed, see
+ * RecordSetCompression()), and then adds a line to the run index,
+ * <name>-runs.csv: the run, its segment, its samples and duration (s),
+ * and each metric channel's RMS and peak (see RecordSetMetric()).
+ * 
+ * The one-time values stay in the data file, as do any samples after
+ * the last run.
+ * 
+ * @param file The FileID_t
+ * @param run The run's ID
+ * 
+ * @return 0 iff success, negative upon failure
+ * 
+ * @pre No thread is queueing into the file (the run's thread has
+ * stopped)
+*/
+int RecordEndRun(FileID_t file, int run);
+
+/**
+ * Counts the samples dropped by RecordSample() on a full ring
+ * 
+ * @param file The FileID_t
+ * 
+ * @return The number of dropped samples
+*/
+uint32_t RecordOverflows(FileID_t file);
+
+/**
+ * Records every queued sample
+ * 
+ * @return 0 iff success, negative upon failure
+*/
+int RecordDrain();
+
+/**
+ * Starts the recorder task, which drains the sample rings, and the
+ * segment writer thread
+ * 
+ * @return 0 iff success, negative upon failure
+ * 
+ * @pre The dispatcher is running
+*/
+int RecorderFork();
+
+/**
+ * Stops the recorder task, and the segment writer thread
+ * 
+ * Prints any dropped samples
+ * 
+ * @return 0 iff success, negative upon failure
+ * 
+ * @post Every queued sample is recorded, and every run ended is
+ * written
+*/
+int RecorderJoin();
+
+/**
+ * Saves a copy of every flight log, once every queued sample is in it
+ * 
+ * Each copy is named as its flight log, with ".<n>" appended for the
+ * n-th save, so that later runs do not overwrite it
+ * 
+ * @return 0 iff success, negative upon failure
+ * 
+ * @pre No thread is recording, so that the copies are consistent
+*/
+int RecordFlightSave();
 
 /**
  * Records one-time data
@@ -49,9 +326,38 @@ int RecordData(FileID_t file, double data[], int data_length);
 */
 int RecordValue(FileID_t file, char *value_name, double value);
 
+/**
+ * Records one-time data as a row vector
+ * 
+ * @param file The FileID_t to record upon
+ * @param value_name The name of the vector
+ * @param values The values to record
+ * @param length The number of values
+ * 
+ * @return 0 iff success, negative upon failure
+*/
+int RecordVector(FileID_t file, char *value_name, double values[], int length);
+
+/**
+ * Records a thread's timing statistics (see ThreadStatsSummary())
+ * 
+ * @param file The FileID_t to record upon
+ * @param run The run's ID (the vector is named "timing_<run>")
+ * @param resource The thread's ThreadResource
+ * 
+ * @return 0 iff success, negative upon failure
+*/
+int RecordThreadStats(FileID_t file, int run, ThreadResource *resource);
+
 /**
  * Records all data into actual files, and closes all files
  * 
+ * Drains the sample rings first, and records each file's dropped
+ * samples as "overflows". Until then, a file's samples are only in its
+ * spool (<name>.spool, see spool.h): if the process dies first,
+ * tools/unpack.c recovers them from it (before the file is opened
+ * again, which replaces the spool).
+ * 
  * @return 0 iff success, negative upon failure
 */
 int SaveDataFiles();
@@ -12,12 +12,12 @@
 
 #include <stdlib.h>
 
-#include "MyRio.h"
-#include "T1.h"
-
 #include "record.h"
 #include "io.h"
+#include "thread-lib.h"
+#include "dispatcher.h"
 #include "error.h"
+#include "hal.h"
 
 #include "setup.h"
 
@@ -34,15 +34,21 @@ int u_error;
 
 int Setup() {
     u_error = 0;
-    if (MyRio_IsNotSuccess(MyRio_Open())) return EXIT_FAILURE;
+    if (hal->open()) return EXIT_FAILURE;
+    VERIFY(error, LockMemory());
     VERIFY(error, IOSetup());
+    VERIFY(error, DispatcherFork());
+    VERIFY(error, RecorderFork());
     // VERIFY(error, EncoderFork());
     return EXIT_SUCCESS;
 }
 
 int Shutdown() {
+    VERIFY(error, RecorderJoin());
+    VERIFY(error, DispatcherJoin());
     VERIFY(error, IOShutdown());
     VERIFY(error, SaveDataFiles());
     // VERIFY(error, EncoderJoin());
-    return MyRio_Close();
+    VERIFY(error, UnlockMemory());
+    return hal->close();
 }
@@ -0,0 +1,60 @@
+/**
+ * @file spool.h
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Spool File Layout Header
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * A data file's samples are spooled (to <name> with a .spool extension)
+ * until the data file closes, and then transposed into its columns. A
+ * spool is a SpoolHeader, then one record per kept sample, one after
+ * another: the sample's index and a mask of the channels recorded
+ * (uint32 each), then those channels' values, in order (native byte
+ * order). A record's mask is never 0, so the storage reserved past the
+ * last record (which reads as zeros) ends the records. A spool left by
+ * a crash is expanded with tools/unpack.c.
+ */
+
+#ifndef SPOOL_H_
+#define SPOOL_H_
+
+#include <stdint.h>
+
+
+/* Spool File Constants */
+
+
+/// Identifies a spool
+#define SPOOL_MAGIC "ASSPOOLS"
+/// The layout's version
+#define SPOOL_VERSION 1u
+/// The most channels a spool holds (one per bit of a record's mask)
+#define SPOOL_MAX_CHANNELS 32
+/// The longest channel name (bytes, with the terminator)
+#define SPOOL_NAME_LEN 32
+/// The length of a record's index and mask (bytes)
+#define SPOOL_RECORD_HEADER_LEN 8
+
+
+/* Spool Data Structures */
+
+
+/**
+ * @brief A Spool's Header (at the start of its file)
+*/
+typedef struct {
+    char magic[8];  ///< SPOOL_MAGIC (without a terminator)
+    uint32_t version;  ///< SPOOL_VERSION
+    uint32_t header_size;  ///< offset of the first record (bytes)
+    uint32_t num_channels;  ///< channels in each record's mask
+    uint32_t reserved;  ///< zero
+    /// The channels' names (zero-padded)
+    char names[SPOOL_MAX_CHANNELS][SPOOL_NAME_LEN];
+    /// The channels' types (MatType)
+    uint32_t types[SPOOL_MAX_CHANNELS];
+} SpoolHeader;
+
+#endif  // SPOOL_H_
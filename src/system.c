@@ -13,15 +13,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-#include "MyRio.h"
-#include "T1.h"
-
 #include "thread-lib.h"
 #include "setup.h"
 #include "anti-sway.h"
 #include "tracking.h"
 #include "idle.h"
 #include "io.h"
+#include "record.h"
+#include "hal.h"
 #include "error.h"
 
 #include "system.h"
@@ -192,12 +191,10 @@ static int MenuState() {
     while (!('1' <= (key = getchar_keypad()) && key <= '4')) {}
     switch (key) {
         case '1':
-            TrackingFork();
-            state = TRACKING;
+            state = TrackingFork() ? ERROR : TRACKING;
             break;
         case '2':
-            AntiSwayFork();
-            state = ANTI_SWAY;
+            state = AntiSwayFork() ? ERROR : ANTI_SWAY;
             break;
         case '3':
             IdleFork();
@@ -216,18 +213,22 @@ static int MenuState() {
 }
 
 static int ErrorState() {
-    SetXVoltage(0.0);
-    SetYVoltage(0.0);
+    SetVoltages(0.0, 0.0);
     if (u_error == ENKWN) {
         printf_lcd("\fAn unknown error has occurred. Exiting Program...\n");
         state = END;
         Shutdown();
         return EXIT_FAILURE;
-    } else if (u_error == EOTBD || u_error == EVTYE || u_error == EENCR) {
+    } else if (u_error == EOTBD || u_error == EVTYE || u_error == EENCR ||
+               u_error == EFILE) {
+        // Keep the lead-up (the mode's thread has stopped)
+        if (u_error != EFILE) RecordFlightSave();
         if (u_error == EOTBD) {
             printf_lcd("\fError: Positional Limit Exceeded");
         } else if (u_error == EVTYE) {
             printf_lcd("\fError: Velocity Limit Exceeded..");
+        } else if (u_error == EFILE) {
+            printf_lcd("\fError: Cannot open a data file..");
         } else {
         	printf_lcd("\fError: An encoder(s) has failed..");
         }
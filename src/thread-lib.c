@@ -0,0 +1,313 @@
+/**
+ * @file thread-lib.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen
+ * @brief Thread Library (Real-Time Attributes)
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ */
+
+// For CPU affinity (pthread_attr_setaffinity_np)
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "error.h"
+
+#include "thread-lib.h"
+
+
+/* Timing Constants */
+
+
+#ifdef HOST_TIMER
+/// A base tick of the host's clock (ns), as the dispatcher releases
+#define BTI_NS (BTI_US * 1000u / HOST_TIME_SCALE)
+#else
+/// A base tick (ns)
+#define BTI_NS (BTI_US * 1000u)
+#endif
+
+
+/* Real-Time Setup Definitions */
+
+
+int LockMemory() {
+    volatile char *reserve;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t i;
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        printf("Cannot lock memory (%s): run as root, or raise "
+               "RLIMIT_MEMLOCK\n", strerror(errno));
+        return errno == EPERM || errno == ENOMEM ? ERTPR : ENKWN;
+    }
+
+    // Keep freed memory in the heap (where it is locked and faulted in),
+    // and serve large allocations from the heap rather than mmap()
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // Fault in the heap reserve, one write per page
+    reserve = malloc(HEAP_RESERVE_SIZE);
+    if (reserve == NULL) return ENKWN;
+    for (i = 0; i < HEAP_RESERVE_SIZE; i += page) reserve[i] = 0;
+    free((void *) reserve);
+
+    return EXIT_SUCCESS;
+}
+
+int UnlockMemory() {
+    return munlockall() ? ENKWN : EXIT_SUCCESS;
+}
+
+
+/* Timing Statistics Definitions */
+
+
+/**
+ * Finds the histogram bin of a duration
+ * 
+ * Durations below STATS_SUB_BINS have a bin each; above, each power
+ * of two is split into STATS_SUB_BINS bins by its next STATS_SUB_BITS
+ * bits
+ * 
+ * @param us The duration (us)
+ * 
+ * @return The bin's index
+*/
+static inline uint32_t HistogramBin(uint32_t us) {
+    const uint32_t limit = 1u << (STATS_SUB_BITS + STATS_OCTAVES - 1);
+    uint32_t exponent;
+    if (us < STATS_SUB_BINS) return us;
+    if (us >= limit) us = limit - 1;
+    exponent = 31 - __builtin_clz(us);
+    return (exponent - STATS_SUB_BITS + 1) * STATS_SUB_BINS
+           + ((us >> (exponent - STATS_SUB_BITS)) & (STATS_SUB_BINS - 1));
+}
+
+/**
+ * Finds the largest duration in a histogram bin
+ * 
+ * @param bin The bin's index
+ * 
+ * @return The bin's upper bound (us)
+*/
+static inline uint64_t HistogramBinMax(uint32_t bin) {
+    uint32_t exponent = bin / STATS_SUB_BINS + STATS_SUB_BITS - 1;
+    uint64_t width;
+    if (bin < STATS_SUB_BINS) return bin;
+    width = (uint64_t) 1 << (exponent - STATS_SUB_BITS);
+    return (STATS_SUB_BINS + bin % STATS_SUB_BINS) * width + width - 1;
+}
+
+/**
+ * Adds a duration to a histogram
+ * 
+ * Only one thread may add to a histogram; the stores are atomic so
+ * that others may read it at any time
+ * 
+ * @param histogram The histogram
+ * @param ns The duration (ns)
+*/
+static inline void HistogramAdd(Histogram *histogram, uint64_t ns) {
+    uint64_t us64 = ns / 1000u;
+    uint32_t us = us64 > UINT32_MAX ? UINT32_MAX : (uint32_t) us64;
+    uint32_t *bin = &(histogram->bins[HistogramBin(us)]);
+
+    __atomic_store_n(bin, *bin + 1, __ATOMIC_RELAXED);
+    if (histogram->count == 0 || us < histogram->min) {
+        __atomic_store_n(&(histogram->min), us, __ATOMIC_RELAXED);
+    }
+    if (us > histogram->max) {
+        __atomic_store_n(&(histogram->max), us, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&(histogram->sum_ns), histogram->sum_ns + ns,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&(histogram->count), histogram->count + 1,
+                     __ATOMIC_RELEASE);
+}
+
+#ifdef VIRTUAL_TIMER
+
+/// The Virtual Clock (ns)
+static uint64_t virtual_ns;
+
+uint64_t ThreadClockNs() {
+    return __atomic_load_n(&virtual_ns, __ATOMIC_ACQUIRE);
+}
+
+void ThreadClockAdvance(uint64_t ns) {
+    __atomic_add_fetch(&virtual_ns, ns, __ATOMIC_RELEASE);
+}
+
+#else
+
+uint64_t ThreadClockNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+#endif  // VIRTUAL_TIMER
+
+void ThreadStatsReset(ThreadStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void ThreadStatsWake(ThreadStats *stats) {
+    uint64_t now = ThreadClockNs();
+    if (stats->release_ns != 0 && now >= stats->release_ns) {
+        HistogramAdd(&(stats->latency), now - stats->release_ns);
+    }
+    if (stats->wake_ns != 0) {
+        HistogramAdd(&(stats->period), now - stats->wake_ns);
+    }
+    stats->wake_ns = now;
+}
+
+void ThreadStatsComplete(ThreadStats *stats, uint32_t period) {
+    uint64_t now;
+    // Not woken yet, or already completed since
+    if (stats->wake_ns == 0 || stats->complete_ns >= stats->wake_ns) return;
+
+    now = ThreadClockNs();
+    HistogramAdd(&(stats->compute), now - stats->wake_ns);
+    if (stats->release_ns != 0 &&
+        now - stats->release_ns > (uint64_t) period * BTI_NS) {
+        __atomic_store_n(&(stats->deadline_misses),
+                         stats->deadline_misses + 1, __ATOMIC_RELAXED);
+    }
+    stats->complete_ns = now;
+}
+
+uint32_t HistogramPercentile(Histogram *histogram, double percentile) {
+    uint32_t count = __atomic_load_n(&(histogram->count), __ATOMIC_ACQUIRE);
+    uint64_t rank, seen = 0, bound;
+    uint32_t i;
+    if (count == 0) return 0;
+
+    // The smallest duration with at least percentile% at or below it
+    rank = (uint64_t) (count * percentile / 100.0 + 0.999999);
+    if (rank == 0) rank = 1;
+    for (i = 0; i < STATS_BINS; i++) {
+        seen += histogram->bins[i];
+        if (seen >= rank) break;
+    }
+    bound = HistogramBinMax(i);
+    return bound > histogram->max ? histogram->max : (uint32_t) bound;
+}
+
+/**
+ * Summarizes a histogram
+ * 
+ * @param histogram The histogram
+ * @param summary A return parameter, which becomes the min, p50, p99,
+ * p99.9, max and mean (us)
+*/
+static void HistogramSummary(Histogram *histogram,
+                             double summary[HISTOGRAM_SUMMARY_LEN]) {
+    summary[0] = histogram->min;
+    summary[1] = HistogramPercentile(histogram, 50.0);
+    summary[2] = HistogramPercentile(histogram, 99.0);
+    summary[3] = HistogramPercentile(histogram, 99.9);
+    summary[4] = histogram->max;
+    summary[5] = histogram->count ?
+                 histogram->sum_ns / 1000.0 / histogram->count : 0.0;
+}
+
+void ThreadStatsSummary(ThreadResource *resource,
+                        double summary[THREAD_STATS_LEN]) {
+    ThreadStats *stats = &(resource->stats);
+    summary[0] = stats->period.count + (stats->wake_ns != 0);
+    HistogramSummary(&(stats->latency), summary + 1);
+    HistogramSummary(&(stats->compute), summary + 1 + HISTOGRAM_SUMMARY_LEN);
+    HistogramSummary(&(stats->period), summary + 1 + 2 * HISTOGRAM_SUMMARY_LEN);
+    summary[THREAD_STATS_LEN - 2] = resource->overruns;
+    summary[THREAD_STATS_LEN - 1] = stats->deadline_misses;
+}
+
+void ThreadStatsPrint(ThreadResource *resource) {
+    static const char *rows[] = {"latency", "compute", "period"};
+    Histogram *histograms[] = {&(resource->stats.latency),
+                               &(resource->stats.compute),
+                               &(resource->stats.period)};
+    double summary[THREAD_STATS_LEN];
+    int i;
+
+    ThreadStatsSummary(resource, summary);
+    printf("%s: %.0f release(s), %.0f overrun(s), %.0f deadline miss(es)\n",
+           resource->name, summary[0], summary[THREAD_STATS_LEN - 2],
+           summary[THREAD_STATS_LEN - 1]);
+    for (i = 0; i < 3; i++) {
+        double *row = summary + 1 + HISTOGRAM_SUMMARY_LEN * i;
+        if (histograms[i]->count == 0) continue;
+        printf("  %-8s min %6.0f  p50 %6.0f  p99 %6.0f  p99.9 %6.0f  "
+               "max %6.0f  mean %10.3f us\n",
+               rows[i], row[0], row[1], row[2], row[3], row[4], row[5]);
+    }
+}
+
+
+/* Thread Construction Definitions */
+
+
+int ThreadCreate(pthread_t *thread,
+                 void *(*function)(void *),
+                 void *arg,
+                 ThreadAttributes *attributes) {
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t cpus;
+    int result;
+
+    // Allocate and touch the stack once, so that (re)starting the
+    // thread never faults it in
+    if (attributes->stack == NULL) {
+        if (attributes->stack_size == 0) {
+            attributes->stack_size = THREAD_STACK_SIZE;
+        }
+        if (posix_memalign(&(attributes->stack), sysconf(_SC_PAGESIZE),
+                           attributes->stack_size)) {
+            attributes->stack = NULL;
+            return ENKWN;
+        }
+        memset(attributes->stack, 0, attributes->stack_size);
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, attributes->stack, attributes->stack_size);
+    if (attributes->priority > 0) {
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        param.sched_priority = attributes->priority;
+        pthread_attr_setschedparam(&attr, &param);
+    }
+    if (attributes->cpu != THREAD_ANY_CPU) {
+        // Wrap around, so that the same layout runs on fewer cores
+        CPU_ZERO(&cpus);
+        CPU_SET(attributes->cpu % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+
+    result = pthread_create(thread, &attr, function, arg);
+    pthread_attr_destroy(&attr);
+
+    if (result == EPERM) {
+        printf("Cannot start a SCHED_FIFO thread: run as root, or raise "
+               "RLIMIT_RTPRIO\n");
+        return ERTPR;
+    }
+    return result ? ENKWN : EXIT_SUCCESS;
+}
@@ -13,21 +13,105 @@
 #define THREAD_LIB_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <semaphore.h>
 
+#ifdef HOST_TIMER
+/// Stand-in for the FPGA's IRQ context (unused on a host)
+typedef void *NiFpga_IrqContext;
+/// Stand-in for the FPGA's boolean type
+typedef uint8_t NiFpga_Bool;
+#ifndef HOST_TIME_SCALE
+/// Base ticks per BTI_US of the host's clock (make sim SIM_SPEEDUP=n
+/// runs the simulated plant that many times faster than real time)
+#define HOST_TIME_SCALE 1u
+#endif
+#elif defined(VIRTUAL_TIMER)
+#error "The virtual clock (VIRTUAL_TIMER) needs the host timer (HOST_TIMER)"
+#else
 #include "MyRio.h"
 #include "AIO.h"
 #include "NiFpga.h"
 #include "DIIRQ.h"
 #include "TimerIRQ.h"
+#endif
 #include "io.h"
 
 #include "setup.h"
 
 
+/* Timing Statistics Constants */
+
+
+/// Histogram bins per power of two, log2 (within 1% above 128 us)
+#define STATS_SUB_BITS 7
+/// Histogram bins per power of two
+#define STATS_SUB_BINS (1u << STATS_SUB_BITS)
+/// Histogram powers of two (the last bin holds everything over 16 s)
+#define STATS_OCTAVES 18
+/// Histogram bins
+#define STATS_BINS (STATS_SUB_BINS * STATS_OCTAVES)
+/**
+ * @brief Timing Summary Length
+ * 
+ * The length of a ThreadStatsSummary(), which holds the number of
+ * releases, then the min, p50, p99, p99.9, max and mean (us) of the
+ * wake-up latency, compute time and period, then the overruns and
+ * deadline misses
+ */
+#define THREAD_STATS_LEN 21
+/// Values per histogram in a ThreadStatsSummary()
+#define HISTOGRAM_SUMMARY_LEN 6
+
+
 /* Thread Data Structures */
 
 
+/**
+ * @brief Real-Time Thread Attributes
+ * 
+ * How a thread is scheduled, where it runs, and its stack
+ */
+typedef struct {
+    int priority;  ///< SCHED_FIFO priority (0 for the default policy)
+    int cpu;  ///< core to pin the thread to (-1 for any)
+    size_t stack_size;  ///< stack size (0 for THREAD_STACK_SIZE)
+    void *stack;  ///< preallocated, pre-touched stack (set on first use)
+} ThreadAttributes;
+
+/**
+ * @brief A Timing Histogram
+ * 
+ * A log-linear histogram of durations in microseconds, with
+ * STATS_SUB_BINS bins per power of two (so each bin is within
+ * 1/STATS_SUB_BINS of its value), and the exact extremes
+ */
+typedef struct {
+    uint32_t bins[STATS_BINS];  ///< counts per bin
+    uint32_t count;  ///< number of durations
+    uint32_t min;  ///< shortest duration (us)
+    uint32_t max;  ///< longest duration (us)
+    uint64_t sum_ns;  ///< sum of durations (ns, for an exact mean)
+} Histogram;
+
+/**
+ * @brief Per-Thread Timing Statistics
+ * 
+ * Written only by the thread (and its release time only by the
+ * dispatcher, before releasing it), so no locks are needed
+ */
+typedef struct {
+    Histogram latency;  ///< release to wake-up (us)
+    Histogram compute;  ///< wake-up to completion (us)
+    Histogram period;  ///< wake-up to wake-up (us)
+    uint32_t deadline_misses;  ///< completions after the next release
+    uint64_t release_ns;  ///< last release time
+    uint64_t wake_ns;  ///< last wake-up time
+    uint64_t complete_ns;  ///< last completion time
+} ThreadStats;
+
 /**
  * @brief Parameter for Threading Functions
  * 
@@ -36,6 +120,14 @@
 typedef struct {
     NiFpga_IrqContext irq_context;  ///< context
     NiFpga_Bool irq_thread_rdy;  ///< stop signal
+    sem_t release;  ///< posted by the dispatcher at each release
+    const char *name;  ///< task name
+    uint32_t period;  ///< release period (base ticks)
+    uint32_t phase;  ///< release phase offset (base ticks)
+    ThreadAttributes attributes;  ///< scheduling, affinity and stack
+    ThreadStats stats;  ///< wake-up latency, compute time and period
+    volatile bool busy;  ///< the task is between release and wait
+    uint32_t overruns;  ///< releases missed while busy
 } ThreadResource;
 
 
@@ -65,12 +157,153 @@ typedef struct {
 #define m_st 0.664
 /// Mass of User (kg)
 #define m_p 0.765
+/// Natural Frequency of the Pendulum (rad/s)
+#define PENDULUM_FREQ sqrt(g / l)
+
+
+/* Thread Attribute Constants */
+
+
+/// Default Thread Stack Size (locked in memory, so keep it small)
+#define THREAD_STACK_SIZE (256u << 10)
+/// Any Core (no CPU affinity)
+#define THREAD_ANY_CPU -1
+/// Heap Reserve Size (faulted in and locked by LockMemory())
+#define HEAP_RESERVE_SIZE (4u << 20)
 
 
 /* MyRio Session */
 
+#ifndef HOST_TIMER
 /// The MyRio Session
 extern NiFpga_Session myrio_session;
+#endif
+
+
+/* Real-Time Setup */
+
+
+/**
+ * @brief Locks the process's memory
+ * 
+ * Locks all current and future pages into RAM, stops the heap from
+ * returning memory to the kernel, and faults in HEAP_RESERVE_SIZE of
+ * heap, so that the control threads never take a page fault
+ * 
+ * @return 0 upon success, ERTPR if the process lacks the privilege
+ * (root, CAP_IPC_LOCK, or a large enough RLIMIT_MEMLOCK), negative otherwise
+*/
+int LockMemory();
+
+/**
+ * @brief Unlocks the process's memory
+ * 
+ * @return 0 upon success, negative otherwise
+*/
+int UnlockMemory();
+
+/**
+ * @brief Creates a thread with real-time attributes
+ * 
+ * Creates a thread with attributes' priority (SCHED_FIFO), pinned to
+ * attributes' core, on a stack that is allocated and touched on
+ * the first call, and reused afterward
+ * 
+ * @param thread A return parameter, which becomes the thread's ID
+ * @param function The thread function
+ * @param arg The thread function's argument
+ * @param attributes The thread's attributes
+ * 
+ * @return 0 upon success, ERTPR if the process lacks the privilege
+ * (root, CAP_SYS_NICE, or a large enough RLIMIT_RTPRIO), negative otherwise
+ * 
+ * @pre Any earlier thread created with attributes has been joined
+*/
+int ThreadCreate(pthread_t *thread,
+                 void *(*function)(void *),
+                 void *arg,
+                 ThreadAttributes *attributes);
+
+
+/* Timing Statistics */
+
+
+/**
+ * @brief Reads the monotonic clock
+ * 
+ * With -DVIRTUAL_TIMER, reads the virtual clock instead, which only
+ * the dispatcher advances (one BTI_US per base tick, see
+ * DispatcherYield()), so that every time measured is the same in
+ * every run
+ * 
+ * @return The current time (ns)
+*/
+uint64_t ThreadClockNs();
+
+#ifdef VIRTUAL_TIMER
+/**
+ * @brief Advances the virtual clock
+ * 
+ * @param ns The time to advance it by (ns)
+*/
+void ThreadClockAdvance(uint64_t ns);
+#endif
+
+/**
+ * @brief Resets timing statistics
+ * 
+ * @param stats The statistics to reset
+*/
+void ThreadStatsReset(ThreadStats *stats);
+
+/**
+ * @brief Records a thread's wake-up
+ * 
+ * @param stats The thread's statistics
+ * 
+ * @pre stats->release_ns holds the time the thread was released
+ * @post The wake-up latency and period are recorded
+*/
+void ThreadStatsWake(ThreadStats *stats);
+
+/**
+ * @brief Records a thread's completion of its release
+ * 
+ * @param stats The thread's statistics
+ * @param period The thread's period (base ticks)
+ * 
+ * @post The compute time (and any deadline miss) is recorded,
+ * once per release
+*/
+void ThreadStatsComplete(ThreadStats *stats, uint32_t period);
+
+/**
+ * @brief Estimates a percentile of a histogram
+ * 
+ * @param histogram The histogram
+ * @param percentile The percentile (0 to 100)
+ * 
+ * @return An upper bound of the percentile (us), within
+ * 1/STATS_SUB_BINS of it
+*/
+uint32_t HistogramPercentile(Histogram *histogram, double percentile);
+
+/**
+ * @brief Summarizes a thread's timing statistics
+ * 
+ * @param resource The thread's ThreadResource
+ * @param summary A return parameter, which becomes the summary
+ * (see THREAD_STATS_LEN)
+*/
+void ThreadStatsSummary(ThreadResource *resource,
+                        double summary[THREAD_STATS_LEN]);
+
+/**
+ * @brief Prints a thread's timing statistics
+ * 
+ * @param resource The thread's ThreadResource
+*/
+void ThreadStatsPrint(ThreadResource *resource);
 
 
 /* Thread Construction/Destruction */
@@ -87,26 +320,34 @@ extern NiFpga_Session myrio_session;
  * 
  * @pre An integer variable named error must be declared in this context
  * @post thread will contain the new PID (Process ID) of the thread
- * @post A new thread that runs function will now be running concurrently
+ * @post A new thread that runs function will now be running concurrently,
+ * with resource's attributes
  * 
  * @return EXIT_FAILURE upon failure to initialize the thread
 */
 #define START_THREAD(thread, function, resource) \
     resource.irq_thread_rdy = true; \
-    VERIFY(error, pthread_create(&thread, NULL, function, &resource))
+    VERIFY(error, ThreadCreate(&thread, function, &resource, \
+                               &(resource.attributes)))
 
 /**
- * @brief Registers the global timer with a thread
+ * @brief Registers a thread as a periodic task
  * 
- * Registers the timer (global) with a particular thread (via its resource)
+ * Registers a thread (via its resource) with the dispatcher, which
+ * releases it every period base ticks
  * 
  * @param resource The ThreadResource associated with a thread
+ * @param period The release period, in base ticks (see TASK_PERIOD())
+ * @param phase The release phase offset, in base ticks
+ * @param priority The thread's SCHED_FIFO priority
+ * @param cpu The core to pin the thread to (or THREAD_ANY_CPU)
  * 
- * @pre No other thread is using the global timer
- * @post The thread associated with resource is now associated with the global timer
+ * @pre An integer variable named error must be declared in this context
+ * @post The thread associated with resource is now released periodically
 */
-#define REGISTER_TIMER(resource) \
-    Irq_RegisterTimerIrq(&timer, &(resource.irq_context), BTI_US)
+#define REGISTER_TASK(resource, period, phase, priority, cpu) \
+    VERIFY(error, DispatcherRegister(&(resource), #resource, \
+                                     period, phase, priority, cpu))
 
 /**
  * @brief Stops a thread in this process
@@ -121,42 +362,48 @@ extern NiFpga_Session myrio_session;
  * 
  * @pre The thread uses resource, and calls EXIT_THREAD() when
  * resource.irq_thread_rdy is set to false
+ * @pre resource is registered (so that a waiting thread is woken)
  * @post The thread associated with pthread_t is now done
 */
 #define STOP_THREAD(thread, resource) \
     resource.irq_thread_rdy = false; \
+    sem_post(&(resource.release)); \
     VERIFY(error, pthread_join(thread, NULL))
 
 /**
- * @brief Unregisters the global timer with a thread
+ * @brief Unregisters a periodic task
  * 
- * Dissasociates a thread with a timer (via its resource)
+ * Dissasociates a thread with the dispatcher (via its resource)
  * 
- * @param resource The ThreadResource to disassociate the global timer with
+ * @param resource The ThreadResource to disassociate the dispatcher with
  * 
- * @post The thread associated with resource is now disassociated with timer
+ * @pre The thread associated with resource is stopped
+ * @post The thread associated with resource is no longer released
 */
-#define UNREGISTER_TIMER(resource) \
-    Irq_UnregisterTimerIrq(&timer, resource.irq_context)
+#define UNREGISTER_TASK(resource) \
+    DispatcherUnregister(&(resource))
 
 /**
- * Waits for a timer trigger (at the appropriate time step)
+ * Waits for the task's next release (at its period)
  * 
- * @param irq_assert A uint32_t that shall hold the assertion code
- * @param resource A pointer to a ThreadResource for the thread associated
- * with the global timer
+ * @param irq_assert A uint32_t that shall hold the release code
+ * @param resource A pointer to a ThreadResource for the task
  * 
- * @post irq_assert will be non-zero iff the timer has waited for the standard
- * time step (BTI_S/MS/US)
- * @post The timer will trigger after waiting for the standard time step (BTI_S/MS/US)
+ * @post irq_assert will be non-zero iff the task was released
+ * (and zero if it was stopped instead)
 */
-#define TIMER_TRIGGER(irq_assert, resource) \
-    Irq_Wait(resource->irq_context, \
-             TIMERIRQNO, \
-             &irq_assert, \
-             (NiFpga_Bool *) &(resource->irq_thread_rdy)); \
-    NiFpga_WriteU32(myrio_session, IRQTIMERWRITE, BTI_US); \
-    NiFpga_WriteBool(myrio_session, IRQTIMERSETTIME, NiFpga_True)
+#define TASK_TRIGGER(irq_assert, resource) \
+    irq_assert = DispatcherWait(resource)
+
+/**
+ * Marks the end of the task's work for this release (e.g. once the
+ * actuators are written), so that the rest of the loop is not counted
+ * as compute time
+ * 
+ * @param resource A pointer to a ThreadResource for the task
+*/
+#define TASK_COMPLETE(resource) \
+    ThreadStatsComplete(&((resource)->stats), (resource)->period)
 
 /**
  * Kills a Thread
@@ -168,4 +415,7 @@ extern NiFpga_Session myrio_session;
     pthread_exit(NULL); \
     return NULL
 
+// The dispatcher needs ThreadResource, and the macros above need it
+#include "dispatcher.h"
+
 #endif  // THREAD_LIB_H_
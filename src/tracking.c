@@ -14,13 +14,16 @@
 #include <stdbool.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "setup.h"
 #include "io.h"
 #include "thread-lib.h"
 #include "discrete-lib.h"
+#include "control-chain.h"
 #include "record.h"
+#include "error.h"
 
 #include "tracking.h"
 
@@ -31,23 +34,35 @@
 /// Thread ID
 pthread_t tracking_thread;
 /// Thread Resources (Shared Resources)
-ThreadResource resource;
+static ThreadResource resource;
 
 
 /* Inner-Outer Loop Control Definition */
 
 
+/**
+ * @brief Tracking Mode Feedback Control Chain
+ * 
+ * The outer loop scales the angle error by the combined
+ * outer-loop constant, and the inner loop imposes
+ * artificial damping on the trolley velocity
+*/
+#define TRACKING_CHAIN(OP) \
+    OP(INPUT, angle_ref) \
+    OP(SUB, angle) \
+    OP(GAIN, combined_constants) \
+    OP(TAP, outer_output) \
+    OP(SUB_SCALED, vel, damping) \
+    OP(SCALE, FORCE_TO_VOLTAGE(1.0))
+
+DEFINE_CONTROL_CHAIN(TrackingChain, TRACKING_CHAIN)
+
 /**
  * @brief Tracking Mode Feedback Control Block
  * 
  * Represents the Inner and Outer Loop Elements
 */
-typedef struct {
-    ///! Combined Outer-Loop Constant
-    Proportional combined_constants;
-    ///! Artifical Damping (Inner Loop Feedback Gain)
-    Proportional damping;
-} TrackingControlScheme;
+typedef TrackingChainState TrackingControlScheme;
 
 
 /* Control-Loop Variables */
@@ -77,19 +92,52 @@ static int error;
 static FileID_t file = -1;
 /// The file Name
 static char *data_file_name = "tracking.mat";
-/// The number of entries
-#define DATA_LEN 12
-/// The data names
-static char *data_names[DATA_LEN] = {"id", "t",
-                                     "angle_x", "angle_y",
-                                     "trolley_pos_x", "trolley_pos_y",
-                                     "trolley_vel_x", "trolley_vel_y",
-                                     "inner_x", "voltage_x",
-                                     "inner_y", "voltage_y"};
-/// Buffer for data
-static double data[DATA_LEN];
-/// Pointer to next data point to insert into buffer
-static double *data_buff = data;
+/// The expected recording time (s), reserved up front
+#define DATA_DURATION 120.0
+
+/**
+ * @brief One Motor's Control Law Terms, as Recorded
+*/
+typedef struct {
+    Real inner;  ///< outer loop output (the inner loop's reference)
+    Real voltage;  ///< output voltage
+} TrackingAxisData;
+
+/**
+ * @brief A Tracking Sample, as Recorded
+*/
+typedef struct {
+    int32_t id;  ///< run ID
+    double t;  ///< time since the run started (s)
+    Angle angle_x;  ///< rope angle (x)
+    Angle angle_y;  ///< rope angle (y)
+    Position trolley_pos_x;  ///< trolley position (x)
+    Position trolley_pos_y;  ///< trolley position (y)
+    Velocity trolley_vel_x;  ///< trolley velocity (x)
+    Velocity trolley_vel_y;  ///< trolley velocity (y)
+    TrackingAxisData axis[2];  ///< control law terms (x, then y)
+} TrackingData;
+
+/// The data channels
+static const RecordChannel data_channels[] = {
+    RECORD_CHANNEL("id", TrackingData, id, MAT_INT32),
+    RECORD_CHANNEL("t", TrackingData, t, MAT_DOUBLE),
+    RECORD_CHANNEL("angle_x", TrackingData, angle_x, MAT_SINGLE),
+    RECORD_CHANNEL("angle_y", TrackingData, angle_y, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_pos_x", TrackingData, trolley_pos_x, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_pos_y", TrackingData, trolley_pos_y, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_vel_x", TrackingData, trolley_vel_x, MAT_SINGLE),
+    RECORD_CHANNEL("trolley_vel_y", TrackingData, trolley_vel_y, MAT_SINGLE),
+    RECORD_CHANNEL("inner_x", TrackingData, axis[0].inner, MAT_REAL),
+    RECORD_CHANNEL("voltage_x", TrackingData, axis[0].voltage, MAT_REAL),
+    RECORD_CHANNEL("inner_y", TrackingData, axis[1].inner, MAT_REAL),
+    RECORD_CHANNEL("voltage_y", TrackingData, axis[1].voltage, MAT_REAL)};
+/// The number of data channels
+#define DATA_LEN ((int) (sizeof(data_channels) / sizeof(data_channels[0])))
+/// The sample being built
+static TrackingData data;
+/// Pointer to the next motor's terms to insert into the sample
+static TrackingAxisData *data_axis = data.axis;
 /// ID variable
 static int id = 1;
 
@@ -132,20 +180,17 @@ static void *TrackingModeThread(void *resource);
  * @param pos_vel The measured velocity of the motor
  * @param scheme A pointer to the TrackingControlScheme structure
  * used to execute the control law
- * @param SetVoltage The function that sets the voltage of the
- * appropriate motor
  * 
- * @return 0 upon success, negative otherwise
+ * @return The voltage to apply to the appropriate motor
  * 
  * @pre scheme was not modified before use of this function
  * @post scheme is now updated with the input and outputs for
  * the respective control scheme
 */
-static inline int TrackingControlLaw(Angle angle_ref,
-                                     Angle angle_input,
-                                     Velocity pos_vel,
-                                     TrackingControlScheme *scheme,
-                                     int (* SetVoltage)(Voltage voltage));
+static inline Voltage TrackingControlLaw(Angle angle_ref,
+                                         Angle angle_input,
+                                         Velocity pos_vel,
+                                         TrackingControlScheme *scheme);
 
 
 /* Tracking Mode Function Definitions */
@@ -154,24 +199,38 @@ static inline int TrackingControlLaw(Angle angle_ref,
 int TrackingFork() {
     SetupScheme(&x_control, -3295.3175, 1, 155.36);
     SetupScheme(&y_control, -1040.0, 1, 53.2);
-    if (file == -1) {
-        file = OpenDataFile(data_file_name, data_names, DATA_LEN);
+    if (file < 0) {
+        file = OpenDataFile(data_file_name, data_channels, DATA_LEN,
+                            sizeof(TrackingData), DATA_DURATION);
+        // Without its data file, the mode does not start
+        if (file < 0) {
+            u_error = EFILE;
+            return EFILE;
+        }
         RecordValue(file, "K_x", x_control.combined_constants);
         RecordValue(file, "B_x", x_control.damping);
         RecordValue(file, "K_y", y_control.combined_constants);
         RecordValue(file, "B_y", y_control.damping);
+        // Headline metrics of each run, in the run index
+        RecordSetMetric(file, "angle_x");
+        RecordSetMetric(file, "angle_y");
     }
 
-    REGISTER_TIMER(resource);
+    REGISTER_TASK(resource, CONTROL_PERIOD, CONTROL_PHASE,
+                  CONTROL_PRIORITY, CONTROL_CPU);
     START_THREAD(tracking_thread, TrackingModeThread, resource);
     return EXIT_SUCCESS;
 }
 
 int TrackingJoin() {
     STOP_THREAD(tracking_thread, resource);
-    UNREGISTER_TIMER(resource);
-    SetXVoltage(0.0);
-    SetYVoltage(0.0);
+    UNREGISTER_TASK(resource);
+    // Keep the lead-up to a limit hit, if only capturing windows
+    if (u_error) RecordTrigger(file);
+    RecordThreadStats(file, id, &resource);
+    // Write the run to its own segment, in the background
+    RecordEndRun(file, id);
+    SetVoltages(0.0, 0.0);
     id++;
     return EXIT_SUCCESS;
 }
@@ -181,84 +240,72 @@ static void *TrackingModeThread(void *resource) {
     double t = 0.0;
     while (thread_resource->irq_thread_rdy) {
         static uint32_t irq_assert = 1;
-        TIMER_TRIGGER(irq_assert, thread_resource);
+        TASK_TRIGGER(irq_assert, thread_resource);
         static Angles angle_ref;
-        static Angles angle_input;
-        static Positions trolley_pos;
-        static Velocities trolley_vel;
+        static SensorSnapshot sensors;
+        Voltage x_voltage, y_voltage;
 
         if (irq_assert) {
             // Do the loop for both motors
-            data_buff = data;
+            data_axis = data.axis;
 
             // Get the inputs
             if (GetReferenceAngleCommand(&angle_ref)) {
                 EXIT_THREAD();
             }
-            if (GetAngle(&angle_input)) {
-                EXIT_THREAD();
-            }
-            if (GetTrolleyPosition(&trolley_pos)) {
-                EXIT_THREAD();
-            }
-            if (GetTrolleyVelocity(&trolley_vel)) {
+            if (ReadSensorSnapshot(&sensors)) {
                 EXIT_THREAD();
             }
 
 
             // Record the sensor data
-            *data_buff++ = id;
-            *data_buff++ = t;
-            *data_buff++ = angle_input.x_angle;
-            *data_buff++ = angle_input.y_angle;
-            *data_buff++ = trolley_pos.x_pos;
-            *data_buff++ = trolley_pos.y_pos;
-            *data_buff++ = trolley_vel.x_vel;
-            *data_buff++ = trolley_vel.y_vel;
-
-            // Run both control laws
-            if (TrackingControlLaw(angle_ref.x_angle,
-                                   angle_input.x_angle,
-                                   trolley_vel.x_vel,
-                                   &x_control,
-                                   SetXVoltage)) {
-                EXIT_THREAD();
-            }
-            if (TrackingControlLaw(angle_ref.y_angle,
-                                   angle_input.y_angle,
-                                   trolley_vel.y_vel,
-                                   &y_control,
-                                   SetYVoltage)) {
+            data.id = id;
+            data.t = t;
+            data.angle_x = sensors.angle.x_angle;
+            data.angle_y = sensors.angle.y_angle;
+            data.trolley_pos_x = sensors.pos.x_pos;
+            data.trolley_pos_y = sensors.pos.y_pos;
+            data.trolley_vel_x = sensors.vel.x_vel;
+            data.trolley_vel_y = sensors.vel.y_vel;
+
+            // Run both control laws, and write both motors at once
+            x_voltage = TrackingControlLaw(angle_ref.x_angle,
+                                           sensors.angle.x_angle,
+                                           sensors.vel.x_vel,
+                                           &x_control);
+            y_voltage = TrackingControlLaw(angle_ref.y_angle,
+                                           sensors.angle.y_angle,
+                                           sensors.vel.y_vel,
+                                           &y_control);
+            if (SetVoltages(x_voltage, y_voltage)) {
                 EXIT_THREAD();
             }
+            TASK_COMPLETE(thread_resource);
 
-            // Send data into file
-            RecordData(file, data, DATA_LEN);
+            // Queue data for the recorder
+            RecordSample(file, &data);
             t += BTI_S;
-
-            Irq_Acknowledge(irq_assert);
         }
     }
     printf("Time: %f s\n", t);
     EXIT_THREAD();
 }
 
-static inline int TrackingControlLaw(Angle angle_ref,
-                                     Angle angle_input,
-                                     Velocity pos_vel,
-                                     TrackingControlScheme *scheme,
-                                     int (* SetVoltage)(Voltage voltage)) {
-    double outer_output = scheme->combined_constants *
-        (angle_ref - angle_input);
-    *data_buff++ = outer_output;
-    double final_output = FORCE_TO_VOLTAGE(outer_output -
-        scheme->damping * pos_vel);
-
-    static int error;
-    VERIFY(error, SetVoltage(final_output));
-    *data_buff++ = final_output;
-
-    return EXIT_SUCCESS;
+static inline Voltage TrackingControlLaw(Angle angle_ref,
+                                         Angle angle_input,
+                                         Velocity pos_vel,
+                                         TrackingControlScheme *scheme) {
+    TrackingChainInput input = {.angle_ref = angle_ref,
+                                .angle = angle_input,
+                                .vel = pos_vel};
+    TrackingChainTaps taps;
+    Real final_output = TrackingChainStep(scheme, &input, &taps);
+
+    data_axis->inner = taps.outer_output;
+    data_axis->voltage = final_output;
+    data_axis++;
+
+    return final_output;
 }
 
 static inline void SetupScheme(TrackingControlScheme *scheme,
@@ -22,7 +22,8 @@
  * 
  * @pre Tracking Mode is not already running
  * 
- * @return 0 upon success, negative if error
+ * @return 0 upon success, EFILE (also set in u_error) if its data file
+ * cannot be opened, in which case the mode does not start
 */
 int TrackingFork();
 
@@ -0,0 +1,398 @@
+/**
+ * @file unpack.c
+ * @author Anti-Sway Team: Nguyen, Tri; Espinola, Malachi;
+ * Tevy, Vattanary; Hokenstad, Ethan; Neff, Callen)
+ * @brief Series File and Spool Decoder
+ * @version 0.1
+ * @date 2024-06-03
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * Expands a compressed data file (see RecordSetCompression()) back
+ * into one MAT file, as an uncompressed one would have been: the data
+ * file's one-time values, then each column of the series file (see
+ * gorilla.h) as a row vector of its type. Load it with
+ * scipy.io.loadmat() for NumPy arrays.
+ * 
+ * A series file cut short (by a crash) is decoded up to its last
+ * whole block.
+ * 
+ * It also recovers a spool left by a crash (see spool.h), whichever
+ * the data file's compression: a data file's columns are only written
+ * as it closes, so its spool holds the samples recorded until then.
+ * A compressed file's spool is its series file so far, and decodes as
+ * one; an uncompressed file's spool is sorted into its columns, up to
+ * its last whole record (its storage is reserved up front, so it may
+ * run on in zeros).
+ * 
+ * Usage: unpack name.series|name.mat.spool [name.mat [out.mat]]
+ * (by default name.mat, and name-unpacked.mat)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mat-stream.h"
+#include "gorilla.h"
+#include "spool.h"
+
+
+/* Unpack Constants */
+
+
+/// MAT v5 Header Length (bytes)
+#define MAT_HEADER_LEN 128
+/// The most columns in a spool (its channels and the indices)
+#define SPOOL_MAX_COLUMNS (SPOOL_MAX_CHANNELS + 1)
+
+
+/* Static Helper Functions */
+
+
+/**
+ * Reads a whole file
+ * 
+ * @param path The file's path
+ * @param length A return parameter, which becomes the file's length
+ * (bytes)
+ * 
+ * @return The file's contents (to be freed), or NULL upon failure
+*/
+static char *ReadFile(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    char *contents = NULL;
+    long size;
+
+    if (file == NULL) return NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 &&
+        fseek(file, 0, SEEK_SET) == 0) {
+        contents = (char *) malloc(size > 0 ? size : 1);
+        if (contents != NULL &&
+            fread(contents, 1, size, file) != (size_t) size) {
+            free(contents);
+            contents = NULL;
+        }
+        *length = size;
+    }
+    fclose(file);
+    return contents;
+}
+
+/**
+ * Finds the end of a series file's whole frames
+ * 
+ * @param series The series file's contents
+ * @param length The series file's length (bytes)
+ * @param counts A return parameter, which becomes the number of values
+ * in each column
+ * 
+ * @return The offset just past the last whole frame
+*/
+static size_t ScanFrames(const char *series,
+                         size_t length,
+                         uint32_t counts[]) {
+    const GorillaHeader *header = (const GorillaHeader *) series;
+    size_t position = sizeof(GorillaHeader);
+    GorillaFrame frame;
+
+    while (position + sizeof(frame) <= length) {
+        memcpy(&frame, series + position, sizeof(frame));
+        if (frame.column >= header->num_columns || frame.count == 0 ||
+            frame.count > header->block_values ||
+            frame.length > length - position - sizeof(frame)) {
+            break;
+        }
+        counts[frame.column] += frame.count;
+        position += sizeof(frame) + frame.length;
+    }
+    return position;
+}
+
+
+/**
+ * Finds the end of a spool's whole records
+ * 
+ * @param spool The spool's contents
+ * @param length The spool's length (bytes)
+ * @param sizes Each channel's size (bytes)
+ * @param counts A return parameter, which becomes the number of values
+ * in each column (the channels', then the indices')
+ * 
+ * @return The offset just past the last whole record (before any
+ * reserved storage)
+*/
+static size_t ScanRecords(const char *spool,
+                          size_t length,
+                          const uint32_t sizes[],
+                          uint32_t counts[]) {
+    const SpoolHeader *header = (const SpoolHeader *) spool;
+    size_t position = header->header_size;
+    uint32_t mask;
+    uint32_t j;
+
+    while (position + SPOOL_RECORD_HEADER_LEN <= length) {
+        size_t end = position + SPOOL_RECORD_HEADER_LEN;
+        memcpy(&mask, spool + position + sizeof(uint32_t), sizeof(mask));
+        if (mask == 0) break;  // the storage reserved past the records
+        for (j = 0; j < header->num_channels; j++) {
+            if (mask & (1u << j)) end += sizes[j];
+        }
+        if (end > length) break;
+        for (j = 0; j < header->num_channels; j++) {
+            if (mask & (1u << j)) counts[j]++;
+        }
+        counts[header->num_channels]++;
+        position = end;
+    }
+    return position;
+}
+
+/**
+ * Decodes a series file's columns into a MAT file
+ * 
+ * @param out The MAT file
+ * @param path The series file's path (for messages)
+ * @param series The series file's contents
+ * @param length The series file's length (bytes)
+ * 
+ * @return The number of samples, or negative upon failure
+*/
+static long UnpackSeries(MatStream *out,
+                         const char *path,
+                         const char *series,
+                         size_t length) {
+    const GorillaHeader *header = (const GorillaHeader *) series;
+    uint32_t counts[GORILLA_MAX_COLUMNS] = {0};
+    uint32_t written[GORILLA_MAX_COLUMNS] = {0};
+    off_t data[GORILLA_MAX_COLUMNS];
+    char *values;
+    size_t end;
+    size_t position;
+    uint32_t j;
+
+    if (header->num_columns < 1 ||
+        header->num_columns > GORILLA_MAX_COLUMNS) {
+        fprintf(stderr, "%s is not a series file\n", path);
+        return -1;
+    }
+    end = ScanFrames(series, length, counts);
+    // A spool's reserved storage reads as zeros
+    for (position = end; position < length && series[position] == 0;) {
+        position++;
+    }
+    if (position != length) {
+        fprintf(stderr, "%s: %zu byte(s) past the last whole block\n",
+                path, length - end);
+    }
+
+    for (j = 0; j < header->num_columns; j++) {
+        char name[GORILLA_NAME_LEN + 1] = {0};
+        memcpy(name, header->names[j], GORILLA_NAME_LEN);
+        if (MatStreamBeginMatrix(out, name, (MatType) header->types[j],
+                                 1, counts[j], data + j)) {
+            return -1;
+        }
+    }
+
+    // Each block, into its column
+    values = (char *) malloc((size_t) header->block_values * 8);
+    if (values == NULL) return -1;
+    for (position = sizeof(GorillaHeader); position < end;) {
+        GorillaFrame frame;
+        MatType type;
+        uint32_t size;
+        memcpy(&frame, series + position, sizeof(frame));
+        position += sizeof(frame);
+        type = (MatType) header->types[frame.column];
+        size = MatTypeSize(type);
+        if (GorillaDecode(type, (const uint8_t *) series + position,
+                          frame.length, frame.count, values) ||
+            MatStreamWriteValues(out, data[frame.column]
+                                 + (off_t) written[frame.column] * size,
+                                 values, (size_t) frame.count * size)) {
+            fprintf(stderr, "%s: bad block at %zu\n", path, position);
+            free(values);
+            return -1;
+        }
+        written[frame.column] += frame.count;
+        position += frame.length;
+    }
+    free(values);
+    return counts[header->num_columns - 1];
+}
+
+/**
+ * Sorts a spool's records into a MAT file's columns
+ * 
+ * @param out The MAT file
+ * @param path The spool's path (for messages)
+ * @param spool The spool's contents
+ * @param length The spool's length (bytes)
+ * 
+ * @return The number of samples, or negative upon failure
+*/
+static long UnpackSpool(MatStream *out,
+                        const char *path,
+                        const char *spool,
+                        size_t length) {
+    const SpoolHeader *header = (const SpoolHeader *) spool;
+    uint32_t counts[SPOOL_MAX_COLUMNS] = {0};
+    uint32_t written[SPOOL_MAX_COLUMNS] = {0};
+    uint32_t sizes[SPOOL_MAX_COLUMNS];
+    char *columns[SPOOL_MAX_COLUMNS] = {NULL};
+    uint32_t num_columns = header->num_channels + 1;
+    long err = 0;
+    size_t end;
+    size_t position;
+    uint32_t mask;
+    uint32_t j;
+
+    if (header->num_channels < 1 ||
+        header->num_channels > SPOOL_MAX_CHANNELS ||
+        header->header_size < sizeof(SpoolHeader) ||
+        header->header_size > length) {
+        fprintf(stderr, "%s is not a spool\n", path);
+        return -1;
+    }
+    for (j = 0; j < header->num_channels; j++) {
+        if (header->types[j] != MAT_INT32 &&
+            header->types[j] != MAT_SINGLE &&
+            header->types[j] != MAT_DOUBLE) {
+            fprintf(stderr, "%s: bad type for channel %u\n", path, j);
+            return -1;
+        }
+        sizes[j] = MatTypeSize((MatType) header->types[j]);
+    }
+    sizes[header->num_channels] = sizeof(uint32_t);
+    end = ScanRecords(spool, length, sizes, counts);
+
+    // Each record, into the columns
+    for (j = 0; j < num_columns && !err; j++) {
+        columns[j] = (char *) malloc((size_t) counts[j] * sizes[j] + 1);
+        if (columns[j] == NULL) err = -1;
+    }
+    for (position = header->header_size; position < end && !err;) {
+        const char *value = spool + position + SPOOL_RECORD_HEADER_LEN;
+        memcpy(&mask, spool + position + sizeof(uint32_t), sizeof(mask));
+        memcpy(columns[header->num_channels]
+               + written[header->num_channels]++ * sizeof(uint32_t),
+               spool + position, sizeof(uint32_t));
+        for (j = 0; j < header->num_channels; j++) {
+            if (!(mask & (1u << j))) continue;
+            memcpy(columns[j] + written[j]++ * sizes[j], value, sizes[j]);
+            value += sizes[j];
+        }
+        position = value - spool;
+    }
+
+    // Each column, as CloseHelper() (record.c) would have written it
+    for (j = 0; j < num_columns && !err; j++) {
+        char name[SPOOL_NAME_LEN + 1] = "sample_index";
+        MatType type = MAT_INT32;
+        off_t data;
+        if (j < header->num_channels) {
+            memcpy(name, header->names[j], SPOOL_NAME_LEN);
+            name[SPOOL_NAME_LEN] = '\0';
+            type = (MatType) header->types[j];
+        }
+        if (MatStreamBeginMatrix(out, name, type, 1, counts[j], &data) ||
+            MatStreamWriteValues(out, data, columns[j],
+                                 (size_t) counts[j] * sizes[j])) {
+            err = -1;
+        }
+    }
+    for (j = 0; j < num_columns; j++) {
+        free(columns[j]);
+    }
+    return err ? err : (long) counts[header->num_channels];
+}
+
+
+/* Unpack Function Definitions */
+
+
+int main(int argc, char *argv[]) {
+    char mat_path[256];
+    char out_path[256];
+    char *input;
+    char *mat;
+    size_t input_len;
+    size_t mat_len = 0;
+    int stem_len;
+    long samples;
+    MatStream out;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s name.series|name.mat.spool "
+                "[name.mat [out.mat]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // The stem, without .spool, and then .series or .mat
+    stem_len = strlen(argv[1]);
+    if (stem_len > 6 && strcmp(argv[1] + stem_len - 6, ".spool") == 0) {
+        stem_len -= 6;
+    }
+    if (stem_len > 7 && strncmp(argv[1] + stem_len - 7, ".series", 7) == 0) {
+        stem_len -= 7;
+    } else if (stem_len > 4 &&
+               strncmp(argv[1] + stem_len - 4, ".mat", 4) == 0) {
+        stem_len -= 4;
+    }
+    if (argc > 2) {
+        snprintf(mat_path, sizeof(mat_path), "%s", argv[2]);
+    } else {
+        snprintf(mat_path, sizeof(mat_path), "%.*s.mat", stem_len, argv[1]);
+    }
+    if (argc > 3) {
+        snprintf(out_path, sizeof(out_path), "%s", argv[3]);
+    } else {
+        snprintf(out_path, sizeof(out_path), "%.*s-unpacked.mat",
+                 stem_len, argv[1]);
+    }
+
+    // A series file (or a compressed file's spool), or a spool
+    input = ReadFile(argv[1], &input_len);
+    if (input == NULL || input_len < 8 ||
+        !((memcmp(input, GORILLA_MAGIC, 8) == 0 &&
+           input_len >= sizeof(GorillaHeader) &&
+           ((const GorillaHeader *) input)->version == GORILLA_VERSION) ||
+          (memcmp(input, SPOOL_MAGIC, 8) == 0 &&
+           input_len >= sizeof(SpoolHeader) &&
+           ((const SpoolHeader *) input)->version == SPOOL_VERSION))) {
+        fprintf(stderr, "%s is not a series file or a spool\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (MatStreamOpen(&out, out_path)) {
+        fprintf(stderr, "cannot create %s\n", out_path);
+        return EXIT_FAILURE;
+    }
+    // The one-time values, as they are
+    mat = ReadFile(mat_path, &mat_len);
+    if (mat == NULL || mat_len < MAT_HEADER_LEN) {
+        fprintf(stderr, "%s: no one-time values\n", mat_path);
+    } else if (MatStreamAddElements(&out, mat + MAT_HEADER_LEN,
+                                    mat_len - MAT_HEADER_LEN)) {
+        fprintf(stderr, "cannot copy %s\n", mat_path);
+        return EXIT_FAILURE;
+    }
+    free(mat);
+
+    if (memcmp(input, GORILLA_MAGIC, 8) == 0) {
+        samples = UnpackSeries(&out, argv[1], input, input_len);
+    } else {
+        samples = UnpackSpool(&out, argv[1], input, input_len);
+    }
+    if (samples < 0) {
+        fprintf(stderr, "cannot write %s\n", out_path);
+        return EXIT_FAILURE;
+    }
+
+    if (MatStreamClose(&out)) return EXIT_FAILURE;
+    printf("%s: %ld sample(s), %zu -> %zu bytes -> %s\n", argv[1],
+           samples, input_len, (size_t) out.end, out_path);
+    free(input);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+"""
+Converts a flight log (see src/flight-log.h) into a .mat or .npz file,
+with the same variable names as the data file it shadows.
+
+Usage: python flight.py anti-sway.flight [out.mat | out.npz]
+"""
+
+import sys
+from typing import Dict
+
+import numpy as np
+import scipy.io
+
+MAGIC = b'ASFLIGHT'
+VERSION = 2
+MAX_ENTRIES = 32
+NAME_LEN = 32
+
+# The C header's layout (little-endian, as the myRIO writes it)
+HEADER = np.dtype([('magic', 'S8'), ('version', '<u4'),
+                   ('header_size', '<u4'), ('num_entries', '<u4'),
+                   ('sample_size', '<u4'), ('stride', '<u4'),
+                   ('capacity', '<u4'), ('head', '<u8'),
+                   ('bti_us', '<u4'), ('reserved', '<u4'),
+                   ('names', 'S%d' % NAME_LEN, (MAX_ENTRIES,)),
+                   ('types', '<u4', (MAX_ENTRIES,)),
+                   ('offsets', '<u4', (MAX_ENTRIES,))])
+
+# Each entry's type, by its MAT data type (miINT32, miSINGLE, miDOUBLE)
+TYPES = {5: np.int32, 7: np.float32, 9: np.float64}
+
+
+def read_flight_log(path: str) -> Dict[str, np.ndarray]:
+    """
+    Reads a flight log's samples, oldest first
+
+    The slot the writer would fill next may be torn (if the process
+    died mid-sample), so it is left out once the log has wrapped.
+    """
+    raw = np.fromfile(path, dtype=np.uint8)
+    header = raw[:HEADER.itemsize].view(HEADER)[0]
+    if header['magic'] != MAGIC or header['version'] != VERSION:
+        raise ValueError('%s is not a flight log' % path)
+
+    num_entries = int(header['num_entries'])
+    stride = int(header['stride'])
+    capacity = int(header['capacity'])
+    head = int(header['head'])
+    start = int(header['header_size'])
+    slots = raw[start:start + capacity * stride].reshape(capacity, stride)
+
+    first = max(0, head - capacity + 1)
+    samples = slots[np.arange(first, head) % capacity]
+
+    data = {}
+    for j in range(num_entries):
+        name = header['names'][j].decode()
+        kind = np.dtype(TYPES[int(header['types'][j])])
+        offset = int(header['offsets'][j])
+        values = samples[:, offset:offset + kind.itemsize]
+        data[name] = np.ascontiguousarray(values).view(kind).reshape(1, -1)
+    data['flight_head'] = np.array([[head]], dtype=np.float64)
+    data['flight_bti_us'] = np.array([[header['bti_us']]], dtype=np.float64)
+    return data
+
+
+def main(argv) -> int:
+    if len(argv) < 2:
+        print(__doc__.strip())
+        return 1
+    path = argv[1]
+    out = argv[2] if len(argv) > 2 else \
+        path.replace('.flight', '-flight') + '.mat'
+    data = read_flight_log(path)
+    if out.endswith('.npz'):
+        np.savez(out, **data)
+    else:
+        scipy.io.savemat(out, data)
+    print('%s: %d samples -> %s'
+          % (path, data[next(iter(data))].shape[1], out))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,77 @@
+"""
+Loads single runs of a segmented session (see RecordEndRun() in
+src/record.h): the run index, <name>-runs.csv, lists each run's segment,
+samples, duration and headline metrics.
+
+Usage: python runs.py anti-sway-runs.csv [run]
+"""
+
+import csv
+import os
+import sys
+from typing import Dict, List
+
+import numpy as np
+import scipy.io
+
+
+def read_index(path: str) -> List[Dict[str, object]]:
+    """
+    Reads a run index, one dict per run (numbers as numbers)
+    """
+    runs = []
+    with open(path, newline='') as index:
+        for row in csv.DictReader(index):
+            run = {}
+            for key, value in row.items():
+                try:
+                    run[key] = int(value)
+                except ValueError:
+                    try:
+                        run[key] = float(value)
+                    except ValueError:
+                        run[key] = value
+            runs.append(run)
+    return runs
+
+
+def load_run(index_path: str, run: int) -> Dict[str, np.ndarray]:
+    """
+    Loads one run's samples, with the session's one-time values
+
+    A compressed segment (.series) must be expanded with tools/unpack.c
+    first (into <segment>-unpacked.mat).
+    """
+    folder = os.path.dirname(index_path)
+    stem = index_path[:-len('-runs.csv')]
+    entry = next(r for r in read_index(index_path) if r['run'] == run)
+    segment = os.path.join(folder, os.path.basename(entry['segment']))
+    if segment.endswith('.series'):
+        segment = segment[:-len('.series')] + '-unpacked.mat'
+        if not os.path.exists(segment):
+            raise FileNotFoundError('expand %s first: tools/build/unpack %s '
+                                    '%s.mat' % (entry['segment'],
+                                                entry['segment'], stem))
+    data = {k: v for k, v in scipy.io.loadmat(stem + '.mat').items()
+            if not k.startswith('__')}
+    data.update({k: v for k, v in scipy.io.loadmat(segment).items()
+                 if not k.startswith('__')})
+    return data
+
+
+def main(argv) -> int:
+    if len(argv) < 2:
+        print(__doc__.strip())
+        return 1
+    if len(argv) > 2:
+        data = load_run(argv[1], int(argv[2]))
+        for name, values in sorted(data.items()):
+            print('%s: %s %s' % (name, values.dtype, values.shape))
+        return 0
+    for run in read_index(argv[1]):
+        print(', '.join('%s %s' % item for item in run.items()))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
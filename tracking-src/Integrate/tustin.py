@@ -30,6 +30,31 @@ class TustinDifferentiator():
         self.prev_input = input_
         self.prev_output = result
 
+class TustinBiquad():
+
+    def __init__(self, numerator, denominator, timestep, prewarp=0.0):
+        # Mirrors DesignSection() in filter-design.c: s^2, s, 1 coefficients
+        k = prewarp / np.tan(prewarp * timestep / 2.0) if prewarp > 0.0 \
+            else 2.0 / timestep
+        b = [numerator[0] * k ** 2 + numerator[1] * k + numerator[2],
+             2.0 * (numerator[2] - numerator[0] * k ** 2),
+             numerator[0] * k ** 2 - numerator[1] * k + numerator[2]]
+        a = [denominator[0] * k ** 2 + denominator[1] * k + denominator[2],
+             2.0 * (denominator[2] - denominator[0] * k ** 2),
+             denominator[0] * k ** 2 - denominator[1] * k + denominator[2]]
+        self.numerator = [coeff / a[0] for coeff in b]
+        self.denominator = [1.0, a[1] / a[0], a[2] / a[0]]
+        self.state = [0.0, 0.0]
+
+    def step(self, input_):
+        # Transposed direct form II, as in EvaluateBiquad()
+        result = self.numerator[0] * input_ + self.state[0]
+        self.state[0] = self.numerator[1] * input_ - \
+            self.denominator[1] * result + self.state[1]
+        self.state[1] = self.numerator[2] * input_ - \
+            self.denominator[2] * result
+        return result
+
 if __name__ == "__main__":
     obj = TustinIntegrator(1.0, 0.005)
     obj2 = TustinDifferentiator(1.0, 0.05)